@@ -0,0 +1,39 @@
+/**
+ * access_strategy.cpp
+ */
+
+#include <algorithm>
+
+#include "buffer/access_strategy.h"
+#include "buffer/buffer_pool_manager.h"
+
+namespace cmudb {
+
+AccessStrategy::AccessStrategy(BufferPoolManager *buffer_pool_manager,
+                               size_t ring_size)
+    : buffer_pool_manager_(buffer_pool_manager) {
+  size_t num_instances = buffer_pool_manager_->GetNumInstances();
+  size_t instance_size = buffer_pool_manager_->GetPoolSize() / num_instances;
+  // never let a ring take over more than a quarter of an instance
+  size_t capacity =
+      std::max<size_t>(1, std::min(ring_size / num_instances,
+                                   instance_size / 4));
+  rings_.resize(num_instances);
+  for (auto &ring : rings_) {
+    ring.capacity_ = capacity;
+    ring.next_ = 0;
+  }
+}
+
+/*
+ * Read-ahead requests may still refer to this strategy, drop them first
+ */
+AccessStrategy::~AccessStrategy() {
+  buffer_pool_manager_->forgetAccessStrategy(this);
+}
+
+size_t AccessStrategy::GetRingSize() const {
+  return rings_.size() * rings_.front().capacity_;
+}
+
+} // namespace cmudb
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <thread>
+
 #include "buffer/buffer_pool_manager.h"
 #include "common/logger.h"
 
@@ -6,38 +9,106 @@ namespace cmudb {
 /*
  * BufferPoolManager Constructor
  * When log_manager is nullptr, logging is disabled (for test purpose)
- * WARNING: Do Not Edit This Function
+ * The frames are split as evenly as possible among num_instances partitions,
+ * each partition gets its own replacer of type replacer_type
+ * huge_pages: try to back the frame arena with huge pages
  */
 BufferPoolManager::BufferPoolManager(size_t pool_size,
                                                  DiskManager *disk_manager,
-                                                 LogManager *log_manager)
-    : pool_size_(pool_size), disk_manager_(disk_manager),
-      log_manager_(log_manager) {
+                                                 LogManager *log_manager,
+                                                 size_t num_instances,
+                                                 ReplacerType replacer_type,
+                                                 bool huge_pages)
+    : pool_size_(pool_size), arena_(pool_size * PAGE_SIZE, huge_pages),
+      disk_manager_(disk_manager),
+      log_manager_(log_manager), page_recovery_(nullptr),
+      cleaner_thread_(nullptr),
+      cleaner_running_(false), clean_target_(PAGE_CLEANER_CLEAN_TARGET),
+      write_rate_(PAGE_CLEANER_WRITE_RATE), prefetch_thread_(nullptr),
+      prefetch_running_(false), prefetch_strategy_(nullptr), claim_releases_(0),
+      pending_io_(0) {
+  assert(num_instances > 0 && num_instances <= pool_size_);
   // a consecutive memory space for buffer pool
   pages_ = new Page[pool_size_];
-  page_table_ = new ExtendibleHash<page_id_t, Page *>(BUCKET_SIZE);
-  replacer_ = new LRUReplacer<Page *>;
-  free_list_ = new std::list<Page *>;
-
-  // put all the pages into free list
   for (size_t i = 0; i < pool_size_; ++i) {
-    free_list_->push_back(&pages_[i]);
+    pages_[i].data_ = arena_.GetData() + i * PAGE_SIZE;
   }
-  LOG_DEBUG("free_list size:%lu", free_list_->size());
-  LOG_DEBUG("pool_size:%lu", pool_size_);
+
+  size_t begin = 0;
+  for (size_t i = 0; i < num_instances; ++i) {
+    size_t size = pool_size_ / num_instances + (i < pool_size_ % num_instances);
+    instances_.push_back(
+        new BufferPoolInstance(pages_ + begin, size, replacer_type));
+    begin += size;
+  }
+  LOG_DEBUG("pool_size:%lu, num_instances:%lu", pool_size_, num_instances);
 }
 
 /*
  * BufferPoolManager Deconstructor
- * WARNING: Do Not Edit This Function
  */
 BufferPoolManager::~BufferPoolManager() {
+  if (cleaner_running_) {
+    StopPageCleaner();
+  }
+  if (prefetch_thread_ != nullptr) {
+    {
+      std::lock_guard<std::mutex> guard(prefetch_latch_);
+      prefetch_running_ = false;
+    }
+    prefetch_cv_.notify_all();
+    prefetch_thread_->join();
+    delete prefetch_thread_;
+  }
+  {
+    std::unique_lock<std::mutex> lock(io_latch_);
+    io_cv_.wait(lock, [&] { return pending_io_ == 0; });
+  }
+  for (auto instance : instances_) {
+    delete instance;
+  }
   delete[] pages_;
+}
+
+BufferPoolManager::BufferPoolInstance::BufferPoolInstance(
+    Page *pages, size_t size, ReplacerType replacer_type)
+    : pages_(pages), size_(size) {
+  page_table_ = new PageTable(size_);
+  switch (replacer_type) {
+    case ReplacerType::CLOCK:
+      replacer_ = new ClockReplacer<Page *>(pages_, size_);
+      break;
+    case ReplacerType::LRU_K:
+      replacer_ = new LRUKReplacer<Page *>(pages_, size_);
+      break;
+    case ReplacerType::LRU:
+    default:
+      replacer_ = new LRUReplacer<Page *>;
+      break;
+  }
+  free_list_ = new std::list<Page *>;
+
+  // put all the pages into free list
+  for (size_t i = 0; i < size_; ++i) {
+    free_list_->push_back(&pages_[i]);
+  }
+}
+
+BufferPoolManager::BufferPoolInstance::~BufferPoolInstance() {
   delete page_table_;
   delete replacer_;
   delete free_list_;
 }
 
+/*
+ * Route a page id to the partition that caches it. Page ids are handed out
+ * sequentially by the disk manager, so a plain modulo spreads them evenly.
+ */
+BufferPoolManager::BufferPoolInstance *
+BufferPoolManager::GetInstance(page_id_t page_id) {
+  return instances_[static_cast<size_t>(page_id) % instances_.size()];
+}
+
 /**
  * 1. search hash table.
  *  1.1 if exist, pin the page and return immediately
@@ -48,58 +119,185 @@ BufferPoolManager::~BufferPoolManager() {
  * entry for the new page.
  * 4. Update page metadata, read page content from disk file and return page
  * pointer
+ * Step 1.1 first runs without the instance latch: the page table lookup is
+ * lock-free and the pin is an atomic increment. Only a miss, or a race with
+ * an eviction of the frame, takes the latch. Every fetch, hit or miss, is
+ * reported to the replacer with RecordAccess.
  */
-Page *BufferPoolManager::FetchPage(page_id_t page_id) { 
-  std::lock_guard<std::mutex> guard(this->latch_);
+Page *BufferPoolManager::FetchPage(page_id_t page_id,
+                                   AccessStrategy *strategy) {
+  BufferPoolInstance *instance = GetInstance(page_id);
 
   Page* pagePtr = nullptr;
-  if (page_table_->Find(page_id, pagePtr)) {
-    pagePtr->pin_count_++;
-    replacer_->Erase(pagePtr);
-    return pagePtr;
+  if (instance->page_table_->Find(page_id, pagePtr) &&
+      tryPinPage(instance, pagePtr, page_id)) {
+    if (!pagePtr->read_failed_) {
+      instance->replacer_->RecordAccess(pagePtr);
+      return pagePtr;
+    }
+    // a failed read-ahead, retry the read below
+    unpinFrame(instance, pagePtr);
   }
 
-  // Need lock here
-  pagePtr = findUnusedPage();
-  if (pagePtr == nullptr) {
-    return pagePtr;
+  std::lock_guard<std::mutex> guard(instance->latch_);
+  while (true) {
+    if (instance->page_table_->Find(page_id, pagePtr)) {
+      // only the page cleaner and the read-ahead thread can hold a resident
+      // frame claimed, for the duration of one page write or read
+      if (!tryPinPage(instance, pagePtr, page_id)) {
+        waitForClaim(instance, pagePtr);
+        continue;
+      }
+      if (pagePtr->read_failed_) {
+        if (!disk_manager_->ReadPage(page_id, pagePtr->data_)) {
+          unpinFrame(instance, pagePtr);
+          return nullptr;
+        }
+        pagePtr->read_failed_ = false;
+      }
+      instance->replacer_->RecordAccess(pagePtr);
+      return pagePtr;
+    }
+
+    // Need lock here
+    pagePtr = strategy == nullptr ? findUnusedPage(instance)
+                                  : findRingPage(instance, page_id, strategy);
+    if (pagePtr == nullptr) {
+      return pagePtr;
+    }
+    Page *resident;
+    if (!instance->page_table_->Find(page_id, resident)) {
+      break;
+    }
+    // loaded by another thread while the latch was released
+    releaseFrame(instance, pagePtr);
   }
 
+  if (!disk_manager_->ReadPage(page_id, pagePtr->data_)) {
+    // the page is unreadable or corrupt, hand the frame back
+    pagePtr->ResetMemory();
+    releaseFrame(instance, pagePtr);
+    return nullptr;
+  }
   pagePtr->page_id_ = page_id;
-  pagePtr->pin_count_ = 1;
-  pagePtr->is_dirty_ = true;
-  disk_manager_->ReadPage(page_id, pagePtr->data_);
+  pagePtr->is_dirty_ = false;
+  pagePtr->read_failed_ = false;
+  pagePtr->rec_lsn_ = nextLSN();
+  if (page_recovery_ != nullptr) {
+    // the disk image may miss logged changes after a crash
+    lsn_t rec_lsn = page_recovery_->RecoverPage(pagePtr);
+    if (rec_lsn != INVALID_LSN) {
+      pagePtr->is_dirty_ = true;
+      pagePtr->rec_lsn_ = rec_lsn;
+    }
+  }
 
-  page_table_->Insert(page_id, pagePtr);
+  instance->replacer_->RecordAccess(pagePtr);
+  instance->page_table_->Insert(page_id, pagePtr);
+  // publishing the pin count makes the frame visible to the lock-free path
+  pagePtr->pin_count_ = 1;
   return pagePtr;
 }
 
+/*
+ * Like FetchPage, but gives up instead of reading the page or waiting for a
+ * read of it that is already in flight
+ */
+Page *BufferPoolManager::TryFetchPage(page_id_t page_id) {
+  BufferPoolInstance *instance = GetInstance(page_id);
+
+  Page* pagePtr = nullptr;
+  if (instance->page_table_->Find(page_id, pagePtr) &&
+      tryPinPage(instance, pagePtr, page_id)) {
+    if (!pagePtr->read_failed_) {
+      instance->replacer_->RecordAccess(pagePtr);
+      return pagePtr;
+    }
+    unpinFrame(instance, pagePtr);
+  }
+
+  std::lock_guard<std::mutex> guard(instance->latch_);
+  if (instance->page_table_->Find(page_id, pagePtr) &&
+      tryPinPage(instance, pagePtr, page_id)) {
+    if (!pagePtr->read_failed_) {
+      instance->replacer_->RecordAccess(pagePtr);
+      return pagePtr;
+    }
+    unpinFrame(instance, pagePtr);
+  }
+  return nullptr;
+}
+
+/*
+ * Queue page_id for the read-ahead thread. Requests beyond what the pool
+ * could hold are dropped, since the pages would evict each other anyway
+ */
+void BufferPoolManager::PrefetchPage(page_id_t page_id,
+                                     AccessStrategy *strategy) {
+  if (page_id == INVALID_PAGE_ID) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(prefetch_latch_);
+  if (prefetch_queue_.size() >= pool_size_) {
+    return;
+  }
+  prefetch_queue_.emplace_back(page_id, strategy);
+  if (prefetch_thread_ == nullptr) {
+    prefetch_running_ = true;
+    prefetch_thread_ = new std::thread([&] {
+      std::unique_lock<std::mutex> lock(prefetch_latch_);
+      while (true) {
+        prefetch_cv_.wait(lock, [&] {
+          return !prefetch_running_ || !prefetch_queue_.empty();
+        });
+        if (!prefetch_running_) {
+          break;
+        }
+        auto request = prefetch_queue_.front();
+        prefetch_queue_.pop_front();
+        prefetch_strategy_ = request.second;
+        lock.unlock();
+        prefetchPage(request.first, request.second);
+        lock.lock();
+        prefetch_strategy_ = nullptr;
+        // a strategy that is going away may wait for this read
+        prefetch_cv_.notify_all();
+      }
+    });
+  }
+  prefetch_cv_.notify_all();
+}
+
 /*
  * Implementation of unpin page
  * if pin_count>0, decrement it and if it becomes zero, put it back to
- * replacer if pin_count<=0 before this call, return false. is_dirty: set the
- * dirty flag of this page
+ * replacer if pin_count<=0 before this call, return false. is_dirty: mark
+ * the page dirty, a clean unpin never clears an earlier dirty mark
+ * The caller's pin keeps the page resident, so this never needs the instance
+ * latch unless the lock-free lookup races with a page table update.
  */
-bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
-  std::lock_guard<std::mutex> guard(latch_);
+bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty,
+                                  bool is_cold) {
+  BufferPoolInstance *instance = GetInstance(page_id);
 
   Page* pagePtr = nullptr;
-  if (!page_table_->Find(page_id, pagePtr)) {
-    return false;
+  if (!instance->page_table_->Find(page_id, pagePtr) ||
+      pagePtr->page_id_ != page_id) {
+    std::lock_guard<std::mutex> guard(instance->latch_);
+    if (!instance->page_table_->Find(page_id, pagePtr)) {
+      return false;
+    }
   }
 
-    
   if (pagePtr->pin_count_ <= 0) {
     return false;
   }
-  pagePtr->pin_count_--;
-  if (pagePtr->is_dirty_ && !is_dirty) {
-    disk_manager_->WritePage(page_id, pagePtr->GetData());
-  }
-  pagePtr->is_dirty_ = is_dirty;
-  if (pagePtr->pin_count_ == 0) {
-    replacer_->Insert(pagePtr);
+  // write-back: the dirty flag is sticky until the page is written out on
+  // eviction, by FlushPage or by the page cleaner
+  if (is_dirty) {
+    pagePtr->is_dirty_ = true;
   }
+  unpinFrame(instance, pagePtr, is_cold);
   return true;
 }
 
@@ -110,21 +308,123 @@ bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
  * NOTE: make sure page_id != INVALID_PAGE_ID
  */
 bool BufferPoolManager::FlushPage(page_id_t page_id) {
-  std::lock_guard<std::mutex> guard(latch_);
   if (page_id == INVALID_PAGE_ID) {
     return false;
   }
+  BufferPoolInstance *instance = GetInstance(page_id);
+  std::lock_guard<std::mutex> guard(instance->latch_);
   Page* pagePtr;
-  if (!page_table_->Find(page_id, pagePtr)) {
+  if (!instance->page_table_->Find(page_id, pagePtr)) {
     return false;
   }
-  if (pagePtr->is_dirty_) {
-    disk_manager_->WritePage(page_id, pagePtr->data_);
-    pagePtr->is_dirty_ = false;
+  // clear the flag before writing, so an update that is unpinned while the
+  // write is in flight keeps the page dirty. Unless the page is pinned, any
+  // update after the write is logged at or after rec_lsn
+  lsn_t rec_lsn = nextLSN();
+  bool unpinned = pagePtr->pin_count_ == 0;
+  if (pagePtr->is_dirty_.exchange(false)) {
+    if (!disk_manager_->WritePage(page_id, pagePtr->data_)) {
+      // the disk image may be torn, the frame holds the only good copy
+      pagePtr->is_dirty_ = true;
+      return false;
+    }
+    if (unpinned) {
+      pagePtr->rec_lsn_ = rec_lsn;
+    }
   }
   return true;
 }
 
+/*
+ * Flush a batch of pages. Every dirty page stays pinned while it is written,
+ * frames are not claimed since another instance latch may be needed while
+ * earlier pages are already held. The pinned pages are sorted so that
+ * adjacent page ids, which live in different instances, are written together
+ */
+bool BufferPoolManager::FlushPages(const std::vector<page_id_t> &page_ids) {
+  std::vector<std::pair<page_id_t, Page *>> held;
+  // new recLSN of each held page, INVALID_LSN if others pinned it too
+  std::map<Page *, lsn_t> rec_lsns;
+  lsn_t max_lsn = INVALID_LSN;
+  for (auto page_id : page_ids) {
+    if (page_id == INVALID_PAGE_ID) {
+      continue;
+    }
+    BufferPoolInstance *instance = GetInstance(page_id);
+    std::lock_guard<std::mutex> guard(instance->latch_);
+    Page *pagePtr;
+    bool found;
+    // wait for a write by the page cleaner or a read-ahead to finish
+    while ((found = instance->page_table_->Find(page_id, pagePtr)) &&
+           !tryPinPage(instance, pagePtr, page_id)) {
+      waitForClaim(instance, pagePtr);
+    }
+    if (!found) {
+      continue;
+    }
+    lsn_t rec_lsn = nextLSN();
+    bool exclusive = pagePtr->pin_count_ == 1;
+    if (!pagePtr->is_dirty_.exchange(false)) {
+      unpinFrame(instance, pagePtr);
+      continue;
+    }
+    held.emplace_back(page_id, pagePtr);
+    rec_lsns[pagePtr] = exclusive ? rec_lsn : INVALID_LSN;
+    max_lsn = std::max(max_lsn, pagePtr->GetLSN());
+  }
+
+  if (ENABLE_LOGGING && !held.empty()) {
+    assert(log_manager_ != nullptr);
+    log_manager_->WaitLogIntoDisk(max_lsn, true);
+  }
+  std::sort(held.begin(), held.end());
+  bool ok = true;
+  std::vector<const char *> run;
+  for (size_t begin = 0, end; begin < held.size(); begin = end) {
+    run.clear();
+    for (end = begin;
+         end < held.size() &&
+         held[end].first == held[begin].first + static_cast<int>(end - begin);
+         ++end) {
+      run.push_back(held[end].second->data_);
+    }
+    if (!disk_manager_->WritePages(held[begin].first, run)) {
+      ok = false;
+      for (size_t i = begin; i < end; ++i) {
+        held[i].second->is_dirty_ = true;
+      }
+      continue;
+    }
+    for (size_t i = begin; i < end; ++i) {
+      if (rec_lsns[held[i].second] != INVALID_LSN) {
+        held[i].second->rec_lsn_ = rec_lsns[held[i].second];
+      }
+    }
+  }
+  if (!held.empty()) {
+    ok = disk_manager_->SyncPages() && ok;
+  }
+
+  for (auto &page : held) {
+    unpinFrame(GetInstance(page.first), page.second);
+  }
+  return ok;
+}
+
+/*
+ * Flush every page that is dirty at the time of the call, e.g. at shutdown
+ */
+bool BufferPoolManager::FlushAllPages() {
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < pool_size_; ++i) {
+    page_id_t page_id = pages_[i].page_id_;
+    if (page_id != INVALID_PAGE_ID && pages_[i].is_dirty_) {
+      page_ids.push_back(page_id);
+    }
+  }
+  return FlushPages(page_ids);
+}
+
 /**
  * User should call this method for deleting a page. This routine will call
  * disk manager to deallocate the page. First, if page is found within page
@@ -134,21 +434,26 @@ bool BufferPoolManager::FlushPage(page_id_t page_id) {
  * the page is found within page table, but pin_count != 0, return false
  */
 bool BufferPoolManager::DeletePage(page_id_t page_id) { 
-  std::lock_guard<std::mutex> guard(latch_);
+  BufferPoolInstance *instance = GetInstance(page_id);
+  std::lock_guard<std::mutex> guard(instance->latch_);
 
   Page* pagePtr = nullptr;
-  if (page_table_->Find(page_id, pagePtr)) {
-    if (pagePtr->pin_count_ != 0) {
+  bool claimed;
+  while (instance->page_table_->Find(page_id, pagePtr) &&
+         !claimFrame(pagePtr, &claimed)) {
+    if (!claimed) {
       return false;
     }
+    waitForClaim(instance, pagePtr);
+  }
+  if (instance->page_table_->Find(page_id, pagePtr)) {
+    instance->page_table_->Remove(page_id);
+    instance->replacer_->Erase(pagePtr);
     pagePtr->ResetMemory();
     pagePtr->page_id_ = INVALID_PAGE_ID;
     pagePtr->is_dirty_ = false;
     pagePtr->pin_count_ = 0;
-
-    page_table_->Remove(page_id);
-    replacer_->Erase(pagePtr);
-    free_list_->push_back(pagePtr);
+    instance->free_list_->push_back(pagePtr);
   }
 
   disk_manager_->DeallocatePage(page_id);
@@ -162,48 +467,554 @@ bool BufferPoolManager::DeletePage(page_id_t page_id) {
  * from free list or lru replacer(NOTE: always choose from free list first),
  * update new page's metadata, zero out memory and add corresponding entry
  * into page table. return nullptr if all the pages in pool are pinned
+ * The page id decides which partition caches the page. A frame is found in
+ * the partition of the page id the disk manager is about to hand out before
+ * the page is allocated, so a full partition costs no allocation. If another
+ * thread takes that page id first and the page allocated instead belongs to
+ * another partition, the frame is given back and the search moves there.
+ */
+Page *BufferPoolManager::NewPage(page_id_t &page_id,
+                                 AccessStrategy *strategy) {
+  page_id_t new_page_id = disk_manager_->PeekNextPage();
+  bool allocated = false;
+  while (true) {
+    BufferPoolInstance *instance = GetInstance(new_page_id);
+    std::lock_guard<std::mutex> guard(instance->latch_);
+    Page *pagePtr = strategy == nullptr
+                        ? findUnusedPage(instance)
+                        : findRingPage(instance, new_page_id, strategy);
+    if (pagePtr == nullptr) {
+      if (allocated) {
+        disk_manager_->DeallocatePage(new_page_id);
+      }
+      return nullptr;
+    }
+    if (!allocated) {
+      // a ring slot that recorded another page id only loses its frame
+      allocated = true;
+      new_page_id = disk_manager_->AllocatePage();
+      if (GetInstance(new_page_id) != instance) {
+        releaseFrame(instance, pagePtr);
+        continue;
+      }
+    }
+
+    page_id = new_page_id;
+    pagePtr->page_id_ = page_id;
+    LOG_DEBUG("NewPage() page id:%d", page_id);
+    pagePtr->is_dirty_ = true;
+    pagePtr->read_failed_ = false;
+    pagePtr->rec_lsn_ = nextLSN();
+    pagePtr->ResetMemory();
+    instance->page_table_->Insert(page_id, pagePtr);
+    pagePtr->pin_count_ = 1;
+    return pagePtr;
+  }
+}
+
+/*
+ * Find a frame for a new resident page within one partition, the caller
+ * must hold instance->latch_. The returned frame is claimed (pin count -1)
+ * and the caller publishes it by storing its real pin count.
+ * Replacer entries are maintained lazily: a page pinned by the lock-free path
+ * stays in the replacer, so victims that turn out to be pinned are dropped
+ * here and re-inserted once their pin count falls back to zero.
+ * A dirty victim whose log is not durable yet is passed over. If all victims
+ * are, the latch is released while waiting for the log, so callers must
+ * check again whether the page they want a frame for became resident.
  */
-Page *BufferPoolManager::NewPage(page_id_t &page_id) {
-  std::lock_guard<std::mutex> guard(latch_);
-  Page* pagePtr = findUnusedPage();
+Page *BufferPoolManager::findUnusedPage(BufferPoolInstance *instance) {
+  Page* pagePtr;
+  while (true) {
+    if (!instance->free_list_->empty()) {
+      pagePtr = instance->free_list_->front();
+      instance->free_list_->pop_front();
+      // a stale lock-free pin backs off as soon as it sees the invalid page id
+      while (!claimFrame(pagePtr)) {
+        std::this_thread::yield();
+      }
+      return pagePtr;
+    }
+
+    std::vector<Page *> deferred;
+    // victims whose write back failed, they stay dirty in their frames
+    std::vector<Page *> unwritten;
+    // victims the page cleaner or the read-ahead thread holds
+    std::vector<Page *> busy;
+    lsn_t min_lsn = INVALID_LSN;
+    pagePtr = nullptr;
+    while (instance->replacer_->Victim(pagePtr)) {
+      // a frame passed over must not be taken once the replacer runs dry
+      bool claimed;
+      if (!claimFrame(pagePtr, &claimed)) {
+        if (claimed) {
+          busy.push_back(pagePtr);
+        }
+        pagePtr = nullptr;
+        continue;
+      }
+      if (pagePtr->page_id_ == INVALID_PAGE_ID) {
+        // stale entry of a frame that sits in the free list
+        instance->replacer_->Erase(pagePtr);
+        pagePtr->pin_count_ = 0;
+        pagePtr = nullptr;
+        continue;
+      }
+      if (!isLogDurable(pagePtr)) {
+        pagePtr->pin_count_ = 0;
+        deferred.push_back(pagePtr);
+        if (min_lsn == INVALID_LSN || pagePtr->GetLSN() < min_lsn) {
+          min_lsn = pagePtr->GetLSN();
+        }
+        pagePtr = nullptr;
+        continue;
+      }
+      if (!evictPage(instance, pagePtr)) {
+        pagePtr->pin_count_ = 0;
+        unwritten.push_back(pagePtr);
+        pagePtr = nullptr;
+        continue;
+      }
+      break;
+    }
+    // victims passed over stay at the eviction end of the replacer
+    for (auto page : deferred) {
+      instance->replacer_->InsertCold(page);
+    }
+    for (auto page : unwritten) {
+      instance->replacer_->InsertCold(page);
+    }
+    for (auto page : busy) {
+      instance->replacer_->InsertCold(page);
+    }
+    if (pagePtr != nullptr) {
+      // the page left, its reference history goes with it
+      instance->replacer_->Erase(pagePtr);
+      return pagePtr;
+    }
+    if (!busy.empty()) {
+      // one page write or read, shorter than a wait for the log
+      waitForClaim(instance, busy.front());
+      continue;
+    }
+    if (deferred.empty()) {
+      return nullptr;
+    }
+    // every victim is waiting for the log, wait for the first one to become
+    // evictable without holding the instance latch, then look again
+    instance->latch_.unlock();
+    log_manager_->WaitLogIntoDisk(min_lsn, true);
+    instance->latch_.lock();
+  }
+}
+
+/*
+ * Put a claimed frame that holds no page back into the free list, the
+ * caller must hold instance->latch_
+ */
+void BufferPoolManager::releaseFrame(BufferPoolInstance *instance,
+                                     Page *pagePtr) {
+  pagePtr->pin_count_ = 0;
+  instance->free_list_->push_back(pagePtr);
+}
+
+/*
+ * The recLSN of a page that matches its disk image and is changed only from
+ * now on. Without logging, recLSNs are never asked for
+ */
+lsn_t BufferPoolManager::nextLSN() {
+  return log_manager_ == nullptr ? INVALID_LSN : log_manager_->GetNextLSN();
+}
+
+/*
+ * A dirty page can only be written once the log up to its LSN is on disk
+ */
+bool BufferPoolManager::isLogDurable(Page *page) {
+  return !page->is_dirty_ || !ENABLE_LOGGING || log_manager_ == nullptr ||
+         page->GetLSN() <= log_manager_->GetPersistentLSN();
+}
+
+/*
+ * Find a frame for page_id through the strategy's ring, the caller must
+ * hold instance->latch_. Until the ring is full its frames come from
+ * findUnusedPage. Afterwards the next ring frame is recycled, unless it is
+ * pinned or has been evicted for another page meanwhile, in which case a
+ * frame from findUnusedPage takes its place in the ring.
+ */
+Page *BufferPoolManager::findRingPage(BufferPoolInstance *instance,
+                                      page_id_t page_id,
+                                      AccessStrategy *strategy) {
+  AccessStrategy::Ring &ring =
+      strategy->rings_[static_cast<size_t>(page_id) % instances_.size()];
+  size_t slot;
+  Page *pagePtr = nullptr;
+  if (ring.slots_.size() < ring.capacity_) {
+    ring.slots_.push_back({nullptr, INVALID_PAGE_ID});
+    slot = ring.slots_.size() - 1;
+  } else {
+    slot = ring.next_;
+    ring.next_ = (ring.next_ + 1) % ring.capacity_;
+    Page *frame = ring.slots_[slot].frame_;
+    if (frame != nullptr && frame->page_id_ == ring.slots_[slot].page_id_ &&
+        claimFrame(frame)) {
+      if (frame->page_id_ == ring.slots_[slot].page_id_ &&
+          isLogDurable(frame) && evictPage(instance, frame)) {
+        instance->replacer_->Erase(frame);
+        pagePtr = frame;
+      } else {
+        frame->pin_count_ = 0;
+      }
+    }
+  }
+
   if (pagePtr == nullptr) {
-    return nullptr;
+    // may release the instance latch, so the slot is looked up again
+    pagePtr = findUnusedPage(instance);
   }
+  ring.slots_[slot].frame_ = pagePtr;
+  ring.slots_[slot].page_id_ = page_id;
+  return pagePtr;
+}
 
-  page_id = disk_manager_->AllocatePage();
-  pagePtr->page_id_ = page_id;
-  LOG_DEBUG("NewPage() page id:%d", pagePtr->page_id_);
-  pagePtr->is_dirty_ = true;
-  pagePtr->pin_count_ = 1;
+/*
+ * Write back the page held by a claimed frame if it is dirty and unmap it,
+ * the caller must hold instance->latch_. If the write fails the page stays
+ * mapped and dirty, and the frame cannot be reused
+ */
+bool BufferPoolManager::evictPage(BufferPoolInstance *instance,
+                                  Page *pagePtr) {
+  if (pagePtr->is_dirty_) {
+    if (ENABLE_LOGGING) {
+      assert(log_manager_ != nullptr);
+      //blocked until content of this page is written into disk
+      log_manager_->WaitLogIntoDisk(pagePtr->GetLSN(), true);
+    }
+    // the frame is claimed, nobody changes the page while it is written
+    if (!disk_manager_->WritePageInPlace(pagePtr->page_id_, pagePtr->data_)) {
+      LOG_DEBUG("cannot write back page %d, keep it",
+                pagePtr->page_id_.load());
+      return false;
+    }
+    pagePtr->is_dirty_ = false;
+    // the cleaner fell behind, let it catch up before the next eviction
+    cleaner_cv_.notify_one();
+  }
+  instance->page_table_->Remove(pagePtr->page_id_);
+  pagePtr->page_id_ = INVALID_PAGE_ID;
   pagePtr->ResetMemory();
-  page_table_->Insert(page_id, pagePtr);
-  return pagePtr;
+  return true;
 }
 
-Page *BufferPoolManager::findUnusedPage() {
-  Page* pagePtr;
-  if (!free_list_->empty()) {
-    pagePtr = free_list_->front();
-    free_list_->pop_front();
-    return pagePtr;
+/*
+ * Take exclusive ownership of an unpinned frame by moving its pin count from
+ * 0 to -1, which makes the lock-free path back off. Returns false if pinned,
+ * or if claimed, then *claimed is set. The caller must hold the instance
+ * latch, so the only competing claims are the page cleaner's and the
+ * read-ahead thread's, which are released as soon as their page write or
+ * read is done.
+ */
+bool BufferPoolManager::claimFrame(Page *page, bool *claimed) {
+  int unpinned = 0;
+  bool ok = page->pin_count_.compare_exchange_strong(unpinned, -1);
+  if (claimed != nullptr) {
+    *claimed = !ok && unpinned < 0;
+  }
+  return ok;
+}
+
+/*
+ * Wait until the page cleaner or the read-ahead thread releases its claim on
+ * page. The instance latch the caller holds is released meanwhile, so the
+ * caller has to look the page up again. Once released, the frame may be
+ * claimed again before this thread runs, which is why a release is counted
+ */
+void BufferPoolManager::waitForClaim(BufferPoolInstance *instance,
+                                     Page *page) {
+  std::unique_lock<std::mutex> lock(claim_latch_);
+  uint64_t releases = claim_releases_;
+  instance->latch_.unlock();
+  claim_cv_.wait(lock, [&] {
+    return page->pin_count_ >= 0 || claim_releases_ != releases;
+  });
+  lock.unlock();
+  instance->latch_.lock();
+}
+
+/*
+ * Release a claim that is held while the instance latch is not
+ */
+void BufferPoolManager::releaseClaim(Page *page) {
+  page->pin_count_ = 0;
+  {
+    std::lock_guard<std::mutex> guard(claim_latch_);
+    claim_releases_++;
+  }
+  claim_cv_.notify_all();
+}
+
+/*
+ * Pin a frame found by the lock-free lookup. Fails if the frame is claimed
+ * or has been reassigned to another page since the lookup.
+ */
+bool BufferPoolManager::tryPinPage(BufferPoolInstance *instance, Page *page,
+                                   page_id_t page_id) {
+  int pin_count = page->pin_count_;
+  do {
+    if (pin_count < 0) {
+      return false;
+    }
+  } while (!page->pin_count_.compare_exchange_weak(pin_count, pin_count + 1));
+
+  if (page->page_id_ != page_id) {
+    unpinFrame(instance, page);
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Drop one pin, a frame whose pin count reaches zero becomes a victim
+ * candidate again
+ */
+void BufferPoolManager::unpinFrame(BufferPoolInstance *instance, Page *page,
+                                   bool is_cold) {
+  if (page->pin_count_.fetch_sub(1) == 1) {
+    if (is_cold) {
+      instance->replacer_->InsertCold(page);
+    } else {
+      instance->replacer_->Insert(page);
+    }
   }
-  if (replacer_->Victim(pagePtr)) {
-    page_table_->Remove(pagePtr->page_id_);
-    if (pagePtr->is_dirty_) {
-      if (ENABLE_LOGGING) {
-        assert(log_manager_ != nullptr);
-        //blocked until content of this page is written into disk
-        log_manager_->WaitLogIntoDisk(pagePtr->GetLSN(), true);
+}
+
+/*
+ * Start the page cleaner. Every PAGE_CLEANER_INTERVAL it visits all
+ * instances, or earlier if a foreground eviction had to write a dirty victim
+ */
+void BufferPoolManager::RunPageCleaner(size_t clean_target,
+                                       size_t write_rate) {
+  assert(!cleaner_running_);
+  clean_target_ = clean_target;
+  write_rate_ = write_rate;
+  cleaner_running_ = true;
+
+  cleaner_thread_ = new std::thread([&] {
+    std::unique_lock<std::mutex> lock(cleaner_latch_);
+    size_t next_instance = 0;
+    while (cleaner_running_) {
+      // spread the write rate evenly over the wake ups
+      size_t budget = std::max<size_t>(
+          1, write_rate_ * PAGE_CLEANER_INTERVAL.count() / 1000);
+      lock.unlock();
+      for (size_t i = 0; i < instances_.size() && budget > 0; ++i) {
+        budget -= cleanInstance(instances_[next_instance], budget);
+        next_instance = (next_instance + 1) % instances_.size();
       }
-      disk_manager_->WritePage(pagePtr->page_id_, pagePtr->data_);
-      pagePtr->is_dirty_ = false;
+      lock.lock();
+      cleaner_cv_.wait_for(lock, PAGE_CLEANER_INTERVAL);
     }
-    pagePtr->page_id_ = INVALID_PAGE_ID;
-    pagePtr->ResetMemory();
+  });
+}
 
-    return pagePtr;
+/*
+ * Stop and join the page cleaner thread
+ */
+void BufferPoolManager::StopPageCleaner() {
+  {
+    std::lock_guard<std::mutex> guard(cleaner_latch_);
+    cleaner_running_ = false;
+  }
+  cleaner_cv_.notify_one();
+  cleaner_thread_->join();
+  delete cleaner_thread_;
+  cleaner_thread_ = nullptr;
+}
+
+/*
+ * Write out up to budget dirty pages among the next clean_target_ victims of
+ * one instance, return the number of pages written.
+ * Frames are claimed under the instance latch, which keeps them from being
+ * pinned or evicted, but the writes happen after the latch is released and
+ * are all in flight at the same time. A page whose latest log record is not
+ * durable yet is skipped rather than waited for, so the cleaner never stalls
+ * behind the log.
+ */
+size_t BufferPoolManager::cleanInstance(BufferPoolInstance *instance,
+                                        size_t budget) {
+  std::vector<Page *> candidates;
+  std::vector<Page *> claimed;
+  // claimed frames are not changed until they are released
+  lsn_t rec_lsn = nextLSN();
+  {
+    std::lock_guard<std::mutex> guard(instance->latch_);
+    size_t free_frames = instance->free_list_->size();
+    if (free_frames >= clean_target_) {
+      return 0;
+    }
+    instance->replacer_->NextVictims(candidates, clean_target_ - free_frames);
+    for (auto page : candidates) {
+      if (claimed.size() == budget) {
+        break;
+      }
+      int unpinned = 0;
+      if (!page->is_dirty_ || page->page_id_ == INVALID_PAGE_ID ||
+          !page->pin_count_.compare_exchange_strong(unpinned, -1)) {
+        continue;
+      }
+      if (ENABLE_LOGGING && log_manager_ != nullptr &&
+          page->GetLSN() > log_manager_->GetPersistentLSN()) {
+        page->pin_count_ = 0;
+        continue;
+      }
+      claimed.push_back(page);
+    }
+  }
+
+  std::mutex latch;
+  std::condition_variable cv;
+  size_t pending = claimed.size();
+  for (auto page : claimed) {
+    disk_manager_->WritePageAsync(
+        page->page_id_, page->data_, [&, page](bool ok) {
+          if (ok) {
+            page->is_dirty_ = false;
+            page->rec_lsn_ = rec_lsn;
+          }
+          releaseClaim(page);
+          std::lock_guard<std::mutex> guard(latch);
+          if (--pending == 0) {
+            cv.notify_one();
+          }
+        });
+  }
+  std::unique_lock<std::mutex> lock(latch);
+  cv.wait(lock, [&] { return pending == 0; });
+  return claimed.size();
+}
+
+/*
+ * Read one page ahead of its use. The frame is mapped in the page table but
+ * stays claimed while the asynchronous read runs, so a FetchPage of the page
+ * waits for this read instead of issuing its own. The read-ahead thread
+ * moves on without waiting, so many reads can be in flight.
+ * Once loaded, the page enters the replacer as a preferred victim, and only
+ * becomes a regular one when it is fetched and unpinned.
+ */
+void BufferPoolManager::prefetchPage(page_id_t page_id,
+                                     AccessStrategy *strategy) {
+  BufferPoolInstance *instance = GetInstance(page_id);
+  Page* pagePtr = nullptr;
+  {
+    std::lock_guard<std::mutex> guard(instance->latch_);
+    // a page under recovery is only read by FetchPage
+    if (page_recovery_ != nullptr ||
+        instance->page_table_->Find(page_id, pagePtr)) {
+      return;
+    }
+    pagePtr = strategy == nullptr ? findUnusedPage(instance)
+                                  : findRingPage(instance, page_id, strategy);
+    if (pagePtr == nullptr) {
+      return;
+    }
+    Page *resident;
+    if (instance->page_table_->Find(page_id, resident)) {
+      releaseFrame(instance, pagePtr);
+      return;
+    }
+    pagePtr->page_id_ = page_id;
+    pagePtr->is_dirty_ = false;
+    pagePtr->read_failed_ = false;
+    pagePtr->rec_lsn_ = nextLSN();
+    instance->page_table_->Insert(page_id, pagePtr);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(io_latch_);
+    pending_io_++;
+  }
+  disk_manager_->ReadPageAsync(
+      page_id, pagePtr->data_, [this, instance, pagePtr](bool ok) {
+        // the instance latch must not be taken here, FetchPage retries the
+        // read of a page marked as failed
+        pagePtr->read_failed_ = !ok;
+        releaseClaim(pagePtr);
+        instance->replacer_->InsertCold(pagePtr);
+        finishIO();
+      });
+}
+
+void BufferPoolManager::finishIO() {
+  std::lock_guard<std::mutex> guard(io_latch_);
+  if (--pending_io_ == 0) {
+    io_cv_.notify_all();
+  }
+}
+
+/*
+ * Drop the queued read-ahead requests of a strategy that is being destroyed
+ * and wait for one that is already being served
+ */
+void BufferPoolManager::forgetAccessStrategy(AccessStrategy *strategy) {
+  std::unique_lock<std::mutex> lock(prefetch_latch_);
+  for (auto it = prefetch_queue_.begin(); it != prefetch_queue_.end();) {
+    if (it->second == strategy) {
+      it = prefetch_queue_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  prefetch_cv_.wait(lock, [&] { return prefetch_strategy_ != strategy; });
+}
+
+/*
+ * A page belongs to the dirty page table while it is dirty, pinned, which
+ * includes pages that are being changed but are not marked dirty yet, or
+ * claimed by a write in flight. Holding the instance latch keeps FlushPage
+ * and evictions, whose writes are not visible otherwise, out of the way.
+ * The recLSN of every other page is moved up to the next lsn on the way:
+ * the lsn is read before the pin count, so a page pinned after that only
+ * gets changes logged after it
+ */
+void BufferPoolManager::GetDirtyPageTable(
+    std::vector<std::pair<page_id_t, lsn_t>> &dpt) {
+  // pending pages first: a page that stops being pending afterwards is read
+  // under its instance latch, and found by the loop below
+  {
+    std::lock_guard<std::mutex> guard(instances_[0]->latch_);
+    if (page_recovery_ != nullptr) {
+      page_recovery_->GetPendingPages(dpt);
+    }
+  }
+  for (auto instance : instances_) {
+    std::lock_guard<std::mutex> guard(instance->latch_);
+    lsn_t rec_lsn = nextLSN();
+    for (size_t i = 0; i < instance->size_; ++i) {
+      Page *page = &instance->pages_[i];
+      page_id_t page_id = page->page_id_;
+      if (page_id == INVALID_PAGE_ID) {
+        continue;
+      }
+      if (page->pin_count_ == 0 && !page->is_dirty_) {
+        page->rec_lsn_ = rec_lsn;
+        continue;
+      }
+      dpt.emplace_back(page_id, page->rec_lsn_);
+    }
+  }
+}
+
+/*
+ * Every instance latch is held at once, so no FetchPage is in the middle of
+ * recovering a page through the previous PageRecovery
+ */
+void BufferPoolManager::SetPageRecovery(PageRecovery *page_recovery) {
+  for (auto instance : instances_) {
+    instance->latch_.lock();
+  }
+  page_recovery_ = page_recovery;
+  for (auto instance : instances_) {
+    instance->latch_.unlock();
   }
-  return nullptr;
 }
 
 void BufferPoolManager::GetPinPages(std::map<page_id_t, int> &m) {
@@ -215,11 +1026,19 @@ void BufferPoolManager::GetPinPages(std::map<page_id_t, int> &m) {
 }
 
 int BufferPoolManager::GetReplacerSize() {
-  return replacer_->Size();
+  int size = 0;
+  for (auto instance : instances_) {
+    size += instance->replacer_->Size();
+  }
+  return size;
 }
 
 int BufferPoolManager::GetFreeListSize() {
-  return free_list_->size();
+  int size = 0;
+  for (auto instance : instances_) {
+    size += instance->free_list_->size();
+  }
+  return size;
 }
 
 } // namespace cmudb
@@ -0,0 +1,115 @@
+/**
+ * CLOCK implementation
+ */
+#include <cassert>
+
+#include "buffer/clock_replacer.h"
+#include "page/page.h"
+
+namespace cmudb {
+
+template <typename T>
+ClockReplacer<T>::ClockReplacer(T base, size_t num_frames)
+    : base_(base), num_frames_(num_frames), size_(0), hand_(0) {
+  evictable_ = new std::atomic<bool>[num_frames_];
+  referenced_ = new std::atomic<bool>[num_frames_];
+  for (size_t i = 0; i < num_frames_; ++i) {
+    evictable_[i] = false;
+    referenced_[i] = false;
+  }
+}
+
+template <typename T> ClockReplacer<T>::~ClockReplacer() {
+  delete[] evictable_;
+  delete[] referenced_;
+}
+
+/*
+ * Make value evictable and give it a second chance
+ */
+template <typename T> void ClockReplacer<T>::Insert(const T &value) {
+  size_t slot = SlotOf(value);
+  referenced_[slot] = true;
+  if (!evictable_[slot].exchange(true)) {
+    size_++;
+  }
+}
+
+/*
+ * Make value evictable with its reference bit clear, so the clock hand takes
+ * it the first time it passes by
+ */
+template <typename T> void ClockReplacer<T>::InsertCold(const T &value) {
+  size_t slot = SlotOf(value);
+  referenced_[slot] = false;
+  if (!evictable_[slot].exchange(true)) {
+    size_++;
+  }
+}
+
+/*
+ * Sweep the clock hand until it meets an evictable frame whose reference bit
+ * is already clear. Two full sweeps are enough unless other threads keep
+ * setting reference bits, so give up after three.
+ */
+template <typename T> bool ClockReplacer<T>::Victim(T &value) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (size_t step = 0; step < 3 * num_frames_ && size_ > 0; ++step) {
+    size_t slot = hand_;
+    hand_ = (hand_ + 1) % num_frames_;
+    if (!evictable_[slot] || referenced_[slot].exchange(false)) {
+      continue;
+    }
+    if (evictable_[slot].exchange(false)) {
+      size_--;
+      value = base_ + slot;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Remove value from the clock. If removal is successful, return true,
+ * otherwise return false
+ */
+template <typename T> bool ClockReplacer<T>::Erase(const T &value) {
+  size_t slot = SlotOf(value);
+  if (evictable_[slot].exchange(false)) {
+    size_--;
+    return true;
+  }
+  return false;
+}
+
+template <typename T> size_t ClockReplacer<T>::Size() { return size_; }
+
+/*
+ * Replay the sweep without touching any bit: unreferenced frames are met on
+ * the first pass from the hand, referenced ones only on the second pass
+ */
+template <typename T>
+void ClockReplacer<T>::NextVictims(std::vector<T> &values, size_t count) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (int pass = 0; pass < 2; ++pass) {
+    for (size_t i = 0; i < num_frames_ && values.size() < count; ++i) {
+      size_t slot = (hand_ + i) % num_frames_;
+      if (evictable_[slot] && referenced_[slot] == (pass == 1)) {
+        values.push_back(base_ + slot);
+      }
+    }
+  }
+}
+
+template <typename T>
+size_t ClockReplacer<T>::SlotOf(const T &value) const {
+  size_t slot = static_cast<size_t>(value - base_);
+  assert(slot < num_frames_);
+  return slot;
+}
+
+template class ClockReplacer<Page *>;
+// test only
+template class ClockReplacer<int>;
+
+} // namespace cmudb
@@ -0,0 +1,56 @@
+/**
+ * frame_arena.cpp
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "buffer/frame_arena.h"
+#include "common/logger.h"
+
+namespace cmudb {
+
+// size of the default huge page on x86-64 and aarch64
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t RoundUp(size_t size, size_t unit) {
+  return (size + unit - 1) / unit * unit;
+}
+
+FrameArena::FrameArena(size_t size, bool huge_pages)
+    : data_(nullptr), mapped_size_(0), is_huge_pages_(false) {
+  void *data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (huge_pages) {
+    mapped_size_ = RoundUp(size, HUGE_PAGE_SIZE);
+    data = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data == MAP_FAILED) {
+      LOG_DEBUG("no huge pages reserved: %s", strerror(errno));
+    } else {
+      is_huge_pages_ = true;
+    }
+  }
+#endif
+  if (data == MAP_FAILED) {
+    mapped_size_ = RoundUp(size, sysconf(_SC_PAGESIZE));
+    data = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) {
+      madvise(data, mapped_size_, MADV_HUGEPAGE);
+    }
+#endif
+  }
+  data_ = static_cast<char *>(data);
+}
+
+FrameArena::~FrameArena() { munmap(data_, mapped_size_); }
+
+} // namespace cmudb
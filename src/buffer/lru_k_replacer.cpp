@@ -0,0 +1,215 @@
+/**
+ * LRU-K implementation
+ */
+#include <algorithm>
+#include <cassert>
+
+#include "buffer/lru_k_replacer.h"
+#include "page/page.h"
+
+namespace cmudb {
+
+template <typename T>
+LRUKReplacer<T>::LRUKReplacer(T base, size_t num_frames, size_t k,
+                              std::chrono::microseconds correlated_period)
+    : base_(base), num_frames_(num_frames), k_(k),
+      correlated_period_(correlated_period), size_(0),
+      current_timestamp_(0) {
+  assert(k_ > 0);
+  history_ = new uint64_t[num_frames_ * k_];
+  num_references_ = new size_t[num_frames_];
+  last_reference_ = new std::chrono::steady_clock::time_point[num_frames_];
+  accessed_ = new bool[num_frames_];
+  evictable_ = new bool[num_frames_];
+  for (size_t i = 0; i < num_frames_; ++i) {
+    num_references_[i] = 0;
+    accessed_[i] = false;
+    evictable_[i] = false;
+  }
+}
+
+template <typename T> LRUKReplacer<T>::~LRUKReplacer() {
+  delete[] history_;
+  delete[] num_references_;
+  delete[] last_reference_;
+  delete[] accessed_;
+  delete[] evictable_;
+}
+
+/*
+ * Make value evictable, recording a reference unless RecordAccess already
+ * did since value was last made evictable
+ */
+template <typename T> void LRUKReplacer<T>::Insert(const T &value) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  size_t slot = SlotOf(value);
+  if (accessed_[slot]) {
+    accessed_[slot] = false;
+  } else {
+    Reference(slot);
+  }
+
+  if (!evictable_[slot]) {
+    evictable_[slot] = true;
+    size_++;
+  }
+}
+
+/*
+ * Record a reference to value, which is pinned and stays as evictable as
+ * it is
+ */
+template <typename T> void LRUKReplacer<T>::RecordAccess(const T &value) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  size_t slot = SlotOf(value);
+  Reference(slot);
+  accessed_[slot] = true;
+}
+
+/*
+ * Make value evictable without recording a reference. A frame that has
+ * never been referenced goes before every frame that has
+ */
+template <typename T> void LRUKReplacer<T>::InsertCold(const T &value) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  size_t slot = SlotOf(value);
+  if (!evictable_[slot]) {
+    evictable_[slot] = true;
+    size_++;
+  }
+}
+
+/*
+ * Evict the frame with the largest backward K-distance. Frames with less
+ * than K references (infinite distance) win, ties are broken by the oldest
+ * remembered reference. The victim stops being evictable but keeps its
+ * history: the buffer pool may find it pinned and pass it over, and only
+ * calls Erase once its page really leaves.
+ */
+template <typename T> bool LRUKReplacer<T>::Victim(T &value) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  bool found = false;
+  size_t victim = 0;
+
+  for (size_t slot = 0; slot < num_frames_; ++slot) {
+    if (evictable_[slot] && (!found || EvictsBefore(slot, victim))) {
+      found = true;
+      victim = slot;
+    }
+  }
+  if (!found) {
+    return false;
+  }
+
+  evictable_[victim] = false;
+  size_--;
+  value = base_ + victim;
+  return true;
+}
+
+/*
+ * Remove value from the replacer together with its reference history. If
+ * value was evictable, return true, otherwise return false
+ */
+template <typename T> bool LRUKReplacer<T>::Erase(const T &value) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  size_t slot = SlotOf(value);
+  bool was_evictable = evictable_[slot];
+  ForgetHistory(slot);
+  return was_evictable;
+}
+
+template <typename T> size_t LRUKReplacer<T>::Size() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return size_;
+}
+
+template <typename T>
+void LRUKReplacer<T>::NextVictims(std::vector<T> &values, size_t count) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  std::vector<size_t> slots;
+  for (size_t slot = 0; slot < num_frames_; ++slot) {
+    if (evictable_[slot]) {
+      slots.push_back(slot);
+    }
+  }
+  count = std::min(count, slots.size());
+  std::partial_sort(
+      slots.begin(), slots.begin() + count, slots.end(),
+      [this](size_t a, size_t b) { return EvictsBefore(a, b); });
+  for (size_t i = 0; i < count; ++i) {
+    values.push_back(base_ + slots[i]);
+  }
+}
+
+/*
+ * Victim order: infinite backward K-distance first, then the oldest
+ * remembered reference, where a frame without references counts as the
+ * oldest of all. The caller must hold mutex_
+ */
+template <typename T>
+bool LRUKReplacer<T>::EvictsBefore(size_t slot, size_t other) const {
+  bool infinite = num_references_[slot] < k_;
+  bool other_infinite = num_references_[other] < k_;
+  if (infinite != other_infinite) {
+    return infinite;
+  }
+  if (num_references_[other] == 0) {
+    return false;
+  }
+  if (num_references_[slot] == 0) {
+    return true;
+  }
+  return history_[slot * k_ + num_references_[slot] - 1] <
+         history_[other * k_ + num_references_[other] - 1];
+}
+
+/*
+ * Add a reference to the history of slot, or only refresh the most recent
+ * one if it lies within the correlated period. The caller must hold mutex_
+ */
+template <typename T> void LRUKReplacer<T>::Reference(size_t slot) {
+  uint64_t *history = history_ + slot * k_;
+  uint64_t now = ++current_timestamp_;
+  auto time = std::chrono::steady_clock::now();
+
+  if (num_references_[slot] > 0 &&
+      time - last_reference_[slot] < correlated_period_) {
+    // correlated with the previous reference, only refresh it
+    history[0] = now;
+  } else {
+    if (num_references_[slot] < k_) {
+      num_references_[slot]++;
+    }
+    for (size_t i = num_references_[slot] - 1; i > 0; --i) {
+      history[i] = history[i - 1];
+    }
+    history[0] = now;
+  }
+  last_reference_[slot] = time;
+}
+
+/*
+ * This function is not applied lock, the caller must hold mutex_
+ */
+template <typename T> void LRUKReplacer<T>::ForgetHistory(size_t slot) {
+  if (evictable_[slot]) {
+    evictable_[slot] = false;
+    size_--;
+  }
+  num_references_[slot] = 0;
+  accessed_[slot] = false;
+}
+
+template <typename T>
+size_t LRUKReplacer<T>::SlotOf(const T &value) const {
+  size_t slot = static_cast<size_t>(value - base_);
+  assert(slot < num_frames_);
+  return slot;
+}
+
+template class LRUKReplacer<Page *>;
+// test only
+template class LRUKReplacer<int>;
+
+} // namespace cmudb
@@ -24,6 +24,16 @@ template <typename T> void LRUReplacer<T>::Insert(const T &value) {
   insertAtHead(value);
 }
 
+/*
+ * Insert value at the least recently used end
+ */
+template <typename T> void LRUReplacer<T>::InsertCold(const T &value) {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  erase(value);
+  insertAtTail(value);
+}
+
 /* If LRU is non-empty, pop the head member from LRU to argument "value", and
  * return true. If LRU is empty, return false
  */
@@ -57,6 +67,18 @@ template <typename T> bool LRUReplacer<T>::Erase(const T &value) {
 
 template <typename T> size_t LRUReplacer<T>::Size() { return this->size; }
 
+/*
+ * Walk from the least recently used end
+ */
+template <typename T>
+void LRUReplacer<T>::NextVictims(std::vector<T> &values, size_t count) {
+  std::lock_guard<std::mutex> guard(this->mutex);
+  for (auto ptr = this->tail; ptr != nullptr && values.size() < count;
+       ptr = ptr->pre) {
+    values.push_back(ptr->value);
+  }
+}
+
 template <typename T> void LRUReplacer<T>::insertAtHead(const T& value) {
   std::shared_ptr<DLinkedNode> ptr = std::make_shared<DLinkedNode>(value);
   this->index[value] = ptr;
@@ -75,6 +97,24 @@ template <typename T> void LRUReplacer<T>::insertAtHead(const T& value) {
   return;
 }
 
+template <typename T> void LRUReplacer<T>::insertAtTail(const T& value) {
+  std::shared_ptr<DLinkedNode> ptr = std::make_shared<DLinkedNode>(value);
+  this->index[value] = ptr;
+
+  ptr->next = nullptr;
+  ptr->pre = this->tail;
+  if (this->tail != nullptr) {
+    this->tail->next = ptr;
+  }
+  this->tail = ptr;
+  if (this->head == nullptr) {
+    this->head = ptr;
+  }
+
+  this->size++;
+  return;
+}
+
 /*
  * This function is not applied lock, 
  * which will be convenient for other function to invoke 
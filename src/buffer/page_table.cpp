@@ -0,0 +1,106 @@
+/**
+ * page_table.cpp
+ */
+
+#include <cassert>
+
+#include "buffer/page_table.h"
+
+namespace cmudb {
+
+/*
+ * Keep the load factor at or below one half so probe sequences stay short
+ */
+PageTable::PageTable(size_t num_frames) {
+  size_t num_slots = 2;
+  int bits = 1;
+  while (num_slots < 2 * num_frames) {
+    num_slots <<= 1;
+    bits++;
+  }
+  mask_ = num_slots - 1;
+  shift_ = 32 - bits;
+  slots_ = new Slot[num_slots];
+  for (size_t i = 0; i < num_slots; ++i) {
+    slots_[i].key_ = INVALID_PAGE_ID;
+    slots_[i].value_ = nullptr;
+  }
+}
+
+PageTable::~PageTable() { delete[] slots_; }
+
+/*
+ * Page ids routed to one instance share a residue modulo the number of
+ * instances, so scramble them (Fibonacci hashing) before masking
+ */
+size_t PageTable::HomeSlot(page_id_t page_id) const {
+  uint32_t hash = static_cast<uint32_t>(page_id) * 2654435769u;
+  return (hash >> shift_) & mask_;
+}
+
+/*
+ * lookup function, safe to call without holding the instance latch
+ */
+bool PageTable::Find(const page_id_t &page_id, Page *&page) {
+  for (size_t i = HomeSlot(page_id);; i = (i + 1) & mask_) {
+    page_id_t key = slots_[i].key_;
+    if (key == INVALID_PAGE_ID) {
+      return false;
+    }
+    if (key == page_id) {
+      Page *value = slots_[i].value_;
+      if (value == nullptr) {
+        return false;
+      }
+      page = value;
+      return true;
+    }
+  }
+}
+
+/*
+ * Insert a new mapping, page_id must not be in the table yet
+ */
+void PageTable::Insert(const page_id_t &page_id, Page *const &page) {
+  size_t i = HomeSlot(page_id);
+  while (slots_[i].key_ != INVALID_PAGE_ID) {
+    assert(slots_[i].key_ != page_id);
+    i = (i + 1) & mask_;
+  }
+  // publish the value before the key makes the slot visible to readers
+  slots_[i].value_ = page;
+  slots_[i].key_ = page_id;
+}
+
+/*
+ * Remove a mapping with backward shift deletion, so no tombstones are left
+ * behind and probe sequences never degrade over time
+ */
+bool PageTable::Remove(const page_id_t &page_id) {
+  size_t hole = HomeSlot(page_id);
+  while (slots_[hole].key_ != page_id) {
+    if (slots_[hole].key_ == INVALID_PAGE_ID) {
+      return false;
+    }
+    hole = (hole + 1) & mask_;
+  }
+
+  for (size_t i = (hole + 1) & mask_; slots_[i].key_ != INVALID_PAGE_ID;
+       i = (i + 1) & mask_) {
+    size_t home = HomeSlot(slots_[i].key_);
+    // an entry may move back into the hole only if its home slot does not
+    // lie cyclically within (hole, i]
+    bool stays = (hole < i) ? (hole < home && home <= i)
+                            : (hole < home || home <= i);
+    if (!stays) {
+      slots_[hole].value_ = slots_[i].value_.load();
+      slots_[hole].key_ = slots_[i].key_.load();
+      hole = i;
+    }
+  }
+  slots_[hole].key_ = INVALID_PAGE_ID;
+  slots_[hole].value_ = nullptr;
+  return true;
+}
+
+} // namespace cmudb
@@ -4,4 +4,14 @@ namespace cmudb {
   std::atomic<bool> ENABLE_LOGGING(false);  // for virtual table
   std::chrono::duration<long long int> LOG_TIMEOUT =
    std::chrono::seconds(1);
+  std::chrono::microseconds GROUP_COMMIT_DELAY =
+   std::chrono::microseconds(0);
+  std::chrono::milliseconds ASYNC_COMMIT_DELAY =
+   std::chrono::milliseconds(10);
+  std::chrono::milliseconds PAGE_CLEANER_INTERVAL =
+   std::chrono::milliseconds(10);
+  std::chrono::milliseconds CHECKPOINT_INTERVAL =
+   std::chrono::milliseconds(30000);
+  std::chrono::microseconds LRUK_CORRELATED_PERIOD =
+   std::chrono::microseconds(1000);
 }
@@ -10,10 +10,18 @@ namespace cmudb {
 
 Transaction *TransactionManager::Begin() {
   Transaction *txn = new Transaction(next_txn_id_++);
+  txn->SetAsyncCommit(async_commit_);
 
   if (ENABLE_LOGGING) {
     // TODO: write log and update transaction's prev_lsn here
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
+    // a checkpoint that follows the BEGIN record in the log must find the
+    // transaction in the table, so it is registered first, with an lsn no
+    // larger than the one its BEGIN record gets. Appending stays lock-free
+    {
+      std::lock_guard<std::mutex> guard(latch_);
+      active_txns_[txn->GetTransactionId()] = log_manager_->GetNextLSN();
+    }
     lsn_t cur_lsn = log_manager_->AppendLogRecord(log_record);
     //LOG_DEBUG("AppendLogRecord() finished");
     txn->SetPrevLSN(cur_lsn);
@@ -43,8 +51,15 @@ void TransactionManager::Commit(Transaction *txn) {
     lsn_t cur_lsn = log_manager_->AppendLogRecord(log_record);
     txn->SetPrevLSN(cur_lsn);
 
-    // current thread will blocked until cur_lsn is written into disk
-    log_manager_->WaitLogIntoDisk(cur_lsn, false);
+    removeActiveTransaction(txn);
+
+    if (txn->IsAsyncCommit()) {
+      // without its COMMIT record on disk, recovery undoes the transaction
+      log_manager_->FlushWithinDelay(cur_lsn);
+    } else {
+      // current thread will blocked until cur_lsn is written into disk
+      log_manager_->WaitLogIntoDisk(cur_lsn, false);
+    }
   }
 
   // release all the lock
@@ -85,6 +100,7 @@ void TransactionManager::Abort(Transaction *txn) {
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
     lsn_t cur_lsn = log_manager_->AppendLogRecord(log_record);
     txn->SetPrevLSN(cur_lsn);
+    removeActiveTransaction(txn);
 
     // current thread will blocked until cur_lsn is written into disk
     log_manager_->WaitLogIntoDisk(cur_lsn, false);
@@ -101,4 +117,32 @@ void TransactionManager::Abort(Transaction *txn) {
     lock_manager_->Unlock(txn, locked_rid);
   }
 }
+
+Transaction *TransactionManager::Resume(txn_id_t txn_id, lsn_t begin_lsn,
+                                        lsn_t prev_lsn) {
+  ReserveTransactionId(txn_id);
+  Transaction *txn = new Transaction(txn_id);
+  txn->SetPrevLSN(prev_lsn);
+  std::lock_guard<std::mutex> guard(latch_);
+  active_txns_[txn_id] = begin_lsn;
+  return txn;
+}
+
+void TransactionManager::ReserveTransactionId(txn_id_t txn_id) {
+  txn_id_t next_txn_id = next_txn_id_;
+  while (next_txn_id <= txn_id &&
+         !next_txn_id_.compare_exchange_weak(next_txn_id, txn_id + 1)) {
+  }
+}
+
+void TransactionManager::GetActiveTransactions(
+    std::vector<std::pair<txn_id_t, lsn_t>> &att) {
+  std::lock_guard<std::mutex> guard(latch_);
+  att.assign(active_txns_.begin(), active_txns_.end());
+}
+
+void TransactionManager::removeActiveTransaction(Transaction *txn) {
+  std::lock_guard<std::mutex> guard(latch_);
+  active_txns_.erase(txn->GetTransactionId());
+}
 } // namespace cmudb
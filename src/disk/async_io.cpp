@@ -0,0 +1,292 @@
+/**
+ * async_io.cpp
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING
+#endif
+#endif
+
+#include "common/logger.h"
+#include "disk/async_io.h"
+
+namespace cmudb {
+
+AsyncIO *AsyncIO::Create(size_t queue_depth, size_t num_threads) {
+  UringAsyncIO *uring = new UringAsyncIO(queue_depth);
+  if (uring->IsValid()) {
+    return uring;
+  }
+  delete uring;
+  LOG_DEBUG("io_uring is not available, use a thread pool for async I/O");
+  return new ThreadPoolAsyncIO(queue_depth, num_threads);
+}
+
+/**
+ * Thread pool backend
+ */
+ThreadPoolAsyncIO::ThreadPoolAsyncIO(size_t queue_depth, size_t num_threads)
+    : queue_depth_(queue_depth), running_(true) {
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads_.push_back(std::thread(&ThreadPoolAsyncIO::Serve, this));
+  }
+}
+
+/*
+ * Requests already queued are still served before the workers exit
+ */
+ThreadPoolAsyncIO::~ThreadPoolAsyncIO() {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPoolAsyncIO::SubmitRead(int fd, char *buf, size_t size,
+                                   off_t offset, Callback callback) {
+  Submit(Request{false, fd, buf, size, offset, std::move(callback)});
+}
+
+void ThreadPoolAsyncIO::SubmitWrite(int fd, const char *buf, size_t size,
+                                    off_t offset, Callback callback) {
+  Submit(Request{true, fd, const_cast<char *>(buf), size, offset,
+                 std::move(callback)});
+}
+
+void ThreadPoolAsyncIO::Submit(Request request) {
+  std::unique_lock<std::mutex> lock(latch_);
+  cv_.wait(lock, [&] { return queue_.size() < queue_depth_; });
+  queue_.push_back(std::move(request));
+  cv_.notify_all();
+}
+
+void ThreadPoolAsyncIO::Serve() {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (true) {
+    cv_.wait(lock, [&] { return !running_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      break;
+    }
+    Request request = std::move(queue_.front());
+    queue_.pop_front();
+    // a submitter may be waiting for room in the queue
+    cv_.notify_all();
+    lock.unlock();
+
+    ssize_t ret;
+    do {
+      ret = request.is_write_ ? pwrite(request.fd_, request.buf_,
+                                       request.size_, request.offset_)
+                              : pread(request.fd_, request.buf_,
+                                      request.size_, request.offset_);
+    } while (ret < 0 && errno == EINTR);
+    request.callback_(ret < 0 ? -errno : ret);
+
+    lock.lock();
+  }
+}
+
+/**
+ * io_uring backend
+ */
+#ifdef HAVE_IO_URING
+
+UringAsyncIO::UringAsyncIO(size_t queue_depth)
+    : ring_fd_(-1), sq_ptr_(MAP_FAILED), sqes_(MAP_FAILED),
+      cq_ptr_(MAP_FAILED), in_flight_(0), reaper_(nullptr) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ring_fd = syscall(__NR_io_uring_setup, queue_depth, &params);
+  if (ring_fd < 0) {
+    return;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ptr_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ptr_ == MAP_FAILED) {
+    close(ring_fd);
+    return;
+  }
+  cq_ptr_ = single_mmap
+                ? sq_ptr_
+                : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (cq_ptr_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) {
+      munmap(cq_ptr_, cq_ring_size_);
+    }
+    munmap(sq_ptr_, sq_ring_size_);
+    close(ring_fd);
+    return;
+  }
+
+  char *sq = static_cast<char *>(sq_ptr_);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  char *cq = static_cast<char *>(cq_ptr_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+
+  // the completion queue is at least as large as the submission queue, so
+  // limiting requests in flight to the latter never overflows the former
+  queue_depth_ = params.sq_entries;
+  ring_fd_ = ring_fd;
+  reaper_ = new std::thread(&UringAsyncIO::Reap, this);
+}
+
+/*
+ * Wait for all requests in flight, then stop the reaper with a request that
+ * carries no callback
+ */
+UringAsyncIO::~UringAsyncIO() {
+  if (ring_fd_ < 0) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(latch_);
+    cv_.wait(lock, [&] { return in_flight_ == 0; });
+  }
+  Submit(IORING_OP_NOP, -1, nullptr, 0, 0, nullptr);
+  reaper_->join();
+  delete reaper_;
+
+  munmap(sqes_, sqes_size_);
+  if (cq_ptr_ != sq_ptr_) {
+    munmap(cq_ptr_, cq_ring_size_);
+  }
+  munmap(sq_ptr_, sq_ring_size_);
+  close(ring_fd_);
+}
+
+void UringAsyncIO::SubmitRead(int fd, char *buf, size_t size, off_t offset,
+                              Callback callback) {
+  Submit(IORING_OP_READV, fd, buf, size, offset, std::move(callback));
+}
+
+void UringAsyncIO::SubmitWrite(int fd, const char *buf, size_t size,
+                               off_t offset, Callback callback) {
+  Submit(IORING_OP_WRITEV, fd, const_cast<char *>(buf), size, offset,
+         std::move(callback));
+}
+
+/*
+ * Fill the next submission queue entry and hand it to the kernel. A request
+ * without callback is the reaper's stop signal, it is not counted in flight
+ */
+void UringAsyncIO::Submit(int opcode, int fd, void *buf, size_t size,
+                          off_t offset, Callback callback) {
+  Request *request = nullptr;
+  if (callback) {
+    request = new Request;
+    request->iov_.iov_base = buf;
+    request->iov_.iov_len = size;
+    request->callback_ = std::move(callback);
+  }
+
+  std::unique_lock<std::mutex> lock(latch_);
+  if (request != nullptr) {
+    cv_.wait(lock, [&] { return in_flight_ < queue_depth_; });
+    in_flight_++;
+  }
+
+  unsigned tail = *sq_tail_;
+  unsigned index = tail & *sq_mask_;
+  struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(sqes_) + index;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  if (request != nullptr) {
+    sqe->addr = reinterpret_cast<uint64_t>(&request->iov_);
+    sqe->len = 1;
+    sqe->off = offset;
+  }
+  sqe->user_data = reinterpret_cast<uint64_t>(request);
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+  while (syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0) < 0) {
+    if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      LOG_DEBUG("io_uring_enter failed: %s", strerror(errno));
+      break;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void UringAsyncIO::Reap() {
+  struct io_uring_cqe *cqes = static_cast<struct io_uring_cqe *>(cqes_);
+  while (true) {
+    unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS,
+              nullptr, 0);
+      continue;
+    }
+    struct io_uring_cqe *cqe = cqes + (head & *cq_mask_);
+    Request *request = reinterpret_cast<Request *>(cqe->user_data);
+    ssize_t result = cqe->res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    if (request == nullptr) {
+      break;
+    }
+
+    {
+      // free the slot first, so the callback itself may submit
+      std::lock_guard<std::mutex> guard(latch_);
+      in_flight_--;
+    }
+    cv_.notify_all();
+    request->callback_(result);
+    delete request;
+  }
+}
+
+#else
+
+UringAsyncIO::UringAsyncIO(size_t queue_depth)
+    : ring_fd_(-1), queue_depth_(queue_depth), in_flight_(0),
+      reaper_(nullptr) {}
+
+UringAsyncIO::~UringAsyncIO() {}
+
+void UringAsyncIO::SubmitRead(int, char *, size_t, off_t, Callback) {
+  assert(false);
+}
+
+void UringAsyncIO::SubmitWrite(int, const char *, size_t, off_t, Callback) {
+  assert(false);
+}
+
+#endif
+
+} // namespace cmudb
@@ -0,0 +1,214 @@
+/**
+ * compressed_page_store.cpp
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/logger.h"
+#include "disk/compressed_page_store.h"
+#include "disk/lz_codec.h"
+
+namespace cmudb {
+
+/*
+ * Load the page mapping table and turn the gaps between mapped extents into
+ * free extents of at most MAX_BLOCKS blocks
+ */
+CompressedPageStore::CompressedPageStore(int db_fd, const std::string &map_name)
+    : db_fd_(db_fd), free_extents_(MAX_BLOCKS + 1), end_block_(0) {
+  map_fd_ = open(map_name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (map_fd_ < 0) {
+    LOG_DEBUG("can't open page mapping table: %s", strerror(errno));
+    return;
+  }
+  struct stat stat_buf;
+  if (fstat(map_fd_, &stat_buf) != 0) {
+    return;
+  }
+  map_.resize(stat_buf.st_size / sizeof(Extent));
+  ssize_t ret =
+      pread(map_fd_, map_.data(), map_.size() * sizeof(Extent), 0);
+  map_.resize(ret < 0 ? 0 : ret / sizeof(Extent));
+
+  std::vector<std::pair<uint32_t, uint32_t>> used;
+  for (auto &extent : map_) {
+    if (extent.length_ != 0) {
+      used.emplace_back(extent.block_, extent.block_ + extent.blocks_);
+    }
+  }
+  std::sort(used.begin(), used.end());
+  for (auto &range : used) {
+    while (end_block_ < range.first) {
+      uint32_t blocks = std::min<uint32_t>(MAX_BLOCKS, range.first - end_block_);
+      free_extents_[blocks].push_back(end_block_);
+      end_block_ += blocks;
+    }
+    end_block_ = std::max(end_block_, range.second);
+  }
+}
+
+CompressedPageStore::~CompressedPageStore() {
+  if (map_fd_ >= 0) {
+    close(map_fd_);
+  }
+}
+
+/*
+ * Compress outside the latch, then place the page: in its current extent if
+ * it fits, otherwise in a new one. The old extent is only released once the
+ * mapping table points to the new one
+ */
+bool CompressedPageStore::WritePage(page_id_t page_id, const char *page_data) {
+  char buf[PAGE_SIZE];
+  const char *data = buf;
+  size_t length = LZCodec::Compress(page_data, PAGE_SIZE, buf,
+                                    PAGE_SIZE - COMPRESSION_BLOCK_SIZE);
+  if (length == 0) {
+    data = page_data;
+    length = PAGE_SIZE;
+  }
+  uint16_t blocks =
+      (length + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE;
+
+  Extent old_extent;
+  Extent extent;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (map_.size() <= static_cast<size_t>(page_id)) {
+      map_.resize(page_id + 1, Extent{0, 0, 0});
+    }
+    old_extent = map_[page_id];
+    if (old_extent.length_ != 0 && blocks <= old_extent.blocks_) {
+      extent = old_extent;
+    } else {
+      extent.block_ = allocateExtent(blocks);
+      extent.blocks_ = blocks;
+    }
+    extent.length_ = length;
+    map_[page_id] = extent;
+  }
+
+  bool ok = pwriteAll(db_fd_, data, length,
+                      static_cast<off_t>(extent.block_) * COMPRESSION_BLOCK_SIZE);
+  ok = ok && writeEntry(page_id, extent);
+  if (old_extent.length_ != 0 && old_extent.block_ != extent.block_) {
+    std::lock_guard<std::mutex> guard(latch_);
+    free_extents_[old_extent.blocks_].push_back(old_extent.block_);
+  }
+  return ok;
+}
+
+bool CompressedPageStore::ReadPage(page_id_t page_id, char *page_data) {
+  Extent extent{0, 0, 0};
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (static_cast<size_t>(page_id) < map_.size()) {
+      extent = map_[page_id];
+    }
+  }
+  if (extent.length_ == 0) {
+    memset(page_data, 0, PAGE_SIZE);
+    return true;
+  }
+
+  char buf[PAGE_SIZE];
+  char *data = extent.length_ == PAGE_SIZE ? page_data : buf;
+  off_t offset = static_cast<off_t>(extent.block_) * COMPRESSION_BLOCK_SIZE;
+  size_t read_count = 0;
+  while (read_count < extent.length_) {
+    ssize_t ret = pread(db_fd_, data + read_count, extent.length_ - read_count,
+                        offset + read_count);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      LOG_DEBUG("I/O error while reading page %d", page_id);
+      memset(page_data, 0, PAGE_SIZE);
+      return false;
+    }
+    read_count += ret;
+  }
+  if (data == buf &&
+      !LZCodec::Decompress(buf, extent.length_, page_data, PAGE_SIZE)) {
+    LOG_DEBUG("corrupted compressed page %d", page_id);
+    memset(page_data, 0, PAGE_SIZE);
+    return false;
+  }
+  return true;
+}
+
+void CompressedPageStore::FreePage(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (static_cast<size_t>(page_id) >= map_.size() ||
+      map_[page_id].length_ == 0) {
+    return;
+  }
+  free_extents_[map_[page_id].blocks_].push_back(map_[page_id].block_);
+  map_[page_id] = Extent{0, 0, 0};
+  writeEntry(page_id, map_[page_id]);
+}
+
+bool CompressedPageStore::Sync() {
+  return fdatasync(db_fd_) == 0 && fdatasync(map_fd_) == 0;
+}
+
+page_id_t CompressedPageStore::GetNumPages() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return map_.size();
+}
+
+size_t CompressedPageStore::GetFileSize() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return static_cast<size_t>(end_block_) * COMPRESSION_BLOCK_SIZE;
+}
+
+/*
+ * Take a free extent of exactly that size, else split a larger one, else
+ * grow the file. The caller holds latch_
+ */
+uint32_t CompressedPageStore::allocateExtent(uint16_t blocks) {
+  for (size_t size = blocks; size <= MAX_BLOCKS; ++size) {
+    if (free_extents_[size].empty()) {
+      continue;
+    }
+    uint32_t block = free_extents_[size].back();
+    free_extents_[size].pop_back();
+    if (size > blocks) {
+      free_extents_[size - blocks].push_back(block + blocks);
+    }
+    return block;
+  }
+  uint32_t block = end_block_;
+  end_block_ += blocks;
+  return block;
+}
+
+bool CompressedPageStore::writeEntry(page_id_t page_id, const Extent &extent) {
+  return pwriteAll(map_fd_, reinterpret_cast<const char *>(&extent),
+                   sizeof(Extent),
+                   static_cast<off_t>(page_id) * sizeof(Extent));
+}
+
+bool CompressedPageStore::pwriteAll(int fd, const char *data, size_t size,
+                                    off_t offset) {
+  size_t written = 0;
+  while (written < size) {
+    ssize_t ret = pwrite(fd, data + written, size - written, offset + written);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_DEBUG("I/O error while writing: %s", strerror(errno));
+      return false;
+    }
+    written += ret;
+  }
+  return true;
+}
+
+} // namespace cmudb
@@ -0,0 +1,190 @@
+/**
+ * crc32c.cpp
+ */
+
+#include <cstring>
+
+#include "disk/crc32c.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define HAVE_SSE42_CRC32C
+#endif
+
+namespace cmudb {
+
+static const uint32_t POLY = 0x82f63b78; // reversed Castagnoli polynomial
+
+/*
+ * table[k][b] is the crc of byte b followed by k zero bytes
+ */
+struct CRC32CTable {
+  uint32_t table_[8][256];
+
+  CRC32CTable() {
+    for (uint32_t b = 0; b < 256; ++b) {
+      uint32_t crc = b;
+      for (int i = 0; i < 8; ++i) {
+        crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+      }
+      table_[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; ++b) {
+      for (int k = 1; k < 8; ++k) {
+        table_[k][b] =
+            (table_[k - 1][b] >> 8) ^ table_[0][table_[k - 1][b] & 0xff];
+      }
+    }
+  }
+};
+
+static const CRC32CTable &GetTable() {
+  static const CRC32CTable table;
+  return table;
+}
+
+static uint32_t ComputeTable(const char *data, size_t size, uint32_t crc) {
+  const uint32_t(*t)[256] = GetTable().table_;
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+  crc = ~crc;
+  while (size >= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    word ^= crc;
+    crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^
+          t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+          t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^
+          t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+    p += 8;
+    size -= 8;
+  }
+  while (size-- > 0) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+  }
+  return ~crc;
+}
+
+#ifdef HAVE_SSE42_CRC32C
+
+/*
+ * crc(A || B) from crc(A) and crc(B) where B is len bytes long: shift the
+ * crc of A over len zero bytes by multiplying with x^(8 * len) modulo the
+ * polynomial
+ */
+static uint32_t MultiplyModP(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+  // the highest bit holds the coefficient of x^0
+  for (uint32_t bit = 0x80000000; bit != 0; bit >>= 1) {
+    if (b & bit) {
+      product ^= a;
+    }
+    a = a & 1 ? (a >> 1) ^ POLY : a >> 1;
+  }
+  return product;
+}
+
+// x^(8 * len) modulo the polynomial, in the reflected representation
+static uint32_t ShiftFactor(size_t len) {
+  uint32_t factor = 0x80000000; // x^0
+  uint32_t power = 0x00800000;  // x^8
+  while (len > 0) {
+    if (len & 1) {
+      factor = MultiplyModP(factor, power);
+    }
+    power = MultiplyModP(power, power);
+    len >>= 1;
+  }
+  return factor;
+}
+
+/*
+ * Multiplication with a fixed shift factor is linear in the crc, so it is
+ * done with one table lookup per byte of the crc
+ */
+struct CRC32CShift {
+  uint32_t table_[4][256];
+
+  explicit CRC32CShift(size_t len) {
+    uint32_t factor = ShiftFactor(len);
+    for (int k = 0; k < 4; ++k) {
+      for (uint32_t b = 0; b < 256; ++b) {
+        table_[k][b] = MultiplyModP(b << (8 * k), factor);
+      }
+    }
+  }
+
+  inline uint32_t Shift(uint32_t crc) const {
+    return table_[0][crc & 0xff] ^ table_[1][(crc >> 8) & 0xff] ^
+           table_[2][(crc >> 16) & 0xff] ^ table_[3][crc >> 24];
+  }
+};
+
+__attribute__((target("sse4.2"))) static uint32_t
+ComputeHardware(const char *data, size_t size, uint32_t crc) {
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+  uint64_t crc0 = ~crc;
+
+  // three independent streams over consecutive blocks keep the crc32 unit
+  // busy, they are combined at the end of every round
+  const size_t BLOCK = 128;
+  if (size >= 3 * BLOCK) {
+    static const CRC32CShift shift1(BLOCK);
+    static const CRC32CShift shift2(2 * BLOCK);
+    while (size >= 3 * BLOCK) {
+      uint64_t crc1 = 0;
+      uint64_t crc2 = 0;
+      for (size_t i = 0; i < BLOCK; i += 8) {
+        uint64_t w0, w1, w2;
+        memcpy(&w0, p + i, 8);
+        memcpy(&w1, p + BLOCK + i, 8);
+        memcpy(&w2, p + 2 * BLOCK + i, 8);
+        crc0 = _mm_crc32_u64(crc0, w0);
+        crc1 = _mm_crc32_u64(crc1, w1);
+        crc2 = _mm_crc32_u64(crc2, w2);
+      }
+      crc0 = shift2.Shift(crc0) ^ shift1.Shift(crc1) ^ crc2;
+      p += 3 * BLOCK;
+      size -= 3 * BLOCK;
+    }
+  }
+  while (size >= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    crc0 = _mm_crc32_u64(crc0, word);
+    p += 8;
+    size -= 8;
+  }
+  uint32_t crc32 = crc0;
+  while (size-- > 0) {
+    crc32 = _mm_crc32_u8(crc32, *p++);
+  }
+  return ~crc32;
+}
+
+static bool HasHardware() {
+  static const bool has_hardware = __builtin_cpu_supports("sse4.2");
+  return has_hardware;
+}
+
+#else
+
+static bool HasHardware() { return false; }
+
+#endif
+
+uint32_t CRC32C::Compute(const char *data, size_t size, uint32_t crc) {
+#ifdef HAVE_SSE42_CRC32C
+  if (HasHardware()) {
+    return ComputeHardware(data, size, crc);
+  }
+#endif
+  return ComputeTable(data, size, crc);
+}
+
+bool CRC32C::IsHardwareAccelerated() { return HasHardware(); }
+
+uint32_t CRC32C::ComputePortable(const char *data, size_t size, uint32_t crc) {
+  return ComputeTable(data, size, crc);
+}
+
+} // namespace cmudb
@@ -1,116 +1,293 @@
 /**
  * disk_manager.cpp
  */
+#include <algorithm>
 #include <assert.h>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
 #include <iostream>
 #include <sys/stat.h>
 #include <thread>
+#include <unistd.h>
 
 #include "common/logger.h"
+#include "disk/crc32c.h"
 #include "disk/disk_manager.h"
 
 namespace cmudb {
 
-static char *buffer_used = nullptr;
-
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
+ * @input direct_io: bypass the kernel page cache for the database file
+ * @input compress: store pages compressed, only applies to a new database
+ * @input log_segment_size: size of a log segment file in bytes
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), next_page_id_(0), num_flushes_(0), flush_log_(false),
-      flush_log_f_(nullptr) {
+DiskManager::DiskManager(const std::string &db_file, bool direct_io,
+                         bool compress, int log_segment_size)
+    : log_segment_size_(log_segment_size), log_fd_(-1), log_fd_segment_(-1),
+      log_end_(0), first_segment_(0), segments_end_(0), db_fd_(-1),
+      file_name_(db_file), direct_io_(false), compressed_store_(nullptr),
+      async_io_(nullptr), fsm_fd_(-1), fsm_dirty_(false), num_free_(0),
+      free_hint_(0), extent_end_(0), preallocate_(true), next_page_id_(0),
+      num_flushes_(0), flush_log_(false), flush_log_f_(nullptr),
+      buffer_used_(nullptr) {
   std::string::size_type n = file_name_.find(".");
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
+  fsm_name_ = file_name_.substr(0, n) + ".fsm";
+  master_name_ = file_name_.substr(0, n) + ".master";
+  std::string map_name = file_name_.substr(0, n) + ".map";
+  OpenLog();
+
+  // compression is chosen when the database is created, a page mapping
+  // table tells that it was
+  compress = (compress && GetFileSize(db_file) <= 0) ||
+             GetFileSize(map_name) >= 0;
+  if (compress && direct_io) {
+    LOG_DEBUG("compressed pages are not aligned, use buffered I/O");
+    direct_io = false;
+  }
+
+  // create the file if it does not exist
+  if (direct_io) {
+    db_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+    if (db_fd_ >= 0) {
+      direct_io_ = true;
+    } else {
+      // e.g. tmpfs does not support O_DIRECT at all
+      LOG_DEBUG("can't open db file for direct I/O: %s", strerror(errno));
+    }
+  }
+  if (db_fd_ < 0) {
+    db_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  }
+  if (db_fd_ < 0) {
+    LOG_DEBUG("can't open db file: %s", strerror(errno));
+    return;
+  }
 
-  log_io_.open(log_name_,
-               std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app |
-                                std::ios::out);
-    log_io_.close();
-    // reopen with original mode
-    log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app |
-                                std::ios::out);
-  }
-
-  db_io_.open(db_file,
-              std::ios::binary | std::ios::in | std::ios::out | std::ios::out);
-  // directory or file does not exist
-  if (!db_io_.is_open()) {
-    db_io_.clear();
-    // create a new file
-    db_io_.open(db_file, std::ios::binary | std::ios::trunc | std::ios::out);
-    db_io_.close();
-    // reopen with original mode
-    db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
+  // pages beyond the end of file were never written, so they are free
+  if (compress) {
+    compressed_store_ = new CompressedPageStore(db_fd_, map_name);
+    next_page_id_ = compressed_store_->GetNumPages();
+    // compressed pages are not laid out by page id
+    preallocate_ = false;
+  } else {
+    struct stat stat_buf;
+    if (fstat(db_fd_, &stat_buf) == 0) {
+      next_page_id_ = (stat_buf.st_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    }
   }
+  extent_end_ = next_page_id_;
+  LoadFreePageMap();
 }
 
 DiskManager::~DiskManager() {
-  db_io_.close();
-  log_io_.close();
+  // waits for asynchronous I/O in flight
+  delete async_io_;
+  delete compressed_store_;
+  SyncFreePageMap();
+  if (db_fd_ >= 0) {
+    close(db_fd_);
+  }
+  if (fsm_fd_ >= 0) {
+    close(fsm_fd_);
+  }
+  if (log_fd_ >= 0) {
+    close(log_fd_);
+  }
 }
 
 /**
  * Write the contents of the specified page into disk file
+ * The page is checksummed in a private copy, so the checksum matches what
+ * is written even if the caller keeps modifying its buffer
  */
-void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
-  size_t offset = page_id * PAGE_SIZE;
-  // set write cursor to offset
-  db_io_.seekp(offset);
-  db_io_.write(page_data, PAGE_SIZE);
-  // check for I/O error
-  if (db_io_.bad()) {
-    LOG_DEBUG("I/O error while writing");
-    return;
+bool DiskManager::WritePage(page_id_t page_id, const char *page_data) {
+  alignas(4096) char page[PAGE_SIZE];
+  memcpy(page, page_data, PAGE_DATA_SIZE);
+  return WritePageInPlace(page_id, page);
+}
+
+/**
+ * Write a page the caller has to itself, e.g. a frame being evicted, without
+ * copying it first
+ */
+bool DiskManager::WritePageInPlace(page_id_t page_id, char *page_data) {
+  SetChecksum(page_data);
+  uint64_t start = IOStats::Now();
+  bool ok;
+  if (compressed_store_ != nullptr) {
+    ok = compressed_store_->WritePage(page_id, page_data);
+  } else if (direct_io_ && !IsAligned(page_data)) {
+    alignas(4096) char bounce[PAGE_SIZE];
+    memcpy(bounce, page_data, PAGE_SIZE);
+    ok = WriteFile(page_id, bounce);
+  } else {
+    ok = WriteFile(page_id, page_data);
   }
-  // needs to flush to keep disk file in sync
-  db_io_.flush();
+  io_stats_.Record(IOType::PAGE_WRITE, PAGE_SIZE, start);
+  return ok;
 }
 
 /**
  * Read the contents of the specified page into the given memory area
+ * @return: false on I/O error or checksum mismatch
  */
-void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
-  int offset = page_id * PAGE_SIZE;
-  // check if read beyond file length
-  if (offset > GetFileSize(file_name_)) {
-    LOG_DEBUG("I/O error while reading");
-    // std::cerr << "I/O error while reading" << std::endl;
+bool DiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  uint64_t start = IOStats::Now();
+  bool ok;
+  if (compressed_store_ != nullptr) {
+    ok = compressed_store_->ReadPage(page_id, page_data);
+  } else if (direct_io_ && !IsAligned(page_data)) {
+    alignas(4096) char bounce[PAGE_SIZE];
+    ok = ReadFile(page_id, bounce);
+    memcpy(page_data, bounce, PAGE_SIZE);
   } else {
-    // set read cursor to offset
-    db_io_.seekp(offset);
-    db_io_.read(page_data, PAGE_SIZE);
-    // if file ends before reading PAGE_SIZE
-    int read_count = db_io_.gcount();
-    if (read_count < PAGE_SIZE) {
-      LOG_DEBUG("Read less than a page");
-      // std::cerr << "Read less than a page" << std::endl;
-      memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+    ok = ReadFile(page_id, page_data);
+  }
+  io_stats_.Record(IOType::PAGE_READ, PAGE_SIZE, start);
+  return ok && VerifyChecksum(page_id, page_data);
+}
+
+/**
+ * Write a run of consecutive pages. They are checksummed into one buffer
+ * per batch, which then goes out with a single write
+ */
+bool DiskManager::WritePages(page_id_t page_id,
+                             const std::vector<const char *> &pages) {
+  const size_t BATCH_PAGES = 256;
+  size_t batch_pages = std::min(pages.size(), BATCH_PAGES);
+  char *buf = static_cast<char *>(aligned_alloc(4096, batch_pages * PAGE_SIZE));
+  bool ok = true;
+  for (size_t begin = 0; begin < pages.size(); begin += batch_pages) {
+    size_t count = std::min(batch_pages, pages.size() - begin);
+    uint64_t start = IOStats::Now();
+    for (size_t i = 0; i < count; ++i) {
+      memcpy(buf + i * PAGE_SIZE, pages[begin + i], PAGE_DATA_SIZE);
+      SetChecksum(buf + i * PAGE_SIZE);
+      if (compressed_store_ != nullptr) {
+        ok = compressed_store_->WritePage(page_id + begin + i,
+                                          buf + i * PAGE_SIZE) &&
+             ok;
+      }
+    }
+    if (compressed_store_ == nullptr) {
+      ok = WriteFile(page_id + begin, buf, count) && ok;
     }
+    io_stats_.Record(IOType::PAGE_WRITE, count * PAGE_SIZE, start);
   }
+  free(buf);
+  return ok;
+}
+
+bool DiskManager::SyncPages() {
+  uint64_t start = IOStats::Now();
+  bool ok = true;
+  if (compressed_store_ != nullptr) {
+    ok = compressed_store_->Sync();
+  } else {
+    while (fdatasync(db_fd_) != 0) {
+      if (errno != EINTR) {
+        LOG_DEBUG("I/O error while syncing: %s", strerror(errno));
+        ok = false;
+        break;
+      }
+    }
+  }
+  io_stats_.Record(IOType::SYNC, 0, start);
+  return SyncFreePageMap() && ok;
+}
+
+/**
+ * Submit a page write, a short write is completed synchronously on the I/O
+ * thread. The checksummed copy of the page lives until the write is done. A
+ * page that has to be compressed is written right away
+ */
+void DiskManager::WritePageAsync(page_id_t page_id, const char *page_data,
+                                 std::function<void(bool)> callback) {
+  char *page = static_cast<char *>(aligned_alloc(4096, PAGE_SIZE));
+  memcpy(page, page_data, PAGE_DATA_SIZE);
+  SetChecksum(page);
+  uint64_t start = IOStats::Now();
+  if (compressed_store_ != nullptr) {
+    bool ok = compressed_store_->WritePage(page_id, page);
+    io_stats_.Record(IOType::PAGE_WRITE, PAGE_SIZE, start);
+    free(page);
+    callback(ok);
+    return;
+  }
+  GetAsyncIO()->SubmitWrite(
+      db_fd_, page, PAGE_SIZE, static_cast<off_t>(page_id) * PAGE_SIZE,
+      [this, page_id, page, callback, start](ssize_t ret) {
+        if (ret == -EINVAL && direct_io_) {
+          DisableDirectIO();
+          ret = 0;
+        }
+        bool ok = ret >= 0;
+        if (!ok) {
+          LOG_DEBUG("I/O error while writing: %s", strerror(-ret));
+        } else if (ret < PAGE_SIZE) {
+          ok = WriteFile(page_id, page);
+        }
+        io_stats_.Record(IOType::PAGE_WRITE, PAGE_SIZE, start);
+        free(page);
+        callback(ok);
+      });
+}
+
+/**
+ * Submit a page read, a page beyond the end of file reads as zeros like in
+ * ReadPage, the checksum is verified before the callback runs
+ */
+void DiskManager::ReadPageAsync(page_id_t page_id, char *page_data,
+                                std::function<void(bool)> callback) {
+  if (compressed_store_ != nullptr || (direct_io_ && !IsAligned(page_data))) {
+    callback(ReadPage(page_id, page_data));
+    return;
+  }
+  uint64_t start = IOStats::Now();
+  GetAsyncIO()->SubmitRead(
+      db_fd_, page_data, PAGE_SIZE, static_cast<off_t>(page_id) * PAGE_SIZE,
+      [this, page_id, page_data, callback, start](ssize_t ret) {
+        if (ret == -EINVAL && direct_io_) {
+          DisableDirectIO();
+          ret = 0;
+        }
+        bool ok = ret >= 0;
+        if (!ok) {
+          LOG_DEBUG("I/O error while reading: %s", strerror(-ret));
+        } else if (ret < PAGE_SIZE) {
+          // short read in the middle of the file or end of file
+          ok = ReadFile(page_id, page_data);
+        }
+        io_stats_.Record(IOType::PAGE_READ, PAGE_SIZE, start);
+        callback(ok && VerifyChecksum(page_id, page_data));
+      });
 }
 
 /**
  * Write the contents of the log into disk file
- * Only return when sync is done, and only perform sequence write
+ * Only return when sync is done, and only perform sequence write. A write
+ * crossing the end of a segment continues at the start of the next one
+ * @return: false on I/O error, the end of the log stays where it was and
+ * the same buffer can be written again
  */
-void DiskManager::WriteLog(char *log_data, int size) {
+bool DiskManager::WriteLog(char *log_data, int size) {
   // enforce swap log buffer
-  assert(log_data != buffer_used);
-  buffer_used = log_data;
-  LOG_DEBUG("file size is %d, write_size:%d", GetFileSize(log_name_), size);
-  if (size == 0) // no effect on num_flushes_ if log buffer is empty
-    return;
+  assert(log_data != buffer_used_);
+  LOG_DEBUG("log size is %d, write_size:%d", log_end_.load(), size);
+  if (size == 0) { // no effect on num_flushes_ if log buffer is empty
+    buffer_used_ = log_data;
+    return true;
+  }
 
   flush_log_ = true;
 
@@ -120,55 +297,219 @@ void DiskManager::WriteLog(char *log_data, int size) {
            std::future_status::ready);
 
   num_flushes_ += 1;
-  // sequence write
-  log_io_.write(log_data, size);
-
+  uint64_t start = IOStats::Now();
+  int offset = log_end_;
+  int written = 0;
+  bool ok = true;
+  while (written < size) {
+    int segment = (offset + written) / log_segment_size_;
+    if (segment != log_fd_segment_ && !SwitchLogSegment(segment)) {
+      ok = false;
+      break;
+    }
+    int in_segment = (offset + written) % log_segment_size_;
+    int count = std::min(size - written, log_segment_size_ - in_segment);
+    // sequence write
+    ssize_t ret = pwrite(log_fd_, log_data + written, count, in_segment);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ok = false;
+      break;
+    }
+    written += ret;
+  }
+  // the segment is preallocated, only the data has to reach the disk
+  while (ok && fdatasync(log_fd_) != 0) {
+    ok = errno == EINTR;
+  }
+  io_stats_.Record(IOType::LOG_WRITE, size, start);
   // check for I/O error
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while writing log");
-    return;
+  if (!ok) {
+    LOG_DEBUG("I/O error while writing log: %s", strerror(errno));
+    return false;
   }
-  // needs to flush to keep disk file in sync
-  log_io_.flush();
+  // a failed write leaves no hole, later records keep their offsets
+  log_end_ = offset + size;
+  buffer_used_ = log_data;
   flush_log_ = false;
+  return true;
 }
 
 /**
  * Read the contents of the log into the given memory area
- * Always read from the beginning and perform sequence read
+ * Perform sequence read, the part beyond the end of the log is zeroed
  * @return: false means already reach the end
  */
 bool DiskManager::ReadLog(char *log_data, int size, int offset) {
-  if (offset >= GetFileSize(log_name_)) {
-    // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
+  int end = log_end_;
+  if (offset >= end) {
+    return false;
+  }
+  if (offset < first_segment_ * log_segment_size_) {
+    LOG_DEBUG("log offset %d is truncated", offset);
     return false;
   }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
-  // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
-  LOG_DEBUG("file size is %d, read_count:%d, required_size:%d", GetFileSize(log_name_), read_count, size);
-  if (read_count < size) {
-    log_io_.clear();
-    memset(log_data + read_count, 0, size - read_count);
+  int read_count = std::min(size, end - offset);
+  bool ok = ReadLogRange(log_data, read_count, offset);
+  LOG_DEBUG("log size is %d, read_count:%d, required_size:%d", end,
+            read_count, size);
+  memset(log_data + read_count, 0, size - read_count);
+  return ok;
+}
+
+int DiskManager::GetLogSize() { return log_end_; }
+
+/**
+ * Drop the segments wholly before offset. The control file moves past them
+ * first, so a crash in between leaves segments that are removed on open
+ */
+void DiskManager::TruncateLog(int offset) {
+  offset = std::min(offset, log_end_.load());
+  int first_segment = offset / log_segment_size_;
+  int old_first = first_segment_;
+  if (first_segment <= old_first || !WriteLogControl(first_segment, offset)) {
+    return;
+  }
+  first_segment_ = first_segment;
+  for (int segment = old_first; segment < first_segment; ++segment) {
+    std::string name = GetLogSegmentName(segment);
+    int spares;
+    {
+      std::lock_guard<std::mutex> guard(log_latch_);
+      spares = segments_end_ - log_end_ / log_segment_size_ - 1;
+    }
+    // zeroed outside the latch, appends go on meanwhile
+    if (spares < LOG_SEGMENT_SPARES && ZeroLogSegment(name)) {
+      std::lock_guard<std::mutex> guard(log_latch_);
+      if (rename(name.c_str(), GetLogSegmentName(segments_end_).c_str()) ==
+          0) {
+        segments_end_++;
+        continue;
+      }
+    }
+    unlink(name.c_str());
   }
+}
 
+/**
+ * The master record is | checkpoint_lsn | checkpoint_offset | crc |, written
+ * over the previous one at offset 0 and synced before returning
+ */
+bool DiskManager::WriteMasterRecord(lsn_t checkpoint_lsn,
+                                    int checkpoint_offset) {
+  char record[3 * sizeof(int32_t)];
+  memcpy(record, &checkpoint_lsn, sizeof(lsn_t));
+  memcpy(record + sizeof(lsn_t), &checkpoint_offset, sizeof(int32_t));
+  uint32_t crc = CRC32C::Compute(record, 2 * sizeof(int32_t));
+  memcpy(record + 2 * sizeof(int32_t), &crc, sizeof(uint32_t));
+
+  int fd = open(master_name_.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd < 0) {
+    LOG_DEBUG("can't open master record: %s", strerror(errno));
+    return false;
+  }
+  bool ok = pwrite(fd, record, sizeof(record), 0) ==
+            static_cast<ssize_t>(sizeof(record));
+  uint64_t start = IOStats::Now();
+  ok = fsync(fd) == 0 && ok;
+  io_stats_.Record(IOType::SYNC, 0, start);
+  close(fd);
+  return ok;
+}
+
+bool DiskManager::ReadMasterRecord(lsn_t &checkpoint_lsn,
+                                   int &checkpoint_offset) {
+  int fd = open(master_name_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  char record[3 * sizeof(int32_t)];
+  bool ok = pread(fd, record, sizeof(record), 0) ==
+            static_cast<ssize_t>(sizeof(record));
+  close(fd);
+  uint32_t crc;
+  memcpy(&crc, record + 2 * sizeof(int32_t), sizeof(uint32_t));
+  if (!ok || crc != CRC32C::Compute(record, 2 * sizeof(int32_t))) {
+    return false;
+  }
+  memcpy(&checkpoint_lsn, record, sizeof(lsn_t));
+  memcpy(&checkpoint_offset, record + sizeof(lsn_t), sizeof(int32_t));
   return true;
 }
 
 /**
  * Allocate new page (operations like create index/table)
- * For now just keep an increasing counter
+ * Reuse the lowest free page if there is one, otherwise extend the file
  */
-page_id_t DiskManager::AllocatePage() { return next_page_id_++; }
+page_id_t DiskManager::AllocatePage() {
+  std::lock_guard<std::mutex> guard(free_latch_);
+  if (num_free_ > 0) {
+    size_t byte = free_hint_ / 8;
+    while (free_map_[byte] == 0) {
+      byte++;
+    }
+    page_id_t page_id = byte * 8 + __builtin_ctz(free_map_[byte]);
+    SetFree(page_id, false);
+    free_hint_ = page_id + 1;
+    return page_id;
+  }
+  page_id_t page_id = next_page_id_++;
+  if (page_id >= extent_end_) {
+    PreallocateExtent(page_id);
+  }
+  return page_id;
+}
+
+/*
+ * The page id AllocatePage would hand out now. Another thread may allocate
+ * it first, so it is only a hint
+ */
+page_id_t DiskManager::PeekNextPage() {
+  std::lock_guard<std::mutex> guard(free_latch_);
+  if (num_free_ > 0) {
+    size_t byte = free_hint_ / 8;
+    while (free_map_[byte] == 0) {
+      byte++;
+    }
+    return byte * 8 + __builtin_ctz(free_map_[byte]);
+  }
+  return next_page_id_;
+}
 
 /**
  * Deallocate page (operations like drop index/table)
- * Need bitmap in header page for tracking pages
+ * The page goes to the free page map and is handed out again by AllocatePage
  */
-void DiskManager::DeallocatePage(__attribute__((unused)) page_id_t page_id) {
-  return;
+void DiskManager::DeallocatePage(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(free_latch_);
+  if (page_id < 0 || page_id >= next_page_id_ ||
+      (static_cast<size_t>(page_id / 8) < free_map_.size() &&
+       (free_map_[page_id / 8] >> (page_id % 8) & 1))) {
+    LOG_DEBUG("deallocate page %d that is not allocated", page_id);
+    return;
+  }
+  SetFree(page_id, true);
+  free_hint_ = std::min(free_hint_, page_id);
+  if (compressed_store_ != nullptr) {
+    compressed_store_->FreePage(page_id);
+  }
+}
+
+void DiskManager::ReservePage(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(free_latch_);
+  if (page_id >= next_page_id_) {
+    next_page_id_ = page_id + 1;
+  } else if (static_cast<size_t>(page_id / 8) < free_map_.size() &&
+             (free_map_[page_id / 8] >> (page_id % 8) & 1)) {
+    SetFree(page_id, false);
+  }
+}
+
+size_t DiskManager::GetNumFreePages() {
+  std::lock_guard<std::mutex> guard(free_latch_);
+  return num_free_;
 }
 
 /**
@@ -181,6 +522,474 @@ int DiskManager::GetNumFlushes() const { return num_flushes_; }
  */
 bool DiskManager::GetFlushState() const { return flush_log_; }
 
+AsyncIO *DiskManager::GetAsyncIO() {
+  std::call_once(async_io_flag_, [this] {
+    async_io_ = AsyncIO::Create(ASYNC_IO_QUEUE_DEPTH, ASYNC_IO_THREADS);
+  });
+  return async_io_;
+}
+
+/*
+ * Direct I/O transfers whole pages at page offsets, only the memory address
+ * of the buffer can be misaligned
+ */
+bool DiskManager::IsAligned(const char *page_data) const {
+  return reinterpret_cast<uintptr_t>(page_data) % PAGE_SIZE == 0;
+}
+
+/*
+ * The file system or device does not accept direct I/O of this size or
+ * alignment, keep going with buffered I/O on the same file descriptor
+ */
+void DiskManager::DisableDirectIO() {
+  if (direct_io_.exchange(false)) {
+    LOG_DEBUG("direct I/O rejected, fall back to buffered I/O");
+    int flags = fcntl(db_fd_, F_GETFL);
+    fcntl(db_fd_, F_SETFL, flags & ~O_DIRECT);
+  }
+}
+
+/*
+ * Write num_pages whole pages with pwrite, page_data is aligned if direct
+ * I/O is on
+ */
+bool DiskManager::WriteFile(page_id_t page_id, const char *page_data,
+                            size_t num_pages) {
+  off_t offset = static_cast<off_t>(page_id) * PAGE_SIZE;
+  size_t size = num_pages * PAGE_SIZE;
+  size_t written = 0;
+  while (written < size) {
+    ssize_t ret = pwrite(db_fd_, page_data + written, size - written,
+                         offset + written);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EINVAL && direct_io_) {
+        DisableDirectIO();
+        continue;
+      }
+      // check for I/O error
+      LOG_DEBUG("I/O error while writing: %s", strerror(errno));
+      return false;
+    }
+    written += ret;
+  }
+  return true;
+}
+
+/*
+ * Read a whole page with pread, the part beyond the end of file is zeroed
+ */
+bool DiskManager::ReadFile(page_id_t page_id, char *page_data) {
+  off_t offset = static_cast<off_t>(page_id) * PAGE_SIZE;
+  size_t read_count = 0;
+  bool ok = true;
+  while (read_count < PAGE_SIZE) {
+    ssize_t ret = pread(db_fd_, page_data + read_count,
+                        PAGE_SIZE - read_count, offset + read_count);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EINVAL && direct_io_) {
+        DisableDirectIO();
+        continue;
+      }
+      LOG_DEBUG("I/O error while reading: %s", strerror(errno));
+      ok = false;
+      break;
+    }
+    if (ret == 0) {
+      // end of file
+      break;
+    }
+    read_count += ret;
+  }
+  // if file ends before reading PAGE_SIZE
+  if (read_count < PAGE_SIZE) {
+    LOG_DEBUG("Read less than a page");
+    memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+  }
+  return ok;
+}
+
+/*
+ * Read the free page map if there is one. Bits at or beyond next_page_id_
+ * are dropped, those pages are beyond the end of file anyway
+ */
+void DiskManager::LoadFreePageMap() {
+  fsm_fd_ = open(fsm_name_.c_str(), O_RDWR);
+  if (fsm_fd_ < 0) {
+    // created by the first deallocation
+    return;
+  }
+  struct stat stat_buf;
+  if (fstat(fsm_fd_, &stat_buf) != 0) {
+    return;
+  }
+  free_map_.resize(stat_buf.st_size);
+  ssize_t ret = pread(fsm_fd_, free_map_.data(), free_map_.size(), 0);
+  free_map_.resize(ret < 0 ? 0 : ret);
+  free_hint_ = next_page_id_;
+  for (size_t byte = 0; byte < free_map_.size(); ++byte) {
+    for (int bit = 0; bit < 8; ++bit) {
+      if (!(free_map_[byte] >> bit & 1)) {
+        continue;
+      }
+      page_id_t page_id = byte * 8 + bit;
+      if (page_id >= next_page_id_) {
+        free_map_[byte] &= ~(1 << bit);
+        continue;
+      }
+      num_free_++;
+      free_hint_ = std::min(free_hint_, page_id);
+    }
+  }
+}
+
+/*
+ * Flip the bit of page_id and write back the map page holding it. The map is
+ * synced by SyncFreePageMap. Caller holds free_latch_
+ */
+void DiskManager::SetFree(page_id_t page_id, bool is_free) {
+  size_t byte = page_id / 8;
+  size_t map_page = byte / PAGE_SIZE;
+  if (free_map_.size() < (map_page + 1) * PAGE_SIZE) {
+    free_map_.resize((map_page + 1) * PAGE_SIZE, 0);
+  }
+  if (is_free) {
+    free_map_[byte] |= 1 << (page_id % 8);
+    num_free_++;
+  } else {
+    free_map_[byte] &= ~(1 << (page_id % 8));
+    num_free_--;
+  }
+
+  if (fsm_fd_ < 0) {
+    fsm_fd_ = open(fsm_name_.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fsm_fd_ < 0) {
+      LOG_DEBUG("can't open free page map: %s", strerror(errno));
+      return;
+    }
+  }
+  const unsigned char *data = free_map_.data() + map_page * PAGE_SIZE;
+  off_t offset = map_page * PAGE_SIZE;
+  size_t written = 0;
+  while (written < PAGE_SIZE) {
+    ssize_t ret = pwrite(fsm_fd_, data + written, PAGE_SIZE - written,
+                         offset + written);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_DEBUG("I/O error while writing free page map: %s", strerror(errno));
+      return;
+    }
+    written += ret;
+  }
+  fsm_dirty_ = true;
+}
+
+/*
+ * Sync the free page map if it changed since the last sync. Allocations of
+ * table pages are logged and redone by recovery, so the map only has to be
+ * durable before the log holding them is truncated, and with the pages
+ * flushed by SyncPages. A deallocation lost in a crash leaks the page
+ */
+bool DiskManager::SyncFreePageMap() {
+  int fd;
+  {
+    std::lock_guard<std::mutex> guard(free_latch_);
+    if (!fsm_dirty_) {
+      return true;
+    }
+    // a change written from now on marks the map dirty again
+    fsm_dirty_ = false;
+    fd = fsm_fd_;
+  }
+  uint64_t start = IOStats::Now();
+  bool ok = true;
+  while (fdatasync(fd) != 0) {
+    if (errno != EINTR) {
+      LOG_DEBUG("I/O error while syncing free page map: %s", strerror(errno));
+      ok = false;
+      break;
+    }
+  }
+  io_stats_.Record(IOType::SYNC, 0, start);
+  if (!ok) {
+    std::lock_guard<std::mutex> guard(free_latch_);
+    fsm_dirty_ = true;
+  }
+  return ok;
+}
+
+/*
+ * Reserve disk blocks for the extent starting at page_id, so that the file
+ * grows by DISK_EXTENT_PAGES at a time instead of block by block. The file
+ * size is kept, it still tells how many pages were written. Caller holds
+ * free_latch_
+ */
+void DiskManager::PreallocateExtent(page_id_t page_id) {
+  extent_end_ = page_id + DISK_EXTENT_PAGES;
+#ifdef FALLOC_FL_KEEP_SIZE
+  if (preallocate_ &&
+      fallocate(db_fd_, FALLOC_FL_KEEP_SIZE,
+                static_cast<off_t>(page_id) * PAGE_SIZE,
+                static_cast<off_t>(DISK_EXTENT_PAGES) * PAGE_SIZE) != 0) {
+    LOG_DEBUG("fallocate failed: %s", strerror(errno));
+    preallocate_ = errno != EOPNOTSUPP && errno != ENOSYS;
+  }
+#endif
+}
+
+std::string DiskManager::GetLogSegmentName(int segment) const {
+  return log_name_ + "." + std::to_string(segment);
+}
+
+/*
+ * The log control file is | first_segment | boundary | crc |, boundary being
+ * a record boundary in the first segment or later. Segments beyond the end
+ * of the log may hold anything after a crash and are removed, a spare is
+ * only known to be zeroed until the disk manager is closed
+ */
+void DiskManager::OpenLog() {
+  int boundary = 0;
+  char record[3 * sizeof(int32_t)];
+  int fd = open(log_name_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    RemoveLogSegments();
+    WriteLogControl(0, 0);
+    return;
+  }
+  bool ok = pread(fd, record, sizeof(record), 0) ==
+            static_cast<ssize_t>(sizeof(record));
+  close(fd);
+  uint32_t crc;
+  memcpy(&crc, record + 2 * sizeof(int32_t), sizeof(uint32_t));
+  if (ok && crc == CRC32C::Compute(record, 2 * sizeof(int32_t))) {
+    int first_segment;
+    memcpy(&first_segment, record, sizeof(int32_t));
+    memcpy(&boundary, record + sizeof(int32_t), sizeof(int32_t));
+    first_segment_ = first_segment;
+  } else {
+    LOG_DEBUG("damaged log control file, read the log from the start");
+  }
+  // left behind by a truncation that did not finish
+  for (int segment = first_segment_ - 1;
+       segment >= 0 && unlink(GetLogSegmentName(segment).c_str()) == 0;
+       --segment) {
+  }
+  log_end_ = FindLogEnd(boundary);
+  segments_end_ = (log_end_ + log_segment_size_ - 1) / log_segment_size_;
+  for (int segment = segments_end_;
+       unlink(GetLogSegmentName(segment).c_str()) == 0; ++segment) {
+  }
+}
+
+/*
+ * Remove all segment files of the log, they may not be numbered
+ * consecutively after truncations
+ */
+void DiskManager::RemoveLogSegments() {
+  std::string dir = ".";
+  std::string prefix = log_name_ + ".";
+  std::string::size_type slash = log_name_.rfind('/');
+  if (slash != std::string::npos) {
+    dir = slash == 0 ? "/" : log_name_.substr(0, slash);
+    prefix = log_name_.substr(slash + 1) + ".";
+  }
+  DIR *dirp = opendir(dir.c_str());
+  if (dirp == nullptr) {
+    return;
+  }
+  while (struct dirent *entry = readdir(dirp)) {
+    std::string name = entry->d_name;
+    if (name.size() > prefix.size() &&
+        name.compare(0, prefix.size(), prefix) == 0 &&
+        name.find_first_not_of("0123456789", prefix.size()) ==
+            std::string::npos) {
+      unlink((dir + "/" + name).c_str());
+    }
+  }
+  closedir(dirp);
+}
+
+/*
+ * Every log record starts with its size, the first one that is zero or
+ * implausible marks the end of the log
+ */
+int DiskManager::FindLogEnd(int offset) {
+  std::vector<char> chunk(16 * LOG_BUFFER_SIZE);
+  while (true) {
+    if (!ReadLogRange(chunk.data(), chunk.size(), offset)) {
+      return offset;
+    }
+    size_t pos = 0;
+    int32_t size;
+    while (pos + sizeof(int32_t) <= chunk.size()) {
+      memcpy(&size, chunk.data() + pos, sizeof(int32_t));
+      if (size <= 0 || size > LOG_BUFFER_SIZE) {
+        return offset + static_cast<int>(pos);
+      }
+      if (pos + size > chunk.size()) {
+        break;
+      }
+      pos += size;
+    }
+    offset += pos;
+  }
+}
+
+/*
+ * Read a range of log offsets without looking at the end of the log,
+ * missing segments and the part beyond the end of a file read as zeros
+ */
+bool DiskManager::ReadLogRange(char *log_data, int size, int offset) {
+  bool ok = true;
+  while (size > 0) {
+    int in_segment = offset % log_segment_size_;
+    int count = std::min(size, log_segment_size_ - in_segment);
+    int fd = open(GetLogSegmentName(offset / log_segment_size_).c_str(),
+                  O_RDONLY);
+    int read_count = 0;
+    while (fd >= 0 && read_count < count) {
+      ssize_t ret = pread(fd, log_data + read_count, count - read_count,
+                          in_segment + read_count);
+      if (ret < 0 && errno == EINTR) {
+        continue;
+      }
+      if (ret <= 0) {
+        if (ret < 0) {
+          LOG_DEBUG("I/O error while reading log: %s", strerror(errno));
+          ok = false;
+        }
+        break;
+      }
+      read_count += ret;
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    memset(log_data + read_count, 0, count - read_count);
+    log_data += count;
+    offset += count;
+    size -= count;
+  }
+  return ok;
+}
+
+/*
+ * Append to segment from now on. A spare is taken as it is, a new segment
+ * is created at its full size and synced once, so that later fdatasyncs
+ * have no size change to write
+ */
+bool DiskManager::SwitchLogSegment(int segment) {
+  if (log_fd_ >= 0) {
+    while (fdatasync(log_fd_) != 0 && errno == EINTR) {
+    }
+    close(log_fd_);
+    log_fd_segment_ = -1;
+  }
+  std::lock_guard<std::mutex> guard(log_latch_);
+  std::string name = GetLogSegmentName(segment);
+  if (segment < segments_end_) {
+    log_fd_ = open(name.c_str(), O_RDWR);
+  } else {
+    log_fd_ = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (log_fd_ >= 0) {
+      if (posix_fallocate(log_fd_, 0, log_segment_size_) != 0 &&
+          ftruncate(log_fd_, log_segment_size_) != 0) {
+        LOG_DEBUG("can't preallocate log segment: %s", strerror(errno));
+      }
+      fsync(log_fd_);
+      segments_end_ = segment + 1;
+    }
+  }
+  if (log_fd_ < 0) {
+    LOG_DEBUG("can't open log segment %d: %s", segment, strerror(errno));
+    return false;
+  }
+  log_fd_segment_ = segment;
+  return true;
+}
+
+/*
+ * Make a truncated segment read as zeros, keeping its blocks allocated
+ */
+bool DiskManager::ZeroLogSegment(const std::string &name) {
+  int fd = open(name.c_str(), O_RDWR);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = false;
+#ifdef FALLOC_FL_ZERO_RANGE
+  ok = fallocate(fd, FALLOC_FL_ZERO_RANGE, 0, log_segment_size_) == 0;
+#endif
+  if (!ok) {
+    std::vector<char> zeros(std::min(log_segment_size_, 1 << 16), 0);
+    ok = true;
+    for (int offset = 0; ok && offset < log_segment_size_;
+         offset += zeros.size()) {
+      int count = std::min<int>(zeros.size(), log_segment_size_ - offset);
+      ok = pwrite(fd, zeros.data(), count, offset) == count;
+    }
+  }
+  ok = ok && fdatasync(fd) == 0;
+  close(fd);
+  return ok;
+}
+
+/*
+ * Written over the previous record and synced, like the master record
+ */
+bool DiskManager::WriteLogControl(int first_segment, int boundary) {
+  char record[3 * sizeof(int32_t)];
+  memcpy(record, &first_segment, sizeof(int32_t));
+  memcpy(record + sizeof(int32_t), &boundary, sizeof(int32_t));
+  uint32_t crc = CRC32C::Compute(record, 2 * sizeof(int32_t));
+  memcpy(record + 2 * sizeof(int32_t), &crc, sizeof(uint32_t));
+
+  int fd = open(log_name_.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd < 0) {
+    LOG_DEBUG("can't open log control file: %s", strerror(errno));
+    return false;
+  }
+  bool ok = pwrite(fd, record, sizeof(record), 0) ==
+            static_cast<ssize_t>(sizeof(record));
+  ok = fsync(fd) == 0 && ok;
+  close(fd);
+  return ok;
+}
+
+/*
+ * The last 4 bytes of a page hold the CRC-32C of the bytes before them
+ */
+void DiskManager::SetChecksum(char *page_data) {
+  uint32_t checksum = CRC32C::Compute(page_data, PAGE_DATA_SIZE);
+  memcpy(page_data + PAGE_DATA_SIZE, &checksum, sizeof(checksum));
+}
+
+/*
+ * Only a page that was never written, all zeros like beyond the end of
+ * file, passes without a matching checksum. Anything else, like a torn
+ * write or a zeroed trailer, is reported
+ */
+bool DiskManager::VerifyChecksum(page_id_t page_id, const char *page_data) {
+  uint32_t checksum;
+  memcpy(&checksum, page_data + PAGE_DATA_SIZE, sizeof(checksum));
+  if (checksum == CRC32C::Compute(page_data, PAGE_DATA_SIZE)) {
+    return true;
+  }
+  if (checksum == 0 && page_data[0] == 0 &&
+      memcmp(page_data, page_data + 1, PAGE_DATA_SIZE - 1) == 0) {
+    return true;
+  }
+  LOG_DEBUG("checksum mismatch on page %d", page_id);
+  return false;
+}
+
 /**
  * Private helper function to get disk file size
  */
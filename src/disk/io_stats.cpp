@@ -0,0 +1,176 @@
+/**
+ * io_stats.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <thread>
+
+#include "disk/io_stats.h"
+
+namespace cmudb {
+
+const char *IOTypeName(IOType type) {
+  switch (type) {
+    case IOType::PAGE_READ:
+      return "page read";
+    case IOType::PAGE_WRITE:
+      return "page write";
+    case IOType::LOG_WRITE:
+      return "log write";
+    case IOType::SYNC:
+      return "sync";
+    default:
+      return "unknown";
+  }
+}
+
+double IOStatsSnapshot::Counters::GetMeanLatency() const {
+  return count_ == 0 ? 0 : total_ns_ / 1000.0 / count_;
+}
+
+uint64_t IOStatsSnapshot::Counters::GetPercentileLatency(double p) const {
+  uint64_t total = 0;
+  for (int i = 0; i < IO_STATS_BUCKETS; ++i) {
+    total += histogram_[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(p * total + 0.5);
+  uint64_t seen = 0;
+  for (int i = 0; i < IO_STATS_BUCKETS - 1; ++i) {
+    seen += histogram_[i];
+    if (seen >= rank && seen > 0) {
+      return 1ull << i;
+    }
+  }
+  return 1ull << (IO_STATS_BUCKETS - 1);
+}
+
+IOStatsSnapshot IOStatsSnapshot::
+operator-(const IOStatsSnapshot &earlier) const {
+  IOStatsSnapshot delta;
+  for (int t = 0; t < static_cast<int>(IOType::NUM_TYPES); ++t) {
+    const Counters &a = types_[t];
+    const Counters &b = earlier.types_[t];
+    delta.types_[t].count_ = a.count_ - b.count_;
+    delta.types_[t].bytes_ = a.bytes_ - b.bytes_;
+    delta.types_[t].total_ns_ = a.total_ns_ - b.total_ns_;
+    for (int i = 0; i < IO_STATS_BUCKETS; ++i) {
+      delta.types_[t].histogram_[i] = a.histogram_[i] - b.histogram_[i];
+    }
+  }
+  return delta;
+}
+
+std::string IOStatsSnapshot::ToString() const {
+  std::string out;
+  char line[256];
+  for (int t = 0; t < static_cast<int>(IOType::NUM_TYPES); ++t) {
+    const Counters &c = types_[t];
+    snprintf(line, sizeof(line),
+             "%-10s count %llu bytes %llu mean %.1fus p50 <%lluus "
+             "p99 <%lluus\n",
+             IOTypeName(static_cast<IOType>(t)),
+             static_cast<unsigned long long>(c.count_),
+             static_cast<unsigned long long>(c.bytes_), c.GetMeanLatency(),
+             static_cast<unsigned long long>(c.GetPercentileLatency(0.5)),
+             static_cast<unsigned long long>(c.GetPercentileLatency(0.99)));
+    out += line;
+  }
+  return out;
+}
+
+IOStats::IOStats() {
+  shards_ = static_cast<Shard *>(
+      aligned_alloc(alignof(Shard), IO_STATS_SHARDS * sizeof(Shard)));
+  for (size_t i = 0; i < IO_STATS_SHARDS; ++i) {
+    new (&shards_[i]) Shard;
+  }
+  Reset();
+}
+
+IOStats::~IOStats() {
+  for (size_t i = 0; i < IO_STATS_SHARDS; ++i) {
+    shards_[i].~Shard();
+  }
+  free(shards_);
+}
+
+uint64_t IOStats::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void IOStats::Record(IOType type, uint64_t bytes, uint64_t start_ns) {
+  RecordLatency(type, bytes, Now() - start_ns);
+}
+
+/*
+ * Every thread sticks to the shard its id hashes to, so the relaxed adds
+ * below rarely bounce a cache line between cores
+ */
+void IOStats::RecordLatency(IOType type, uint64_t bytes, uint64_t ns) {
+  thread_local const size_t shard_index =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) %
+      IO_STATS_SHARDS;
+  uint64_t us = ns / 1000;
+  int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+  if (bucket >= IO_STATS_BUCKETS) {
+    bucket = IO_STATS_BUCKETS - 1;
+  }
+
+  Shard &shard = shards_[shard_index];
+  int t = static_cast<int>(type);
+  shard.count_[t].fetch_add(1, std::memory_order_relaxed);
+  shard.bytes_[t].fetch_add(bytes, std::memory_order_relaxed);
+  shard.total_ns_[t].fetch_add(ns, std::memory_order_relaxed);
+  shard.histogram_[t][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Requests recorded while the shards are summed up may or may not be
+ * included, every counter is read once
+ */
+IOStatsSnapshot IOStats::GetSnapshot() const {
+  IOStatsSnapshot snapshot;
+  for (int t = 0; t < static_cast<int>(IOType::NUM_TYPES); ++t) {
+    IOStatsSnapshot::Counters &c = snapshot.types_[t];
+    c.count_ = c.bytes_ = c.total_ns_ = 0;
+    for (int i = 0; i < IO_STATS_BUCKETS; ++i) {
+      c.histogram_[i] = 0;
+    }
+    for (size_t i = 0; i < IO_STATS_SHARDS; ++i) {
+      const Shard &shard = shards_[i];
+      c.count_ += shard.count_[t].load(std::memory_order_relaxed);
+      c.bytes_ += shard.bytes_[t].load(std::memory_order_relaxed);
+      c.total_ns_ += shard.total_ns_[t].load(std::memory_order_relaxed);
+      for (int b = 0; b < IO_STATS_BUCKETS; ++b) {
+        c.histogram_[b] +=
+            shard.histogram_[t][b].load(std::memory_order_relaxed);
+      }
+    }
+  }
+  return snapshot;
+}
+
+void IOStats::Reset() {
+  for (size_t s = 0; s < IO_STATS_SHARDS; ++s) {
+    Shard &shard = shards_[s];
+    for (int t = 0; t < static_cast<int>(IOType::NUM_TYPES); ++t) {
+      shard.count_[t] = 0;
+      shard.bytes_[t] = 0;
+      shard.total_ns_[t] = 0;
+      for (int i = 0; i < IO_STATS_BUCKETS; ++i) {
+        shard.histogram_[t][i] = 0;
+      }
+    }
+  }
+}
+
+} // namespace cmudb
@@ -0,0 +1,179 @@
+/**
+ * lz_codec.cpp
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include "disk/lz_codec.h"
+
+namespace cmudb {
+
+static inline uint32_t Load32(const unsigned char *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+/*
+ * Append a length beyond the nibble of the token, returns false on overflow
+ */
+static inline bool PutLength(size_t length, unsigned char *&out,
+                             const unsigned char *out_end) {
+  while (length >= 255) {
+    if (out == out_end) {
+      return false;
+    }
+    *out++ = 255;
+    length -= 255;
+  }
+  if (out == out_end) {
+    return false;
+  }
+  *out++ = static_cast<unsigned char>(length);
+  return true;
+}
+
+static inline bool GetLength(size_t &length, const unsigned char *&in,
+                             const unsigned char *in_end) {
+  unsigned char byte;
+  do {
+    if (in == in_end) {
+      return false;
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/*
+ * Emit one sequence: literals [anchor, literal_end) and a match of
+ * match_length bytes at offset, or no match if match_length is 0
+ */
+static bool PutSequence(const unsigned char *anchor,
+                        const unsigned char *literal_end, size_t offset,
+                        size_t match_length, size_t min_match,
+                        unsigned char *&out, const unsigned char *out_end) {
+  size_t literal_length = literal_end - anchor;
+  if (out == out_end) {
+    return false;
+  }
+  unsigned char *token = out++;
+  *token = (literal_length < 15 ? literal_length : 15) << 4;
+  if (literal_length >= 15 && !PutLength(literal_length - 15, out, out_end)) {
+    return false;
+  }
+  if (static_cast<size_t>(out_end - out) < literal_length) {
+    return false;
+  }
+  memcpy(out, anchor, literal_length);
+  out += literal_length;
+  if (match_length == 0) {
+    return true;
+  }
+
+  if (out_end - out < 2) {
+    return false;
+  }
+  *out++ = offset & 0xff;
+  *out++ = offset >> 8;
+  size_t length = match_length - min_match;
+  *token |= length < 15 ? length : 15;
+  return length < 15 || PutLength(length - 15, out, out_end);
+}
+
+size_t LZCodec::Compress(const char *src, size_t size, char *dst,
+                         size_t capacity) {
+  if (size > 0xffff) {
+    return 0;
+  }
+  const unsigned char *in = reinterpret_cast<const unsigned char *>(src);
+  const unsigned char *in_end = in + size;
+  unsigned char *out = reinterpret_cast<unsigned char *>(dst);
+  const unsigned char *out_end = out + capacity;
+  // position + 1 of the last occurrence of a 4-byte prefix, 0 for none
+  uint16_t table[1 << HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  const unsigned char *anchor = in;
+  const unsigned char *p = in;
+  while (in_end - p >= static_cast<ptrdiff_t>(MIN_MATCH)) {
+    uint32_t prefix = Load32(p);
+    uint32_t hash = (prefix * 2654435761u) >> (32 - HASH_BITS);
+    size_t candidate = table[hash];
+    table[hash] = static_cast<uint16_t>(p - in + 1);
+    if (candidate == 0 || Load32(in + candidate - 1) != prefix) {
+      p++;
+      continue;
+    }
+
+    const unsigned char *match = in + candidate - 1;
+    size_t match_length = MIN_MATCH;
+    while (p + match_length < in_end && match[match_length] == p[match_length]) {
+      match_length++;
+    }
+    if (!PutSequence(anchor, p, p - match, match_length, MIN_MATCH, out,
+                     out_end)) {
+      return 0;
+    }
+    p += match_length;
+    anchor = p;
+  }
+  if (!PutSequence(anchor, in_end, 0, 0, MIN_MATCH, out, out_end)) {
+    return 0;
+  }
+  return out - reinterpret_cast<unsigned char *>(dst);
+}
+
+bool LZCodec::Decompress(const char *src, size_t size, char *dst,
+                         size_t dst_size) {
+  const unsigned char *in = reinterpret_cast<const unsigned char *>(src);
+  const unsigned char *in_end = in + size;
+  unsigned char *out = reinterpret_cast<unsigned char *>(dst);
+  unsigned char *out_begin = out;
+  unsigned char *out_end = out + dst_size;
+
+  while (in < in_end) {
+    unsigned char token = *in++;
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !GetLength(literal_length, in, in_end)) {
+      return false;
+    }
+    if (static_cast<size_t>(in_end - in) < literal_length ||
+        static_cast<size_t>(out_end - out) < literal_length) {
+      return false;
+    }
+    memcpy(out, in, literal_length);
+    in += literal_length;
+    out += literal_length;
+    if (in == in_end) {
+      // the last sequence has no match
+      break;
+    }
+
+    if (in_end - in < 2) {
+      return false;
+    }
+    size_t offset = in[0] | in[1] << 8;
+    in += 2;
+    size_t match_length = token & 0xf;
+    if (match_length == 15 && !GetLength(match_length, in, in_end)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > static_cast<size_t>(out - out_begin) ||
+        static_cast<size_t>(out_end - out) < match_length) {
+      return false;
+    }
+    // byte by byte, a match may overlap the bytes it produces
+    const unsigned char *match = out - offset;
+    for (size_t i = 0; i < match_length; ++i) {
+      out[i] = match[i];
+    }
+    out += match_length;
+  }
+  return out == out_end;
+}
+
+} // namespace cmudb
@@ -0,0 +1,57 @@
+/**
+ * access_strategy.h
+ *
+ * Functionality: An access strategy lets a bulk operation, such as a full
+ * table scan or recovery, cycle the pages it reads through a small private
+ * ring of frames instead of evicting the working set of the whole buffer
+ * pool. It is handed to FetchPage/NewPage/PrefetchPage: on a miss, the next
+ * frame of the ring is recycled if the operation no longer pins it,
+ * otherwise a frame is taken from the pool as usual and replaces it in the
+ * ring. Hits are not affected.
+ *
+ * The ring is split evenly among the buffer pool instances and each part is
+ * only touched under its instance latch, so a strategy may be shared by the
+ * threads of one operation, e.g. a scan and its read-ahead.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "common/config.h"
+#include "page/page.h"
+
+namespace cmudb {
+
+class BufferPoolManager;
+
+class AccessStrategy {
+  friend class BufferPoolManager;
+
+public:
+  // ring_size: frames in the ring, capped at a quarter of every instance
+  AccessStrategy(BufferPoolManager *buffer_pool_manager,
+                 size_t ring_size = BUFFER_RING_SIZE);
+
+  ~AccessStrategy();
+
+  // number of frames the ring may hold across all instances
+  size_t GetRingSize() const;
+
+private:
+  struct Slot {
+    Page *frame_;
+    page_id_t page_id_; // page the ring loaded into frame_
+  };
+
+  struct Ring {
+    std::vector<Slot> slots_;
+    size_t capacity_;
+    size_t next_; // slot to recycle next once the ring is full
+  };
+
+  BufferPoolManager *buffer_pool_manager_;
+  std::vector<Ring> rings_; // one per buffer pool instance
+};
+
+} // namespace cmudb
@@ -4,13 +4,51 @@
  * Functionality: The simplified Buffer Manager interface allows a client to
  * new/delete pages on disk, to read a disk page into the buffer pool and pin
  * it, also to unpin a page in the buffer pool.
+ *
+ * The pool is split into num_instances independent partitions that share one
+ * DiskManager. A page id is always routed to the same partition, and each
+ * partition owns its page table, free list, replacer and latch, so requests
+ * for pages living in different partitions never contend with each other.
+ *
+ * An optional page cleaner thread writes out dirty, unpinned pages at the
+ * eviction end of every partition's replacer ahead of time, so that
+ * foreground evictions rarely have to write a victim back themselves.
+ *
+ * Pages can also be read ahead: PrefetchPage queues a read that a background
+ * thread performs into an unpinned frame, which enters the replacer as a
+ * preferred victim until the page is actually fetched.
+ *
+ * Bulk operations may pass an AccessStrategy to keep the pages they bring
+ * in within a small ring of frames, see access_strategy.h.
+ *
+ * Every frame keeps the recLSN of its page for fuzzy checkpoints: it is
+ * moved up to the next lsn whenever the page is known to match its disk
+ * image while nobody else pins it, see GetDirtyPageTable.
+ *
+ * After a crash, a PageRecovery can bring every page read from disk up to
+ * date before it is handed out, see page_recovery.h. Read-ahead is skipped
+ * meanwhile.
+ *
+ * Frame data lives in a FrameArena, so every frame is aligned for a
+ * DiskManager doing direct I/O; huge_pages asks for the arena to be backed
+ * by huge pages.
  */
 
 #pragma once
+#include <condition_variable>
+#include <deque>
 #include <list>
 #include <mutex>
+#include <thread>
+#include <vector>
 
+#include "buffer/access_strategy.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/frame_arena.h"
+#include "buffer/lru_k_replacer.h"
 #include "buffer/lru_replacer.h"
+#include "buffer/page_recovery.h"
+#include "buffer/page_table.h"
 #include "disk/disk_manager.h"
 #include "hash/extendible_hash.h"
 #include "logging/log_manager.h"
@@ -18,37 +56,132 @@
 
 namespace cmudb {
 class BufferPoolManager {
+  friend class AccessStrategy;
+
 public:
   BufferPoolManager(size_t pool_size, DiskManager *disk_manager,
-                          LogManager *log_manager = nullptr);
+                          LogManager *log_manager = nullptr,
+                          size_t num_instances = 1,
+                          ReplacerType replacer_type = ReplacerType::LRU,
+                          bool huge_pages = false);
 
   ~BufferPoolManager();
 
-  Page *FetchPage(page_id_t page_id);
+  // nullptr if all frames are pinned or the page fails its checksum
+  Page *FetchPage(page_id_t page_id, AccessStrategy *strategy = nullptr);
+
+  // pin page_id only if it is resident and not being read in, never blocks
+  // on I/O, return nullptr otherwise
+  Page *TryFetchPage(page_id_t page_id);
 
-  bool UnpinPage(page_id_t page_id, bool is_dirty);
+  // read page_id into the buffer pool in the background without pinning it
+  void PrefetchPage(page_id_t page_id, AccessStrategy *strategy = nullptr);
+
+  // is_cold: the pin was only a peek, e.g. by read-ahead, and should not
+  // count as a use of the page
+  bool UnpinPage(page_id_t page_id, bool is_dirty, bool is_cold = false);
 
   bool FlushPage(page_id_t page_id);
 
-  Page *NewPage(page_id_t &page_id);
+  // write out the dirty pages among page_ids, runs of consecutive page ids
+  // go out as single vectored writes, returns once they are durable
+  bool FlushPages(const std::vector<page_id_t> &page_ids);
+  bool FlushAllPages();
+
+  Page *NewPage(page_id_t &page_id, AccessStrategy *strategy = nullptr);
+
+  // pages that may differ from their disk image, with their recLSNs. Taken
+  // one instance at a time while the pool stays in use
+  void GetDirtyPageTable(std::vector<std::pair<page_id_t, lsn_t>> &dpt);
 
   bool DeletePage(page_id_t page_id);
 
+  // redo pages on demand through page_recovery, nullptr to stop. Once this
+  // returns, no page is being recovered through the previous one any more
+  void SetPageRecovery(PageRecovery *page_recovery);
+
+  // spawn a thread that keeps up to clean_target frames at the eviction end
+  // of each instance clean, writing at most write_rate pages per second
+  void RunPageCleaner(size_t clean_target = PAGE_CLEANER_CLEAN_TARGET,
+                      size_t write_rate = PAGE_CLEANER_WRITE_RATE);
+  void StopPageCleaner();
+
+  inline size_t GetPoolSize() const { return pool_size_; }
+  inline size_t GetNumInstances() const { return instances_.size(); }
+
   // only for test purpose
   void GetPinPages(std::map<page_id_t, int> &m);
   int GetReplacerSize();
   int GetFreeListSize();
 
 private:
+  // one partition of the buffer pool, it owns frames [pages_, pages_ + size_)
+  struct BufferPoolInstance {
+    BufferPoolInstance(Page *pages, size_t size, ReplacerType replacer_type);
+    ~BufferPoolInstance();
+
+    Page *pages_;   // first frame owned by this instance
+    size_t size_;   // number of frames owned by this instance
+    HashTable<page_id_t, Page *> *page_table_; // lock-free lookups
+    Replacer<Page *> *replacer_;   // to find an unpinned page for replacement
+    std::list<Page *> *free_list_; // to find a free page for replacement
+    std::mutex latch_;             // to protect shared data structure
+  };
+
+  BufferPoolInstance *GetInstance(page_id_t page_id);
+  Page *findUnusedPage(BufferPoolInstance *instance);
+  void releaseFrame(BufferPoolInstance *instance, Page *pagePtr);
+  bool isLogDurable(Page *page);
+  lsn_t nextLSN();
+  Page *findRingPage(BufferPoolInstance *instance, page_id_t page_id,
+                     AccessStrategy *strategy);
+  bool evictPage(BufferPoolInstance *instance, Page *page);
+  bool claimFrame(Page *page, bool *claimed = nullptr);
+  void waitForClaim(BufferPoolInstance *instance, Page *page);
+  void releaseClaim(Page *page);
+  bool tryPinPage(BufferPoolInstance *instance, Page *page, page_id_t page_id);
+  void unpinFrame(BufferPoolInstance *instance, Page *page,
+                  bool is_cold = false);
+  size_t cleanInstance(BufferPoolInstance *instance, size_t budget);
+  void prefetchPage(page_id_t page_id, AccessStrategy *strategy);
+  void forgetAccessStrategy(AccessStrategy *strategy);
+  void finishIO();
+
   size_t pool_size_; // number of pages in buffer pool
   Page *pages_;      // array of pages
+  FrameArena arena_; // data of pages_, PAGE_SIZE bytes each
   DiskManager *disk_manager_;
   LogManager *log_manager_;
-  HashTable<page_id_t, Page *> *page_table_; // to keep track of pages
-  Replacer<Page *> *replacer_;   // to find an unpinned page for replacement
-  std::list<Page *> *free_list_; // to find a free page for replacement
-  std::mutex latch_;             // to protect shared data structure
+  std::vector<BufferPoolInstance *> instances_;
+  // read under any instance latch, changed under all of them
+  PageRecovery *page_recovery_;
+
+  // page cleaner related
+  std::thread *cleaner_thread_;
+  std::atomic<bool> cleaner_running_;
+  size_t clean_target_;
+  size_t write_rate_;
+  std::mutex cleaner_latch_;
+  // for waking the cleaner up early when an eviction had to write
+  std::condition_variable cleaner_cv_;
+
+  // read-ahead related, the thread is started by the first PrefetchPage
+  std::thread *prefetch_thread_;
+  bool prefetch_running_;
+  std::deque<std::pair<page_id_t, AccessStrategy *>> prefetch_queue_;
+  AccessStrategy *prefetch_strategy_; // strategy of the read in progress
+  std::mutex prefetch_latch_;         // to protect the fields above
+  std::condition_variable prefetch_cv_;
+
+  // for waiting until the page cleaner or the read-ahead thread releases a
+  // frame it claimed, without holding the instance latch
+  uint64_t claim_releases_; // protected by claim_latch_
+  std::mutex claim_latch_;
+  std::condition_variable claim_cv_;
 
-  Page* findUnusedPage(); 
+  // asynchronous reads that have not completed yet
+  size_t pending_io_;
+  std::mutex io_latch_; // to protect pending_io_
+  std::condition_variable io_cv_;
 };
 } // namespace cmudb
@@ -0,0 +1,54 @@
+/**
+ * clock_replacer.h
+ *
+ * Functionality: CLOCK (second chance) approximation of LRU. Every frame owns
+ * a slot in flat arrays holding an "evictable" flag and a reference bit, and
+ * a clock hand sweeps over the slots looking for an evictable frame whose
+ * reference bit is clear, clearing the bits it passes over.
+ *
+ * Values are mapped to slots by their distance from a base value, e.g. the
+ * first frame of a buffer pool instance, so the replacer never allocates
+ * after construction. Insert and Erase only flip atomic flags; Victim
+ * serializes the clock hand with a mutex.
+ */
+
+#pragma once
+#include <atomic>
+#include <mutex>
+
+#include "buffer/replacer.h"
+
+namespace cmudb {
+
+template <typename T> class ClockReplacer : public Replacer<T> {
+public:
+  // values must lie in [base, base + num_frames)
+  ClockReplacer(T base, size_t num_frames);
+
+  ~ClockReplacer();
+
+  void Insert(const T &value);
+
+  void InsertCold(const T &value);
+
+  bool Victim(T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  void NextVictims(std::vector<T> &values, size_t count);
+
+private:
+  size_t SlotOf(const T &value) const;
+
+  T base_;
+  size_t num_frames_;
+  std::atomic<bool> *evictable_;
+  std::atomic<bool> *referenced_;
+  std::atomic<size_t> size_;
+  size_t hand_;
+  std::mutex mutex_; // to protect hand_
+};
+
+} // namespace cmudb
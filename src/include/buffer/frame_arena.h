@@ -0,0 +1,39 @@
+/**
+ * frame_arena.h
+ *
+ * Functionality: One contiguous, zeroed memory area holding the data of all
+ * frames of a buffer pool. It is mapped directly from the kernel, so it
+ * starts on a memory page boundary and frame i, at offset i * PAGE_SIZE, is
+ * aligned as direct I/O requires.
+ *
+ * With huge_pages the arena is first requested from the huge page pool
+ * (MAP_HUGETLB) to cut TLB misses on large buffer pools. If none are
+ * reserved it falls back to regular pages and asks for transparent huge
+ * pages instead.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace cmudb {
+
+class FrameArena {
+public:
+  FrameArena(size_t size, bool huge_pages = false);
+  ~FrameArena();
+
+  inline char *GetData() { return data_; }
+  // true if the arena is backed by explicitly reserved huge pages
+  inline bool IsHugePages() const { return is_huge_pages_; }
+
+private:
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  char *data_;
+  size_t mapped_size_; // size rounded up to the page size of the mapping
+  bool is_huge_pages_;
+};
+
+} // namespace cmudb
@@ -0,0 +1,80 @@
+/**
+ * lru_k_replacer.h
+ *
+ * Functionality: LRU-K replacement. The replacer remembers the timestamps of
+ * the last K references of every frame and evicts the frame whose K-th most
+ * recent reference lies furthest in the past. Frames with fewer than K
+ * references have an infinite backward K-distance and go first, oldest
+ * reference first, so pages touched once by a sequential scan are evicted
+ * before pages that are re-referenced, such as upper B+ tree levels.
+ *
+ * A reference that follows the previous reference of the same frame within
+ * the correlated reference period, a span of time, only refreshes that
+ * previous reference instead of adding to the history. This keeps a scan
+ * that touches the same page for every tuple from looking hot.
+ *
+ * The buffer pool reports every fetch of a page with RecordAccess, also a
+ * hit on the lock-free path. Insert records a reference only for a frame
+ * that was not accessed that way since it was last made evictable, such as
+ * a new page.
+ *
+ * Like ClockReplacer, values are mapped to flat per-frame slots by their
+ * distance from a base value.
+ */
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace cmudb {
+
+template <typename T> class LRUKReplacer : public Replacer<T> {
+public:
+  // values must lie in [base, base + num_frames)
+  LRUKReplacer(
+      T base, size_t num_frames, size_t k = LRUK_REPLACER_K,
+      std::chrono::microseconds correlated_period = LRUK_CORRELATED_PERIOD);
+
+  ~LRUKReplacer();
+
+  void Insert(const T &value);
+
+  void InsertCold(const T &value);
+
+  void RecordAccess(const T &value);
+
+  bool Victim(T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  void NextVictims(std::vector<T> &values, size_t count);
+
+private:
+  size_t SlotOf(const T &value) const;
+  bool EvictsBefore(size_t slot, size_t other) const;
+  void Reference(size_t slot);
+  void ForgetHistory(size_t slot);
+
+  T base_;
+  size_t num_frames_;
+  size_t k_;
+  std::chrono::steady_clock::duration correlated_period_;
+  // history_[slot * k_ + i] is the (i + 1)-th most recent reference of slot
+  uint64_t *history_;
+  size_t *num_references_; // valid entries of each slot's history
+  // time of each slot's most recent reference, for the correlated period
+  std::chrono::steady_clock::time_point *last_reference_;
+  bool *accessed_; // referenced by RecordAccess since last made evictable
+  bool *evictable_;
+  size_t size_;
+  uint64_t current_timestamp_; // logical clock, ticks on every reference
+  std::mutex mutex_;
+};
+
+} // namespace cmudb
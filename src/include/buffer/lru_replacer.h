@@ -23,12 +23,16 @@ public:
 
   void Insert(const T &value);
 
+  void InsertCold(const T &value);
+
   bool Victim(T &value);
 
   bool Erase(const T &value);
 
   size_t Size();
 
+  void NextVictims(std::vector<T> &values, size_t count);
+
 private:
   // add your member variables here
   struct DLinkedNode {
@@ -41,6 +45,7 @@ private:
   };
 
   void insertAtHead(const T& ptr);
+  void insertAtTail(const T& ptr);
   bool erase(const T& value);
 
   std::shared_ptr<DLinkedNode> head;
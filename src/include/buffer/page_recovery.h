@@ -0,0 +1,33 @@
+/**
+ * page_recovery.h
+ *
+ * Abstract class for redoing pages on demand. While one is set on a buffer
+ * pool manager, every page read from disk is handed to RecoverPage before
+ * anybody can pin it, so pages can be used before recovery has redone the
+ * whole log, see LogRecovery::InstantRestart.
+ */
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "page/page.h"
+
+namespace cmudb {
+
+class PageRecovery {
+public:
+  PageRecovery() {}
+  virtual ~PageRecovery() {}
+  // apply the changes the page read into page is missing, called with the
+  // buffer pool instance latch held, so it must not use the buffer pool.
+  // Returns the lsn of the first change applied, INVALID_LSN if none
+  virtual lsn_t RecoverPage(Page *page) = 0;
+  // pages not recovered yet with the lsns of their first missing change,
+  // they belong into the dirty page table of a checkpoint
+  virtual void
+  GetPendingPages(std::vector<std::pair<page_id_t, lsn_t>> &pages) = 0;
+};
+
+} // namespace cmudb
@@ -0,0 +1,50 @@
+/**
+ * page_table.h
+ *
+ * Functionality: Maps the page ids resident in one buffer pool instance to
+ * their frames. The table never holds more entries than the instance has
+ * frames, so it is a fixed size open addressing (linear probing) table that
+ * never grows.
+ *
+ * Insert and Remove must be serialized by the caller (the instance latch).
+ * Find may run concurrently with them without any lock; in that case it can
+ * miss an entry that Remove is shifting around, but it never returns a
+ * frame that was not mapped at some point. Callers of the lock-free lookup
+ * therefore re-validate the frame after pinning it and fall back to a
+ * latched lookup on a miss.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "hash/hash_table.h"
+#include "page/page.h"
+
+namespace cmudb {
+
+class PageTable : public HashTable<page_id_t, Page *> {
+public:
+  // num_frames: maximum number of entries that are alive at the same time
+  explicit PageTable(size_t num_frames);
+  ~PageTable();
+
+  bool Find(const page_id_t &page_id, Page *&page) override;
+  bool Remove(const page_id_t &page_id) override;
+  void Insert(const page_id_t &page_id, Page *const &page) override;
+
+private:
+  struct Slot {
+    std::atomic<page_id_t> key_;
+    std::atomic<Page *> value_;
+  };
+
+  size_t HomeSlot(page_id_t page_id) const;
+
+  Slot *slots_;
+  size_t mask_; // number of slots - 1, number of slots is a power of two
+  int shift_;   // 32 - log2(number of slots), used by the multiplicative hash
+};
+
+} // namespace cmudb
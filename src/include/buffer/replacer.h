@@ -6,17 +6,30 @@
 #pragma once
 
 #include <cstdlib>
+#include <vector>
 
 namespace cmudb {
 
+// replacement policies a buffer pool manager can be constructed with
+enum class ReplacerType { LRU, CLOCK, LRU_K };
+
 template <typename T> class Replacer {
 public:
   Replacer() {}
   virtual ~Replacer() {}
   virtual void Insert(const T &value) = 0;
+  // like Insert, but value becomes a preferred victim instead of the most
+  // recently used one, e.g. a page that was read ahead and not used yet
+  virtual void InsertCold(const T &value) = 0;
+  // value was referenced while pinned. Only needed by a replacer that keeps
+  // a reference history, the others take recency from Insert
+  virtual void RecordAccess(const T &) {}
   virtual bool Victim(T &value) = 0;
   virtual bool Erase(const T &value) = 0;
   virtual size_t Size() = 0;
+  // collect up to count values in the order Victim would return them,
+  // without removing them from the replacer
+  virtual void NextVictims(std::vector<T> &values, size_t count) = 0;
 };
 
 } // namespace cmudb
@@ -16,15 +16,45 @@ extern std::chrono::duration<long long int> LOG_TIMEOUT;
 
 extern std::atomic<bool> ENABLE_LOGGING;
 
+// how long the log flush thread waits for more commits to join a group
+extern std::chrono::microseconds GROUP_COMMIT_DELAY;
+
+// longest time an asynchronous commit stays in the log buffer
+extern std::chrono::milliseconds ASYNC_COMMIT_DELAY;
+
+extern std::chrono::milliseconds PAGE_CLEANER_INTERVAL;
+
+// time between two fuzzy checkpoints of the checkpoint thread
+extern std::chrono::milliseconds CHECKPOINT_INTERVAL;
+
+// LRU-K counts references of a frame this close to the previous one as one
+extern std::chrono::microseconds LRUK_CORRELATED_PERIOD;
+
 #define INVALID_PAGE_ID -1 // representing an invalid page id
 #define INVALID_TXN_ID -1  // representing an invalid txn id
 #define INVALID_LSN -1     // representing an invalid lsn
 #define HEADER_PAGE_ID 0   // the header page id
 #define PAGE_SIZE 512    //112//128     // size of a data page in byte
+#define PAGE_DATA_SIZE (PAGE_SIZE - 4) // bytes before the page checksum
 #define LOG_BUFFER_SIZE                                                            \
   ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE) // size of a log buffer in byte
 #define BUCKET_SIZE 50                 // size of extendible hash bucket
 #define BUFFER_POOL_SIZE 10            // size of buffer pool
+#define LRUK_REPLACER_K 2              // references remembered by LRU-K
+#define PAGE_CLEANER_CLEAN_TARGET 4    // clean frames kept per instance
+#define PAGE_CLEANER_WRITE_RATE 1000   // pages written by cleaner per second
+#define ASYNC_IO_QUEUE_DEPTH 64        // page I/Os in flight per disk manager
+#define ASYNC_IO_THREADS 4             // workers of the thread pool backend
+#define DISK_EXTENT_PAGES 64           // pages the db file grows by at once
+#define LOG_SEGMENT_SIZE (64 * LOG_BUFFER_SIZE) // bytes of a log segment file
+#define LOG_SEGMENT_SPARES 2           // truncated log segments kept for reuse
+#define LOG_READ_CHUNK_SIZE (16 * LOG_BUFFER_SIZE) // bytes recovery reads at once
+#define COMPRESSION_BLOCK_SIZE 64      // allocation unit of compressed pages
+#define BUFFER_RING_SIZE 32            // frames of a bulk access ring
+#define TABLE_READAHEAD_MIN_PAGES 2    // initial read-ahead window of a scan
+#define TABLE_READAHEAD_MAX_PAGES 32   // largest read-ahead window of a scan
+#define IO_STATS_SHARDS 16             // per-thread counter shards of I/O stats
+#define IO_STATS_BUCKETS 24            // latency histogram buckets, up to ~8s
 
 typedef int32_t page_id_t; // page id type
 typedef int32_t txn_id_t;  // transaction id type
@@ -52,7 +52,8 @@ public:
   Transaction(txn_id_t txn_id)
       : state_(TransactionState::GROWING),
         thread_id_(std::this_thread::get_id()),
-        txn_id_(txn_id), prev_lsn_(INVALID_LSN), shared_lock_set_{new std::unordered_set<RID>},
+        txn_id_(txn_id), prev_lsn_(INVALID_LSN), async_commit_(false),
+        shared_lock_set_{new std::unordered_set<RID>},
         exclusive_lock_set_{new std::unordered_set<RID>} {
     // initialize sets
     write_set_.reset(new std::deque<WriteRecord>);
@@ -101,6 +102,13 @@ public:
 
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  // an asynchronous commit returns before its COMMIT record is durable
+  inline bool IsAsyncCommit() const { return async_commit_; }
+
+  inline void SetAsyncCommit(bool async_commit) {
+    async_commit_ = async_commit;
+  }
+
 private:
   TransactionState state_;
   // thread id, single-threaded transactions
@@ -111,6 +119,8 @@ private:
   std::shared_ptr<std::deque<WriteRecord>> write_set_;
   // prev lsn
   lsn_t prev_lsn_;
+  // commit without waiting for the log
+  bool async_commit_;
 
   // Below are used by concurrent index
   // this deque contains page pointer that was latche during index operation
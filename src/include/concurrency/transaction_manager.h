@@ -5,7 +5,11 @@
 
 #pragma once
 #include <atomic>
+#include <map>
+#include <mutex>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
@@ -16,16 +20,43 @@ class TransactionManager {
 public:
   TransactionManager(LockManager *lock_manager,
                            LogManager *log_manager = nullptr)
-      : next_txn_id_(0), lock_manager_(lock_manager),
+      : next_txn_id_(0), async_commit_(false), lock_manager_(lock_manager),
         log_manager_(log_manager) {}
   Transaction *Begin();
   void Commit(Transaction *txn);
   void Abort(Transaction *txn);
 
+  // commit mode of transactions begun from now on, a transaction may still
+  // change its own. An asynchronous commit returns once the COMMIT record is
+  // in the log buffer, and a crash within ASYNC_COMMIT_DELAY may undo it
+  inline void SetAsyncCommit(bool async_commit) {
+    async_commit_ = async_commit;
+  }
+
+  // take over a transaction that was running at a crash, to roll it back:
+  // it is registered with the lsn of its BEGIN record and continues its
+  // chain of records at prev_lsn
+  Transaction *Resume(txn_id_t txn_id, lsn_t begin_lsn, lsn_t prev_lsn);
+  // transactions begun from now on get ids above txn_id
+  void ReserveTransactionId(txn_id_t txn_id);
+  // id the next transaction gets, none below it is given out again
+  inline txn_id_t GetNextTransactionId() { return next_txn_id_; }
+
+  // the active transaction table: running transactions with lsns at or
+  // before their BEGIN records, only kept while logging is enabled
+  void GetActiveTransactions(std::vector<std::pair<txn_id_t, lsn_t>> &att);
+
 private:
+  void removeActiveTransaction(Transaction *txn);
+
   std::atomic<txn_id_t> next_txn_id_;
+  std::atomic<bool> async_commit_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
+  // a transaction is added before its BEGIN record is appended and removed
+  // after its COMMIT or ABORT record, protected by latch_
+  std::map<txn_id_t, lsn_t> active_txns_;
+  std::mutex latch_;
 };
 
 } // namespace cmudb
@@ -0,0 +1,129 @@
+/**
+ * async_io.h
+ *
+ * Functionality: Asynchronous positional reads and writes on file
+ * descriptors. A request is submitted together with a callback, which runs
+ * on an I/O thread once the transfer is done and receives the number of
+ * bytes transferred, or -errno on failure. Many requests can be in flight
+ * at once; submitting blocks only while the queue depth is exhausted.
+ *
+ * AsyncIO::Create picks io_uring when the kernel supports it and falls back
+ * to a pool of threads doing pread/pwrite otherwise. Destroying an AsyncIO
+ * waits for all requests in flight to complete.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+namespace cmudb {
+
+class AsyncIO {
+public:
+  typedef std::function<void(ssize_t)> Callback;
+
+  virtual ~AsyncIO() {}
+
+  virtual void SubmitRead(int fd, char *buf, size_t size, off_t offset,
+                          Callback callback) = 0;
+  virtual void SubmitWrite(int fd, const char *buf, size_t size, off_t offset,
+                           Callback callback) = 0;
+
+  // io_uring backend if available, thread pool backend otherwise
+  static AsyncIO *Create(size_t queue_depth, size_t num_threads);
+};
+
+/*
+ * Fallback backend, num_threads workers serve a shared request queue with
+ * blocking pread/pwrite
+ */
+class ThreadPoolAsyncIO : public AsyncIO {
+public:
+  ThreadPoolAsyncIO(size_t queue_depth, size_t num_threads);
+  ~ThreadPoolAsyncIO();
+
+  void SubmitRead(int fd, char *buf, size_t size, off_t offset,
+                  Callback callback);
+  void SubmitWrite(int fd, const char *buf, size_t size, off_t offset,
+                   Callback callback);
+
+private:
+  struct Request {
+    bool is_write_;
+    int fd_;
+    char *buf_;
+    size_t size_;
+    off_t offset_;
+    Callback callback_;
+  };
+
+  void Submit(Request request);
+  void Serve();
+
+  size_t queue_depth_;
+  std::deque<Request> queue_;
+  bool running_;
+  std::mutex latch_; // to protect queue_ and running_
+  std::condition_variable cv_;
+  std::vector<std::thread> threads_;
+};
+
+/*
+ * io_uring backend driven through the raw system calls. Submissions are
+ * serialized by a mutex, one thread reaps completions and runs callbacks.
+ */
+class UringAsyncIO : public AsyncIO {
+public:
+  explicit UringAsyncIO(size_t queue_depth);
+  ~UringAsyncIO();
+
+  // false if the kernel refused to set up a ring
+  inline bool IsValid() const { return ring_fd_ >= 0; }
+
+  void SubmitRead(int fd, char *buf, size_t size, off_t offset,
+                  Callback callback);
+  void SubmitWrite(int fd, const char *buf, size_t size, off_t offset,
+                   Callback callback);
+
+private:
+  struct Request {
+    struct iovec iov_;
+    Callback callback_;
+  };
+
+  void Submit(int opcode, int fd, void *buf, size_t size, off_t offset,
+              Callback callback);
+  void Reap();
+
+  int ring_fd_;
+  // submission queue ring
+  void *sq_ptr_;
+  size_t sq_ring_size_;
+  unsigned *sq_tail_;
+  unsigned *sq_mask_;
+  unsigned *sq_array_;
+  void *sqes_;
+  size_t sqes_size_;
+  // completion queue ring, may share the mapping of the submission ring
+  void *cq_ptr_;
+  size_t cq_ring_size_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned *cq_mask_;
+  void *cqes_;
+
+  size_t queue_depth_;
+  size_t in_flight_;
+  std::mutex latch_; // to protect the submission ring and in_flight_
+  std::condition_variable cv_;
+  std::thread *reaper_;
+};
+
+} // namespace cmudb
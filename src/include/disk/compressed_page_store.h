@@ -0,0 +1,71 @@
+/**
+ * compressed_page_store.h
+ *
+ * Functionality: Keeps pages LZ compressed in the database file. The file
+ * is cut into blocks of COMPRESSION_BLOCK_SIZE bytes and every page is
+ * stored in an extent of consecutive blocks, located through a page mapping
+ * table that is persisted in a separate ".map" file with one fixed size
+ * entry per page id. A page that does not compress by at least one block
+ * is stored as is.
+ *
+ * A rewritten page stays in its extent if it still fits, otherwise it moves
+ * to a new one and the old extent becomes free. Free extents are kept in
+ * memory by size and rebuilt from the gaps between mapped extents on open.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+
+namespace cmudb {
+
+class CompressedPageStore {
+public:
+  // db_fd: open database file, owned by the caller
+  CompressedPageStore(int db_fd, const std::string &map_name);
+  ~CompressedPageStore();
+
+  // false if the page mapping table cannot be opened
+  inline bool IsValid() const { return map_fd_ >= 0; }
+
+  bool WritePage(page_id_t page_id, const char *page_data);
+  // a page that was never written reads as zeros
+  bool ReadPage(page_id_t page_id, char *page_data);
+  void FreePage(page_id_t page_id);
+  bool Sync();
+
+  // one more than the highest page id ever written
+  page_id_t GetNumPages();
+  // bytes of the database file taken by extents, free or not
+  size_t GetFileSize();
+
+private:
+  // entry of the page mapping table as stored in the map file
+  struct Extent {
+    uint32_t block_;  // first block
+    uint16_t blocks_; // blocks reserved for the page
+    uint16_t length_; // bytes stored, 0 if unmapped, PAGE_SIZE if raw
+  };
+
+  static const size_t MAX_BLOCKS =
+      (PAGE_SIZE + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE;
+
+  uint32_t allocateExtent(uint16_t blocks);
+  bool writeEntry(page_id_t page_id, const Extent &extent);
+  bool pwriteAll(int fd, const char *data, size_t size, off_t offset);
+
+  int db_fd_;
+  int map_fd_;
+  std::vector<Extent> map_;
+  // free_extents_[n] holds the first blocks of free extents of n blocks
+  std::vector<std::vector<uint32_t>> free_extents_;
+  uint32_t end_block_; // blocks in use or free in the database file
+  std::mutex latch_;   // to protect the fields above
+};
+
+} // namespace cmudb
@@ -0,0 +1,31 @@
+/**
+ * crc32c.h
+ *
+ * Functionality: CRC-32C (Castagnoli) checksums. On x86-64 processors with
+ * SSE4.2 the crc32 instruction is used on three interleaved streams, which
+ * hides its latency and runs at memory bandwidth; everywhere else a
+ * slicing-by-8 table implementation is used. The choice is made once, at
+ * the first call.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cmudb {
+
+class CRC32C {
+public:
+  // checksum of size bytes at data, continuing from crc
+  static uint32_t Compute(const char *data, size_t size, uint32_t crc = 0);
+
+  // true if the hardware implementation is in use
+  static bool IsHardwareAccelerated();
+
+  // only for test purpose, always the table implementation
+  static uint32_t ComputePortable(const char *data, size_t size,
+                                  uint32_t crc = 0);
+};
+
+} // namespace cmudb
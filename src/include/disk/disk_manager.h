@@ -5,32 +5,134 @@
  * database. It also performs read and write of pages to and from disk, and
  * provides a logical file layer within the context of a database management
  * system.
+ *
+ * Pages are read and written with positional I/O on a plain file descriptor,
+ * so there is no shared seek position and page I/O issued by different
+ * threads runs concurrently. Page I/O can also be submitted asynchronously,
+ * the callback runs on an I/O thread once the page has been transferred.
+ *
+ * With direct_io the database file is opened with O_DIRECT and page I/O
+ * bypasses the kernel page cache, so pages are not cached twice. Direct I/O
+ * needs buffers aligned to PAGE_SIZE, as the frames of the buffer pool are;
+ * other buffers go through an aligned bounce buffer. If the file system or
+ * device refuses direct I/O, the disk manager falls back to buffered I/O.
+ *
+ * Every page is written with a CRC-32C of its first PAGE_DATA_SIZE bytes in
+ * its last 4 bytes, and ReadPage fails for a page whose checksum does not
+ * match, e.g. after a torn write.
+ *
+ * Deallocated pages are remembered in a free page map, a bitmap with one bit
+ * per page id kept in PAGE_SIZE pages of a separate ".fsm" file next to the
+ * database file, and AllocatePage reuses them before growing the file. A
+ * change of the map is written right away, but only synced by SyncPages,
+ * SyncFreePageMap and on close. On open, the next new page id is derived
+ * from the size of the database file. The file grows by extents of
+ * DISK_EXTENT_PAGES pages reserved up front with fallocate, without changing
+ * the file size.
+ *
+ * The log is split into segment files "<name>.log.<n>" of log_segment_size
+ * bytes, segment n holding log offsets [n * size, (n + 1) * size). Log
+ * offsets keep growing across segments. A segment is preallocated to its
+ * full size when it is created, so log writes never change a file size and
+ * fdatasync has no file metadata to write. Bytes beyond the end of the log
+ * are zeros, on open the end is found by following record sizes from the
+ * last truncation point. TruncateLog drops the segments below a checkpoint's
+ * redo point: up to LOG_SEGMENT_SPARES of them are zeroed and renamed to
+ * become the next segments, the others are deleted. The small "<name>.log"
+ * file holds the first segment still needed and is only rewritten by
+ * TruncateLog; without it the log is empty and old segments are removed.
+ *
+ * The master record, a few bytes in a ".master" file next to the database
+ * file, points recovery at the last complete checkpoint in the log. It is
+ * replaced with a single write and synced, and carries a CRC-32C so that a
+ * torn record is ignored rather than followed.
+ *
+ * All page I/O, log writes and syncs are counted and timed in an IOStats,
+ * see io_stats.h.
+ *
+ * With compress, a new database stores its pages LZ compressed through a
+ * CompressedPageStore, see compressed_page_store.h. Compressed pages are
+ * read and written synchronously, also when submitted asynchronously.
  */
 
 #pragma once
 #include <atomic>
-#include <fstream>
+#include <functional>
 #include <future>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "common/config.h"
+#include "disk/async_io.h"
+#include "disk/compressed_page_store.h"
+#include "disk/io_stats.h"
 
 namespace cmudb {
 
 class DiskManager {
 public:
-  DiskManager(const std::string &db_file);
+  DiskManager(const std::string &db_file, bool direct_io = false,
+              bool compress = false, int log_segment_size = LOG_SEGMENT_SIZE);
   ~DiskManager();
 
-  void WritePage(page_id_t page_id, const char *page_data);
-  void ReadPage(page_id_t page_id, char *page_data);
+  // false on I/O error, the page on disk may then be torn
+  bool WritePage(page_id_t page_id, const char *page_data);
+  // like WritePage, but the checksum goes into the last bytes of page_data
+  // instead of a copy. Nobody may change the page until this returns
+  bool WritePageInPlace(page_id_t page_id, char *page_data);
+  // false on I/O error or if the page fails its checksum
+  bool ReadPage(page_id_t page_id, char *page_data);
+
+  // write pages.size() consecutive pages starting at page_id with as few
+  // writes as possible, false on error
+  bool WritePages(page_id_t page_id, const std::vector<const char *> &pages);
+  // make the pages written so far durable
+  bool SyncPages();
 
-  void WriteLog(char *log_data, int size);
+  // callback(true) once the page is transferred, callback(false) on error.
+  // page_data must stay valid until then
+  void WritePageAsync(page_id_t page_id, const char *page_data,
+                      std::function<void(bool)> callback);
+  void ReadPageAsync(page_id_t page_id, char *page_data,
+                     std::function<void(bool)> callback);
+
+  // append to the end of the log, durable once it returns true. On error
+  // nothing is appended
+  bool WriteLog(char *log_data, int size);
+  // false at or beyond the end of the log or in its truncated part
   bool ReadLog(char *log_data, int size, int offset);
+  // offset of the end of the log
+  int GetLogSize();
+  // the log before offset, a record boundary, is no longer needed
+  void TruncateLog(int offset);
+  inline int GetLogSegmentSize() const { return log_segment_size_; }
+
+  // remember where the last checkpoint begins in the log, durably
+  bool WriteMasterRecord(lsn_t checkpoint_lsn, int checkpoint_offset);
+  // false if no checkpoint has been taken or the record is damaged
+  bool ReadMasterRecord(lsn_t &checkpoint_lsn, int &checkpoint_offset);
 
   page_id_t AllocatePage();
+  // the page id AllocatePage would return now, unless another thread is first
+  page_id_t PeekNextPage();
   void DeallocatePage(page_id_t page_id);
+  // mark page_id as allocated, used by recovery to recreate a page
+  void ReservePage(page_id_t page_id);
+  // number of pages in the free page map
+  size_t GetNumFreePages();
+  // make the changes to the free page map durable, also done by SyncPages
+  bool SyncFreePageMap();
+
+  // false if direct I/O was not requested or had to be turned off
+  inline bool IsDirectIO() const { return direct_io_; }
+  // nullptr unless pages are stored compressed
+  inline CompressedPageStore *GetCompressedPageStore() const {
+    return compressed_store_;
+  }
 
+  // counts, bytes and latencies of the I/O done so far
+  inline IOStats &GetIOStats() { return io_stats_; }
   int GetNumFlushes() const;
   bool GetFlushState() const;
   inline void SetFlushLogFuture(std::future<void> *f) { flush_log_f_ = f; }
@@ -38,16 +140,61 @@ public:
 
 private:
   int GetFileSize(const std::string &name);
-  // stream to write log file
-  std::fstream log_io_;
+  AsyncIO *GetAsyncIO();
+  bool IsAligned(const char *page_data) const;
+  void DisableDirectIO();
+  void SetChecksum(char *page_data);
+  bool VerifyChecksum(page_id_t page_id, const char *page_data);
+  bool WriteFile(page_id_t page_id, const char *page_data,
+                 size_t num_pages = 1);
+  bool ReadFile(page_id_t page_id, char *page_data);
+  void LoadFreePageMap();
+  void SetFree(page_id_t page_id, bool is_free);
+  void PreallocateExtent(page_id_t page_id);
+  std::string GetLogSegmentName(int segment) const;
+  void OpenLog();
+  void RemoveLogSegments();
+  int FindLogEnd(int offset);
+  bool ReadLogRange(char *log_data, int size, int offset);
+  bool SwitchLogSegment(int segment);
+  bool ZeroLogSegment(const std::string &name);
+  bool WriteLogControl(int first_segment, int boundary);
+  // log control file, the segments are named after it
   std::string log_name_;
-  // stream to write db file
-  std::fstream db_io_;
+  int log_segment_size_;
+  int log_fd_;                     // segment appended to, -1 if none yet
+  int log_fd_segment_;             // number of that segment
+  std::atomic<int> log_end_;       // offset of the end of the log
+  std::atomic<int> first_segment_; // segments below are truncated
+  // segments from first_segment_ up to here exist at full size
+  int segments_end_;
+  std::mutex log_latch_; // to protect segments_end_ and segment files
+  std::string master_name_;
+  // file descriptor of db file, only used with pread/pwrite
+  int db_fd_;
   std::string file_name_;
+  std::atomic<bool> direct_io_; // db_fd_ is open with O_DIRECT
+  CompressedPageStore *compressed_store_;
+  // created on first asynchronous request
+  AsyncIO *async_io_;
+  std::once_flag async_io_flag_;
+  // free page map, a set bit marks a free page id below next_page_id_
+  int fsm_fd_;
+  std::string fsm_name_;
+  bool fsm_dirty_; // written since the last sync
+  std::vector<unsigned char> free_map_;
+  size_t num_free_;
+  page_id_t free_hint_;        // no free page id below it
+  page_id_t extent_end_;       // first page id not preallocated yet
+  bool preallocate_;           // false once fallocate is not supported
+  std::mutex free_latch_;      // to protect the fields above
   std::atomic<page_id_t> next_page_id_;
+  IOStats io_stats_;
   int num_flushes_;
   bool flush_log_;
   std::future<void> *flush_log_f_;
+  // last log buffer written, used to enforce log buffer swapping
+  char *buffer_used_;
 };
 
 } // namespace cmudb
\ No newline at end of file
@@ -0,0 +1,88 @@
+/**
+ * io_stats.h
+ *
+ * Functionality: I/O statistics of a disk manager. For every kind of I/O it
+ * counts requests and bytes and keeps a latency histogram with power of two
+ * buckets: bucket 0 holds requests that took less than 1 microsecond, bucket
+ * i those that took [2^(i-1), 2^i) microseconds, the last bucket everything
+ * slower.
+ *
+ * Recording is cheap enough to stay on in production: every thread adds to
+ * one of IO_STATS_SHARDS cache line aligned shards of relaxed atomic
+ * counters, picked once per thread, so threads rarely share a cache line.
+ * GetSnapshot sums up the shards on demand. A snapshot taken before an
+ * operation can be subtracted from one taken after it to see the I/O the
+ * operation did.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "common/config.h"
+
+namespace cmudb {
+
+enum class IOType { PAGE_READ = 0, PAGE_WRITE, LOG_WRITE, SYNC, NUM_TYPES };
+
+const char *IOTypeName(IOType type);
+
+struct IOStatsSnapshot {
+  struct Counters {
+    uint64_t count_;
+    uint64_t bytes_;
+    uint64_t total_ns_; // sum of latencies
+    uint64_t histogram_[IO_STATS_BUCKETS];
+
+    // mean latency in microseconds, 0 without requests
+    double GetMeanLatency() const;
+    // upper bound of the bucket holding the p-th percentile (0 < p <= 1)
+    // of latencies in microseconds, 0 without requests
+    uint64_t GetPercentileLatency(double p) const;
+  };
+
+  Counters types_[static_cast<int>(IOType::NUM_TYPES)];
+
+  inline const Counters &Get(IOType type) const {
+    return types_[static_cast<int>(type)];
+  }
+  // I/O done between earlier and this snapshot
+  IOStatsSnapshot operator-(const IOStatsSnapshot &earlier) const;
+  // one line per kind of I/O with counts, bytes and latencies
+  std::string ToString() const;
+};
+
+class IOStats {
+public:
+  IOStats();
+  ~IOStats();
+  IOStats(const IOStats &) = delete;
+  IOStats &operator=(const IOStats &) = delete;
+
+  // steady clock in nanoseconds, the start of a request to Record
+  static uint64_t Now();
+
+  // one request of the given kind that started at start_ns and is done now
+  void Record(IOType type, uint64_t bytes, uint64_t start_ns);
+  // one request of the given kind that took latency_ns
+  void RecordLatency(IOType type, uint64_t bytes, uint64_t latency_ns);
+
+  IOStatsSnapshot GetSnapshot() const;
+  void Reset();
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> count_[static_cast<int>(IOType::NUM_TYPES)];
+    std::atomic<uint64_t> bytes_[static_cast<int>(IOType::NUM_TYPES)];
+    std::atomic<uint64_t> total_ns_[static_cast<int>(IOType::NUM_TYPES)];
+    std::atomic<uint64_t> histogram_[static_cast<int>(IOType::NUM_TYPES)]
+                                    [IO_STATS_BUCKETS];
+  };
+
+  // IO_STATS_SHARDS shards, allocated with their alignment
+  Shard *shards_;
+};
+
+} // namespace cmudb
@@ -0,0 +1,39 @@
+/**
+ * lz_codec.h
+ *
+ * Functionality: A small LZ77 codec in the style of LZ4, fast enough to sit
+ * in the page I/O path. The input is a sequence of literal runs and matches
+ * against earlier output; matches are found through a hash table of 4-byte
+ * prefixes, so compression is a single pass without any search.
+ *
+ * Each sequence is a token byte holding the literal length in the high and
+ * the match length minus MIN_MATCH in the low nibble, a nibble of 15 being
+ * continued by bytes of 255 and a final smaller byte. The literals follow,
+ * then a 2-byte little endian match offset. The last sequence has literals
+ * only. Inputs are limited to 64KB.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace cmudb {
+
+class LZCodec {
+public:
+  // compress size bytes of src into dst, returns the compressed size, or 0
+  // if it would not fit into capacity bytes
+  static size_t Compress(const char *src, size_t size, char *dst,
+                         size_t capacity);
+
+  // decompress exactly size bytes from src into exactly dst_size bytes of
+  // dst, false if the input is malformed
+  static bool Decompress(const char *src, size_t size, char *dst,
+                         size_t dst_size);
+
+private:
+  static const size_t MIN_MATCH = 4;
+  static const int HASH_BITS = 12;
+};
+
+} // namespace cmudb
@@ -0,0 +1,71 @@
+/**
+ * checkpoint_manager.h
+ *
+ * Functionality: ARIES style fuzzy checkpoints. A checkpoint appends a
+ * BEGIN_CHECKPOINT record, takes the active transaction table from the
+ * transaction manager and the dirty page table from the buffer pool while
+ * both keep running, and appends them in an END_CHECKPOINT record. Once the
+ * END_CHECKPOINT record is durable, the master record of the disk manager
+ * is pointed at the checkpoint.
+ *
+ * Nothing is flushed and nobody waits for the checkpoint: pages that are
+ * dirty stay dirty, their recLSNs tell recovery which log records may still
+ * have to be redone. Recovery reads the log from the smallest of the
+ * recLSNs and the lsns of the BEGIN records of the active transactions,
+ * instead of from its start. The log segments before that point are
+ * truncated once the master record is written.
+ */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "buffer/buffer_pool_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "disk/disk_manager.h"
+#include "logging/log_manager.h"
+
+namespace cmudb {
+
+class CheckpointManager {
+public:
+  CheckpointManager(TransactionManager *transaction_manager,
+                    LogManager *log_manager,
+                    BufferPoolManager *buffer_pool_manager,
+                    DiskManager *disk_manager)
+      : transaction_manager_(transaction_manager), log_manager_(log_manager),
+        buffer_pool_manager_(buffer_pool_manager),
+        disk_manager_(disk_manager), checkpoint_thread_(nullptr),
+        running_(false) {}
+
+  ~CheckpointManager() {
+    if (checkpoint_thread_ != nullptr) {
+      StopCheckpointThread();
+    }
+  }
+
+  // take one checkpoint, return the lsn of its BEGIN_CHECKPOINT record or
+  // INVALID_LSN if logging is disabled or the checkpoint failed
+  lsn_t Checkpoint();
+
+  // spawn a thread that takes a checkpoint every interval, it has to be
+  // stopped before the log flush thread
+  void RunCheckpointThread(
+      std::chrono::milliseconds interval = CHECKPOINT_INTERVAL);
+  void StopCheckpointThread();
+
+private:
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  DiskManager *disk_manager_;
+
+  std::thread *checkpoint_thread_;
+  bool running_;
+  std::mutex latch_; // to protect running_
+  std::condition_variable cv_;
+};
+
+} // namespace cmudb
@@ -3,12 +3,32 @@
  * log manager maintain a separate thread that is awaken when the log buffer is
  * full or time out(every X second) to write log buffer's content into disk log
  * file.
+ * It is also awaken as soon as a transaction waits for its commit record to
+ * reach the disk, and then flushes the commit records of all transactions
+ * waiting at that time with one write (group commit). Waiters register the
+ * lsn they need through a callback or a future and are woken exactly when
+ * the persistent lsn passes it.
+ *
+ * Appending takes no lock: a record atomically reserves its lsn and its
+ * bytes in the active log buffer and is serialized there concurrently with
+ * other appends. The flush thread switches buffers and waits until every
+ * reservation in the old buffer is filled, so it writes only complete
+ * records.
+ *
+ * For every buffer written since the last checkpoint the log manager
+ * remembers the log file offset of its first record, so that a checkpoint
+ * can tell recovery where in the log file to start.
  */
 
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <future>
+#include <map>
 #include <mutex>
 
 #include "disk/disk_manager.h"
@@ -19,61 +39,116 @@ namespace cmudb {
 class LogManager {
 public:
   LogManager(DiskManager *disk_manager)
-      : offset_(0), next_lsn_(0), persistent_lsn_(INVALID_LSN),
+      : flush_lsn_(INVALID_LSN), flush_now_(false), lazy_lsn_(INVALID_LSN),
+        log_size_(disk_manager->GetLogSize()), unwritten_(0),
+        unwritten_lsn_(INVALID_LSN), state_(MakeState(0, 0, 0)),
+        persistent_lsn_(INVALID_LSN), flush_thread_(nullptr),
         disk_manager_(disk_manager) {
-    // TODO: you may intialize your own defined memeber variables here
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-    flush_buffer_ = new char[LOG_BUFFER_SIZE];
+    for (int i = 0; i < 2; ++i) {
+      buffers_[i] = new char[LOG_BUFFER_SIZE];
+      filled_[i] = 0;
+    }
   }
 
   ~LogManager() {
-    delete[] log_buffer_;
-    delete[] flush_buffer_;
-    log_buffer_ = nullptr;
-    flush_buffer_ = nullptr;
+    for (int i = 0; i < 2; ++i) {
+      delete[] buffers_[i];
+      buffers_[i] = nullptr;
+    }
   }
   // spawn a separate thread to wake up periodically to flush
   void RunFlushThread();
   void StopFlushThread();
 
-  // append a log record into log buffer
+  // append a log record into log buffer, INVALID_LSN for a record that is
+  // invalid or does not fit into a log buffer
   lsn_t AppendLogRecord(LogRecord &log_record);
 
   // get/set helper functions
   inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
+  // lsn the next appended record gets
+  inline lsn_t GetNextLSN() { return StateLSN(state_); }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
-  inline char *GetLogBuffer() { return log_buffer_; }
+  // continue the lsns of the log on disk, before anything is appended
+  inline void SetNextLSN(lsn_t lsn) {
+    state_ = MakeState(StateBuffer(state_), lsn, 0);
+    persistent_lsn_ = lsn - 1;
+  }
+  inline char *GetLogBuffer() { return buffers_[StateBuffer(state_)]; }
 
   // wait lsn log record is written into disk
   // usually invoked by Abort() and Commit() in txn
   void WaitLogIntoDisk(lsn_t lsn, bool force_flush);
+  // run callback once the lsn log record is written into disk, right away if
+  // it already is. Callbacks run on the flush thread and must not block
+  void OnLogIntoDisk(lsn_t lsn, std::function<void()> callback,
+                     bool force_flush);
+  // future that becomes ready once the lsn log record is written into disk
+  std::future<void> GetLogIntoDiskFuture(lsn_t lsn, bool force_flush);
+  // have the lsn log record written within ASYNC_COMMIT_DELAY, never blocks
+  void FlushWithinDelay(lsn_t lsn);
+
+  // log file offset of a record boundary at or before the lsn log record,
+  // -1 if it is not known
+  int GetLogOffset(lsn_t lsn);
+  // the lsn log record starts at offset, for records recovery found on disk
+  void SetLogOffset(lsn_t lsn, int offset);
+  // the offsets of records before lsn are no longer asked for
+  void ForgetLogOffsets(lsn_t lsn);
 
 private:
-  // TODO: you may add your own member variables
-  // also remember to change constructor accordingly
+  // the reservation state packs the active buffer (bit 63), the next lsn
+  // (bits 32-62) and the bytes reserved in the active buffer (bits 0-31)
+  static inline uint64_t MakeState(int buffer, lsn_t next_lsn,
+                                   uint32_t offset) {
+    return static_cast<uint64_t>(buffer) << 63 |
+           static_cast<uint64_t>(next_lsn) << 32 | offset;
+  }
+  static inline int StateBuffer(uint64_t state) { return state >> 63; }
+  static inline lsn_t StateLSN(uint64_t state) {
+    return (state >> 32) & 0x7fffffff;
+  }
+  static inline uint32_t StateOffset(uint64_t state) {
+    return static_cast<uint32_t>(state);
+  }
 
-  void SwapBuffer();
-  //void SwapPromise();
+  uint64_t reserve(uint32_t size);
+  bool flushBuffer(std::unique_lock<std::mutex> &lock);
 
-  // offset_ bytes have been saved in log_buffer_, 
-  // new content should append from location log_buffer_ + offset_
-  unsigned int offset_;
-  // insert promises that write commit to log buffer 
-  // std::vector<std::promise<void>*> *insert_promise_;
-  // set return value of promises that have existed in pop_promise_
-  // std::vector<std::promise<void>*> *pop_promise_;
+  // highest lsn a waiter asked to be flushed, protected by latch_
+  lsn_t flush_lsn_;
+  // flush without waiting for more committers, protected by latch_
+  bool flush_now_;
+  // highest lsn of an asynchronous commit and when it is due to be flushed,
+  // protected by latch_
+  lsn_t lazy_lsn_;
+  std::chrono::steady_clock::time_point lazy_deadline_;
+  // log file offset of the first record of every buffer written, keyed by
+  // its lsn, and the size of the log file, protected by latch_
+  std::map<lsn_t, int> buffer_offsets_;
+  int log_size_;
+  // bytes of the inactive buffer whose write failed and the lsn following
+  // its last record. It is written again before buffers are switched, its
+  // waiters are only released then. Protected by latch_
+  uint32_t unwritten_;
+  lsn_t unwritten_lsn_;
 
-  // log_into_disk_cv_ is used when 
-  // buffer pool is full, lru evict dirty page and commit/abort transaction
-  std::condition_variable log_into_disk_cv_;
+  // callbacks waiting for their lsn to become durable, ordered by lsn and
+  // protected by latch_
+  std::multimap<lsn_t, std::function<void()>> waiters_;
+  // notified when the flush thread switches buffers, for appenders that
+  // found the active buffer full
+  std::condition_variable buffer_cv_;
 
-  // atomic counter, record the next log sequence number
-  std::atomic<lsn_t> next_lsn_;
+  // appenders reserve an lsn and a range of the active buffer by updating
+  // state_ with compare and swap, only the flush thread switches buffers
+  std::atomic<uint64_t> state_;
   // log records before & include persistent_lsn_ have been written to disk
   std::atomic<lsn_t> persistent_lsn_;
-  // log buffer related
-  char *log_buffer_;
-  char *flush_buffer_;
+  // log buffer related, one is appended to while the other is written
+  char *buffers_[2];
+  // bytes of each buffer that appenders have finished serializing into
+  std::atomic<uint32_t> filled_[2];
   // latch to protect shared member variables
   std::mutex latch_;
   // flush thread
@@ -0,0 +1,60 @@
+/**
+ * log_reader.h
+ *
+ * Reads the log sequentially for recovery, one record after the other, in
+ * chunks of chunk_size bytes. There are two chunk buffers: while records are
+ * taken from one, a background thread already reads the next chunk into the
+ * other, so parsing rarely waits for the disk.
+ *
+ * Records are handed out in place, pointing into the chunk buffer, and stay
+ * valid until the next call to Next. A record that straddles the end of a
+ * chunk is completed by moving its first part in front of the next chunk,
+ * every buffer has LOG_BUFFER_SIZE bytes reserved there, as no record is
+ * larger. That is the only copy made.
+ */
+
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "disk/disk_manager.h"
+
+namespace cmudb {
+
+class LogReader {
+public:
+  LogReader(DiskManager *disk_manager, int offset,
+            int chunk_size = LOG_READ_CHUNK_SIZE);
+  ~LogReader();
+
+  // the bytes of the next record and its log offset, nullptr at the end of
+  // the log
+  const char *Next(int &offset);
+  // log offset of the record after the last one returned
+  inline int GetOffset() const { return offset_; }
+
+private:
+  bool Refill();
+  void RunReader();
+
+  DiskManager *disk_manager_;
+  int chunk_size_;
+  // LOG_BUFFER_SIZE bytes for the start of a straddling record, followed by
+  // a chunk
+  char *buffers_[2];
+  int current_; // buffer records are taken from
+  const char *data_; // next record in the current buffer
+  const char *end_;  // end of the current chunk
+  int offset_;       // log offset of data_
+  // the reader thread fills the other buffer with the chunk at read_offset_
+  int read_offset_;
+  bool reading_;
+  bool read_ok_; // false once the end of the log is reached
+  bool stop_;
+  std::mutex latch_; // to protect the fields above
+  std::condition_variable cv_;
+  std::thread *reader_thread_;
+};
+
+} // namespace cmudb
@@ -21,11 +21,18 @@
  *------------------------------------------------------------------------------
  * For new page type log record
  *-------------------------------------------------------------
- * | HEADER | prev_page_id |
+ * | HEADER | prev_page_id | page_id |
  *-------------------------------------------------------------
+ * For end checkpoint type log record (begin checkpoint is a bare HEADER)
+ *------------------------------------------------------------------------------
+ * | HEADER | redo_offset | next_txn_id | txn_count | txn_id | begin_lsn | ... |
+ * | page_count | page_id | rec_lsn | ... |
+ *------------------------------------------------------------------------------
  */
 #pragma once
 #include <cassert>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "table/tuple.h"
@@ -44,6 +51,9 @@ enum class LogRecordType {
   ABORT,
   // when create a new page in heap table
   NEWPAGE,
+  // fuzzy checkpoint, taken while transactions keep running
+  BEGIN_CHECKPOINT,
+  END_CHECKPOINT,
 };
 
 class LogRecord {
@@ -93,16 +103,52 @@ public:
 
   // constructor for NEWPAGE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type,
-            page_id_t page_id)
+            page_id_t prev_page_id, page_id_t page_id)
       : size_(HEADER_SIZE), lsn_(INVALID_LSN), txn_id_(txn_id),
         prev_lsn_(prev_lsn), log_record_type_(log_record_type),
-        prev_page_id_(page_id) {
+        prev_page_id_(prev_page_id), page_id_(page_id) {
+    // calculate log record size
+    size_ = HEADER_SIZE + 2 * sizeof(page_id_t);
+  }
+
+  // constructor for END_CHECKPOINT type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type,
+            int32_t redo_offset, txn_id_t next_txn_id,
+            const std::vector<std::pair<txn_id_t, lsn_t>> &active_txns,
+            const std::vector<std::pair<page_id_t, lsn_t>> &dirty_pages)
+      : lsn_(INVALID_LSN), txn_id_(txn_id), prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type), redo_offset_(redo_offset),
+        next_txn_id_(next_txn_id), active_txns_(active_txns),
+        dirty_pages_(dirty_pages) {
     // calculate log record size
-    size_ = HEADER_SIZE + sizeof(page_id_t);
+    size_ = HEADER_SIZE + 3 * sizeof(int32_t) + sizeof(txn_id_t) +
+            active_txns.size() * (sizeof(txn_id_t) + sizeof(lsn_t)) +
+            dirty_pages.size() * (sizeof(page_id_t) + sizeof(lsn_t));
   }
 
   ~LogRecord() {}
 
+  // recovery reads tuples in place, copy the ones of this record so that
+  // it outlives the log buffer it was read from
+  inline void Detach() {
+    switch (log_record_type_) {
+      case LogRecordType::INSERT:
+        insert_tuple_.Detach();
+        break;
+      case LogRecordType::MARKDELETE:
+      case LogRecordType::APPLYDELETE:
+      case LogRecordType::ROLLBACKDELETE:
+        delete_tuple_.Detach();
+        break;
+      case LogRecordType::UPDATE:
+        old_tuple_.Detach();
+        new_tuple_.Detach();
+        break;
+      default:
+        break;
+    }
+  }
+
   inline RID &GetDeleteRID() { return delete_rid_; }
 
   inline Tuple &GetInserteTuple() { return insert_tuple_; }
@@ -111,6 +157,18 @@ public:
 
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
+  inline int32_t GetRedoOffset() { return redo_offset_; }
+
+  inline txn_id_t GetNextTxnId() { return next_txn_id_; }
+
+  inline std::vector<std::pair<txn_id_t, lsn_t>> &GetActiveTxns() {
+    return active_txns_;
+  }
+
+  inline std::vector<std::pair<page_id_t, lsn_t>> &GetDirtyPages() {
+    return dirty_pages_;
+  }
+
   inline int32_t GetSize() { return size_; }
 
   inline lsn_t GetLSN() { return lsn_; }
@@ -158,6 +216,16 @@ private:
 
   // case4: for new page opeartion
   page_id_t prev_page_id_ = INVALID_PAGE_ID;
+  page_id_t page_id_ = INVALID_PAGE_ID; // pages are reused, so redo needs it
+
+  // case5: for end checkpoint opeartion, the log offset recovery reads
+  // from, the id the next transaction gets, the transactions active at the
+  // checkpoint with the lsns of their BEGIN records, and the pages that may
+  // differ from disk with their recLSNs
+  int32_t redo_offset_ = 0;
+  txn_id_t next_txn_id_ = INVALID_TXN_ID;
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
   const static int HEADER_SIZE = 20;
 }; // namespace cmudb
 
@@ -1,50 +1,138 @@
 /**
  * recovery_manager.h
  * Read log file from disk, redo and undo
+ *
+ * InstantRestart is the alternative to Redo and Undo: it only reads the log,
+ * keeping the records each page misses, and opens the database right away.
+ * A page is redone when it is first read into the buffer pool, through the
+ * PageRecovery interface, while a background thread rolls back the losers
+ * as resumed transactions and then brings the remaining pages up to date.
+ *
+ * The log is read through a LogReader, and the tuples of the records read
+ * point into its buffers. Records that are kept beyond the next one, for a
+ * redo worker or for a page to redo on demand, copy their tuples first.
  */
 
 #pragma once
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/page_recovery.h"
 #include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "logging/log_reader.h"
 #include "logging/log_record.h"
 #include "page/table_page.h"
+#include "table/table_heap.h"
 
 namespace cmudb {
 
-class LogRecovery {
+class LogRecovery : public PageRecovery {
 public:
   LogRecovery(DiskManager *disk_manager,
                     BufferPoolManager *buffer_pool_manager)
       : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager),
-        offset_(0) {
+        strategy_(buffer_pool_manager), checkpoint_lsn_(INVALID_LSN),
+        redo_offset_(0), max_lsn_(INVALID_LSN), max_txn_id_(INVALID_TXN_ID),
+        restart_table_(nullptr), restart_thread_(nullptr), offset_(0) {
     // global transaction through recovery phase
     log_buffer_ = new char[LOG_BUFFER_SIZE];
   }
 
   ~LogRecovery() {
+    WaitForRestart();
+    delete restart_table_;
     delete[] log_buffer_;
     log_buffer_ = nullptr;
   }
 
-  void Redo();
+  // num_workers > 1 redoes pages on that many threads, each owning the
+  // pages that hash to it, while this thread reads the log
+  void Redo(size_t num_workers = 1);
   void Undo();
-  bool DeserializeLogRecord(const char *data, LogRecord &log_record);
+  // after Redo and Undo, before the database is used again: new records and
+  // transactions continue the lsns and transaction ids of the log, and the
+  // log manager knows where the records still on disk are for checkpoints.
+  // The recovered pages are written out
+  void ContinueLog(TransactionManager *transaction_manager,
+                   LogManager *log_manager);
+  // the tuples of log_record point into data, of which size bytes are read
+  bool DeserializeLogRecord(const char *data, int size, LogRecord &log_record);
+
+  // instead of Redo and Undo: read the log, start the flush thread and
+  // return, the database can be used while pages are redone on demand and
+  // the losers are rolled back in the background. A transaction that wants
+  // a row a loser changed dies, as it is younger than the loser
+  void InstantRestart(TransactionManager *transaction_manager,
+                      LockManager *lock_manager, LogManager *log_manager);
+  // wait until the losers are rolled back and every page is redone
+  void WaitForRestart();
+  lsn_t RecoverPage(Page *page) override;
+  void
+  GetPendingPages(std::vector<std::pair<page_id_t, lsn_t>> &pages) override;
+
+  // only for test purpose, log offset the last Redo started at
+  inline int GetRedoOffset() { return redo_offset_; }
 
 private:
   // TODO: you can add whatever member variable here
   // Don't forget to initialize newly added variable in constructor
   TablePage* GetTablePage(page_id_t page_id);
+  void Analyze();
+  void SeedLogManager(TransactionManager *transaction_manager,
+                      LogManager *log_manager);
+  bool NextLogRecord(LogReader &reader, int &offset, LogRecord &log_record);
+  bool ReadLogRecord(int offset, LogRecord &log_record);
+  bool NeedsRedo(page_id_t page_id, lsn_t lsn);
+  void ScanLog(const std::function<void(LogRecord &)> &visit);
+  void ForEachRedoPage(LogRecord &log_record,
+                       const std::function<void(LogRecord &, page_id_t)> &redo);
+
+  // a record to redo on one of the pages it changes
+  struct RedoTask {
+    page_id_t page_id_;
+    LogRecord log_record_;
+  };
+  // tasks of one redo worker in log order, handed over in batches
+  struct RedoQueue {
+    std::deque<std::vector<RedoTask>> batches_;
+    bool done_; // no more batches
+    std::mutex latch_;
+    std::condition_variable cv_;
+  };
+  void RedoPage(LogRecord &log_record, page_id_t page_id);
+  bool RedoRecord(TablePage *table_page, page_id_t page_id,
+                  LogRecord &log_record);
+  void RunRedoWorker(RedoQueue &queue);
 
   DiskManager *disk_manager_;
   BufferPoolManager *buffer_pool_manager_;
+  // recovery touches every logged page once, keep it to a ring of frames
+  AccessStrategy strategy_;
   // maintain active transactions and its corresponds latest lsn
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
   // mapping log sequence number to log file offset, for undo purpose
   std::unordered_map<lsn_t, int> lsn_mapping_;
+  // last checkpoint: its lsn, its dirty page table and where redo starts
+  lsn_t checkpoint_lsn_;
+  std::unordered_map<page_id_t, lsn_t> dirty_pages_;
+  int redo_offset_;
+  // highest lsn and transaction id in the log
+  lsn_t max_lsn_;
+  txn_id_t max_txn_id_;
+  // instant restart: the records each page still misses, in log order
+  std::unordered_map<page_id_t, std::vector<LogRecord>> chains_;
+  std::mutex restart_latch_; // to protect chains_
+  // the write sets of resumed losers refer to it
+  TableHeap *restart_table_;
+  std::thread *restart_thread_;
   // log buffer related
   int offset_;
   char *log_buffer_;
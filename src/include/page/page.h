@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
@@ -20,7 +21,8 @@ class Page {
   friend class BufferPoolManager;
 
 public:
-  Page() { ResetMemory(); }
+  // the buffer pool points data_ at the frame's slot of its arena
+  Page() : data_(nullptr) {}
   ~Page(){};
   // get actual data page content
   inline char *GetData() { return data_; }
@@ -41,10 +43,17 @@ private:
   // method used by buffer pool manager
   inline void ResetMemory() { memset(data_, 0, PAGE_SIZE); }
   // members
-  char data_[PAGE_SIZE]; // actual data
-  page_id_t page_id_ = INVALID_PAGE_ID;
-  int pin_count_ = 0;
-  bool is_dirty_ = false;
+  char *data_; // actual data, PAGE_SIZE bytes
+  // bookkeeping is atomic so resident pages can be pinned without the buffer
+  // pool latch, a pin_count_ of -1 marks a frame that is being (re)assigned
+  std::atomic<page_id_t> page_id_{INVALID_PAGE_ID};
+  std::atomic<int> pin_count_{0};
+  std::atomic<bool> is_dirty_{false};
+  // set if the read-ahead of the page failed, the next fetch reads it again
+  std::atomic<bool> read_failed_{false};
+  // recLSN: changes to the page that may not be on disk yet were all logged
+  // at or after it
+  std::atomic<lsn_t> rec_lsn_{INVALID_LSN};
   RWMutex rwlatch_;
 };
 
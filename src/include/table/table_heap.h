@@ -46,7 +46,9 @@ public:
 
   bool DeleteTableHeap();
 
-  TableIterator begin(Transaction *txn);
+  // a full scan may pass an access strategy to keep from flushing the
+  // buffer pool, it must outlive the iterator
+  TableIterator begin(Transaction *txn, AccessStrategy *strategy = nullptr);
 
   TableIterator end();
 
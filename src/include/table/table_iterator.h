@@ -2,24 +2,34 @@
  * table_iterator.h
  *
  * For seq scan of table heap
+ *
+ * The iterator reads ahead along the page chain: while it is on one page,
+ * the next pages are already being read into the buffer pool. The read-ahead
+ * window starts small and doubles whenever the scan reaches a page before
+ * its read has completed. Under an access strategy, the window is kept
+ * smaller than the strategy's ring so read-ahead pages are not recycled
+ * before the scan gets to them.
  */
 
 #pragma once
 
 #include <cassert>
 
+#include "buffer/access_strategy.h"
 #include "common/rid.h"
 #include "table/tuple.h"
 
 namespace cmudb {
 
 class TableHeap;
+class TablePage;
 
 class TableIterator {
   friend class Cursor;
 
 public:
-  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
+  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn,
+                AccessStrategy *strategy = nullptr);
 
   ~TableIterator() { delete tuple_; }
 
@@ -40,9 +50,18 @@ public:
   TableIterator operator++(int);
 
 private:
+  void ReadAhead(TablePage *cur_page);
+
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
+  AccessStrategy *strategy_;
+  // read-ahead related
+  page_id_t readahead_page_id_; // last page handed to PrefetchPage
+  size_t readahead_pages_;      // pages after the current one read ahead
+  size_t readahead_window_;     // pages to keep read ahead
+  size_t readahead_max_window_;
+
 };
 
 } // namespace cmudb
\ No newline at end of file
@@ -50,6 +50,13 @@ public:
   // deserialize tuple data(deep copy)
   void DeserializeFrom(const char *storage);
 
+  // deserialize tuple data(shallow), the tuple points into storage, which
+  // has to outlive it
+  void DeserializeView(const char *storage);
+
+  // copy the data of a tuple that points into memory it does not own
+  void Detach();
+
   // return RID of current tuple
   inline RID GetRid() const { return rid_; }
 
@@ -8,6 +8,7 @@
 #include "catalog/schema.h"
 #include "concurrency/transaction_manager.h"
 #include "index/b_plus_tree_index.h"
+#include "logging/checkpoint_manager.h"
 #include "logging/log_manager.h"
 #include "sqlite/sqlite3ext.h"
 #include "table/table_heap.h"
@@ -77,9 +78,13 @@ public:
     // txn related
     lock_manager_ = new LockManager(true); // S2PL
     transaction_manager_ = new TransactionManager(lock_manager_, log_manager_);
+    checkpoint_manager_ =
+        new CheckpointManager(transaction_manager_, log_manager_,
+                              buffer_pool_manager_, disk_manager_);
   }
 
   ~StorageEngine() {
+    delete checkpoint_manager_;
     if (ENABLE_LOGGING)
       log_manager_->StopFlushThread();
     delete disk_manager_;
@@ -94,6 +99,7 @@ public:
   LockManager *lock_manager_;
   TransactionManager *transaction_manager_;
   LogManager *log_manager_;
+  CheckpointManager *checkpoint_manager_;
 };
 
 StorageEngine *storage_engine_;
@@ -1,6 +1,7 @@
 /**
  * b_plus_tree.cpp
  */
+#include <fstream>
 #include <iostream>
 #include <string>
 
@@ -0,0 +1,129 @@
+/**
+ * checkpoint_manager.cpp
+ */
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "common/logger.h"
+#include "logging/checkpoint_manager.h"
+
+namespace cmudb {
+
+/*
+ * The tables are taken after BEGIN_CHECKPOINT is appended: a transaction
+ * that began earlier is registered by then, and a page changed earlier is
+ * either dirty or pinned, or already on disk. Everything logged later is
+ * redone without looking at the tables, so they may be outdated by the time
+ * END_CHECKPOINT is appended
+ */
+lsn_t CheckpointManager::Checkpoint() {
+  if (!ENABLE_LOGGING) {
+    return INVALID_LSN;
+  }
+  LogRecord begin_record(INVALID_TXN_ID, INVALID_LSN,
+                         LogRecordType::BEGIN_CHECKPOINT);
+  lsn_t begin_lsn = log_manager_->AppendLogRecord(begin_record);
+
+  txn_id_t next_txn_id = transaction_manager_->GetNextTransactionId();
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns;
+  transaction_manager_->GetActiveTransactions(active_txns);
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+  buffer_pool_manager_->GetDirtyPageTable(dirty_pages);
+
+  // undo follows a transaction back to its BEGIN record, redo starts at the
+  // oldest change that may be missing on disk
+  lsn_t redo_lsn = begin_lsn;
+  for (auto &txn : active_txns) {
+    redo_lsn = std::min(redo_lsn, txn.second);
+  }
+  for (auto &page : dirty_pages) {
+    redo_lsn = std::min(redo_lsn, page.second);
+  }
+
+  // the pages beyond what fits into a log buffer, the ones changed last,
+  // are folded into one entry for every unlisted page with the oldest of
+  // their recLSNs. Recovery redoes a little more, but redo starts no later
+  LogRecord tables_record(INVALID_TXN_ID, begin_lsn,
+                          LogRecordType::END_CHECKPOINT, 0, next_txn_id,
+                          active_txns, {});
+  int room = (LOG_BUFFER_SIZE - 1 - tables_record.GetSize()) /
+             static_cast<int>(sizeof(page_id_t) + sizeof(lsn_t));
+  if (room > 0 && static_cast<int>(dirty_pages.size()) > room) {
+    std::sort(dirty_pages.begin(), dirty_pages.end(),
+              [](const std::pair<page_id_t, lsn_t> &a,
+                 const std::pair<page_id_t, lsn_t> &b) {
+                return a.second < b.second;
+              });
+    lsn_t rec_lsn = dirty_pages[room - 1].second;
+    dirty_pages.resize(room - 1);
+    dirty_pages.emplace_back(INVALID_PAGE_ID, rec_lsn);
+  }
+
+  int redo_offset = log_manager_->GetLogOffset(redo_lsn);
+  if (redo_offset < 0) {
+    // recovery keeps using the previous checkpoint
+    LOG_DEBUG("no log offset known for redo lsn %d", redo_lsn);
+    return INVALID_LSN;
+  }
+  LogRecord end_record(INVALID_TXN_ID, begin_lsn,
+                       LogRecordType::END_CHECKPOINT, redo_offset,
+                       next_txn_id, active_txns, dirty_pages);
+  lsn_t end_lsn = log_manager_->AppendLogRecord(end_record);
+  if (end_lsn == INVALID_LSN) {
+    // recovery keeps using the previous checkpoint
+    LOG_DEBUG("checkpoint tables do not fit into a log buffer");
+    return INVALID_LSN;
+  }
+  log_manager_->WaitLogIntoDisk(end_lsn, true);
+
+  // page allocations before redo_lsn are no longer redone from the log
+  if (!disk_manager_->SyncFreePageMap()) {
+    return INVALID_LSN;
+  }
+  if (!disk_manager_->WriteMasterRecord(
+          begin_lsn, log_manager_->GetLogOffset(begin_lsn))) {
+    return INVALID_LSN;
+  }
+  // later checkpoints never redo from an earlier lsn, so neither recovery
+  // nor undo reads the log before redo_offset again
+  log_manager_->ForgetLogOffsets(redo_lsn);
+  disk_manager_->TruncateLog(redo_offset);
+  LOG_DEBUG("checkpoint at lsn %d, redo from lsn %d", begin_lsn, redo_lsn);
+  return begin_lsn;
+}
+
+void CheckpointManager::RunCheckpointThread(
+    std::chrono::milliseconds interval) {
+  assert(checkpoint_thread_ == nullptr);
+  running_ = true;
+  checkpoint_thread_ = new std::thread([this, interval] {
+    std::unique_lock<std::mutex> lock(latch_);
+    while (true) {
+      cv_.wait_for(lock, interval, [&] { return !running_; });
+      if (!running_) {
+        break;
+      }
+      lock.unlock();
+      Checkpoint();
+      lock.lock();
+    }
+  });
+}
+
+/*
+ * Stop and join the checkpoint thread, a checkpoint in progress completes
+ */
+void CheckpointManager::StopCheckpointThread() {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  checkpoint_thread_->join();
+  delete checkpoint_thread_;
+  checkpoint_thread_ = nullptr;
+}
+
+} // namespace cmudb
@@ -3,7 +3,9 @@
  */
 
 #include <chrono>
+#include <memory>
 #include <thread>
+#include <vector>
 #include "logging/log_manager.h"
 #include "common/logger.h"
 
@@ -14,6 +16,14 @@ namespace cmudb {
  * The flush can be triggered when the log buffer is full or buffer pool
  * manager wants to force flush (it only happens when the flushed page has a
  * larger LSN than persistent LSN)
+ * The flush thread is also the group commit leader: a committer waiting in
+ * WaitLogIntoDisk wakes it up right away, it waits GROUP_COMMIT_DELAY for
+ * more committers to join and then writes the whole log buffer at once.
+ * Commits arriving while a write is in progress form the next group.
+ * Asynchronous commits do not wait, but are flushed ASYNC_COMMIT_DELAY
+ * after the first of them at the latest.
+ * A buffer whose write fails is written again every LOG_TIMEOUT, nobody
+ * waiting for its records is released before that succeeds.
  */
 void LogManager::RunFlushThread() {
   if (!ENABLE_LOGGING) {
@@ -22,39 +32,122 @@ void LogManager::RunFlushThread() {
 
   flush_thread_ = new std::thread([&] {
     std::unique_lock<std::mutex> lock(latch_);
-    int tmp_next_lsn = next_lsn_;
-    int prev_offset;
-
     while (ENABLE_LOGGING) {
-      std::cv_status status = cv_.wait_for(lock, LOG_TIMEOUT);
-      if (ENABLE_LOGGING && persistent_lsn_ + 1 < next_lsn_) {
-        SwapBuffer();
-        tmp_next_lsn = next_lsn_;
-        prev_offset = offset_;
-        offset_ = 0;
-        if (status != std::cv_status::timeout) {
-          LOG_DEBUG("cv status is not timeout, maybe caused by full logbuffer");
-          log_into_disk_cv_.notify_all();
+      // sleep until a waiter shows up, an asynchronous commit is due or
+      // LOG_TIMEOUT has passed
+      std::chrono::steady_clock::time_point timeout =
+          std::chrono::steady_clock::now() + LOG_TIMEOUT;
+      while (ENABLE_LOGGING &&
+             !((StateOffset(state_) > 0 || unwritten_ > 0) &&
+               flush_lsn_ > persistent_lsn_)) {
+        auto wakeup = timeout;
+        if (lazy_lsn_ > persistent_lsn_) {
+          wakeup = std::min(wakeup, lazy_deadline_);
         }
-        lock.unlock();
-
-        LOG_DEBUG("flush_buffer size:%lu, prev_offset=%d", strlen(flush_buffer_), prev_offset);
-        disk_manager_->WriteLog(flush_buffer_, prev_offset);
-        persistent_lsn_ = --tmp_next_lsn;
-
-        // set value at promise to notify future
-        log_into_disk_cv_.notify_all();
-        lock.lock();
+        if (std::chrono::steady_clock::now() >= wakeup) {
+          break;
+        }
+        cv_.wait_until(lock, wakeup);
+      }
+      if (ENABLE_LOGGING && !flush_now_ && flush_lsn_ > persistent_lsn_ &&
+          GROUP_COMMIT_DELAY.count() > 0) {
+        cv_.wait_for(lock, GROUP_COMMIT_DELAY,
+                     [&] { return !ENABLE_LOGGING || flush_now_; });
+      }
+      if (!flushBuffer(lock)) {
+        cv_.wait_for(lock, LOG_TIMEOUT, [&] { return !ENABLE_LOGGING; });
+      }
+    }
+    // release everybody waiting for a record that made it into the buffer
+    while (StateOffset(state_) > 0 || unwritten_ > 0) {
+      if (!flushBuffer(lock)) {
+        LOG_WARN("log write failed, records after lsn %d are lost",
+                 static_cast<lsn_t>(persistent_lsn_));
+        break;
       }
     }
   });
 }
+
+/*
+ * Write out the log buffer, the caller holds latch_ through lock. Appending
+ * goes on into the other buffer while the write is in progress. A buffer
+ * whose write failed is written again instead, without switching buffers.
+ * Returns false if the write failed, the records are not durable then
+ */
+bool LogManager::flushBuffer(std::unique_lock<std::mutex> &lock) {
+  flush_now_ = false;
+  int buffer;
+  uint32_t size;
+  lsn_t end_lsn;
+  if (unwritten_ > 0) {
+    buffer = 1 - StateBuffer(state_);
+    size = unwritten_;
+    end_lsn = unwritten_lsn_;
+    lock.unlock();
+  } else {
+    uint64_t state = state_;
+    do {
+      if (StateOffset(state) == 0) {
+        return true;
+      }
+    } while (!state_.compare_exchange_weak(
+        state, MakeState(1 - StateBuffer(state), StateLSN(state), 0)));
+    buffer = StateBuffer(state);
+    size = StateOffset(state);
+    end_lsn = StateLSN(state);
+    // appenders waiting for room in the log buffer
+    buffer_cv_.notify_all();
+    lock.unlock();
+
+    // records reserved before the switch may still be serialized
+    while (filled_[buffer].load(std::memory_order_acquire) != size) {
+      std::this_thread::yield();
+    }
+    filled_[buffer] = 0;
+  }
+  bool ok = disk_manager_->WriteLog(buffers_[buffer], size);
+
+  lock.lock();
+  if (!ok) {
+    LOG_DEBUG("log write failed, lsns up to %d are not durable", end_lsn - 1);
+    unwritten_ = size;
+    unwritten_lsn_ = end_lsn;
+    return false;
+  }
+  unwritten_ = 0;
+  buffer_offsets_.emplace(persistent_lsn_ + 1, log_size_);
+  log_size_ += size;
+  persistent_lsn_ = end_lsn - 1;
+  auto end = waiters_.upper_bound(persistent_lsn_);
+  std::vector<std::function<void()>> callbacks;
+  for (auto it = waiters_.begin(); it != end; ++it) {
+    callbacks.push_back(std::move(it->second));
+  }
+  waiters_.erase(waiters_.begin(), end);
+  lock.unlock();
+  for (auto &callback : callbacks) {
+    callback();
+  }
+  lock.lock();
+  return true;
+}
+
 /*
  * Stop and join the flush thread, set ENABLE_LOGGING = false
  */
 void LogManager::StopFlushThread() {
-  ENABLE_LOGGING = false;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    ENABLE_LOGGING = false;
+  }
+  cv_.notify_all();
+  if (flush_thread_ == nullptr) {
+    return;
+  }
   flush_thread_->join();
+  delete flush_thread_;
+  flush_thread_ = nullptr;
 }
 
 /*
@@ -78,83 +171,212 @@ void LogManager::StopFlushThread() {
  *
  */
 lsn_t LogManager::AppendLogRecord(LogRecord &log_record) {
-  //LOG_DEBUG("AppendLogRecord() before lock");
-  std::unique_lock<std::mutex> lock(latch_);
-  //LOG_DEBUG("AppendLogRecord() after lock");
-  while (offset_ + log_record.size_ >= LOG_BUFFER_SIZE) {
-    //LOG_DEBUG("AppendLogRecord() in while() offset_=%d, record.size=%d, log_buffer_size=%d", offset_, log_record.size_, LOG_BUFFER_SIZE);
-    cv_.notify_all();
-    // here need to notified by method RunFlushThread()
-    log_into_disk_cv_.wait_for(lock, LOG_TIMEOUT);
+  switch (log_record.log_record_type_) {
+    case LogRecordType::INSERT:
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+    case LogRecordType::UPDATE:
+    case LogRecordType::NEWPAGE:
+    case LogRecordType::BEGIN:
+    case LogRecordType::COMMIT:
+    case LogRecordType::ABORT:
+    case LogRecordType::BEGIN_CHECKPOINT:
+    case LogRecordType::END_CHECKPOINT:
+      break;
+    default:
+      LOG_DEBUG("invalid log record type in AppendLogRecord()");
+      return INVALID_LSN;
+  }
+  // reserve could never find room for it
+  if (log_record.size_ >= LOG_BUFFER_SIZE) {
+    LOG_DEBUG("log record of %d bytes does not fit into a log buffer",
+              log_record.size_);
+    return INVALID_LSN;
   }
-  //LOG_DEBUG("AppendLogRecord() after while()");
 
-  log_record.lsn_ = next_lsn_++;
-  memcpy(log_buffer_ + offset_, &log_record, LogRecord::HEADER_SIZE);
-  offset_ += LogRecord::HEADER_SIZE;
+  uint64_t state = reserve(log_record.size_);
+  int buffer = StateBuffer(state);
+  char *log_buffer = buffers_[buffer] + StateOffset(state);
+  log_record.lsn_ = StateLSN(state);
+  memcpy(log_buffer, &log_record, LogRecord::HEADER_SIZE);
+  int pos = LogRecord::HEADER_SIZE;
 
   LOG_DEBUG("log_record: %s", log_record.ToString().c_str());
   switch (log_record.log_record_type_) {
     case LogRecordType::INSERT:
-      memcpy(log_buffer_ + offset_, &log_record.insert_rid_, sizeof(RID));
-      offset_ += sizeof(RID);
-      log_record.insert_tuple_.SerializeTo(log_buffer_ + offset_);
-      offset_ = offset_ + sizeof(int32_t) + log_record.insert_tuple_.GetLength();
+      memcpy(log_buffer + pos, &log_record.insert_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record.insert_tuple_.SerializeTo(log_buffer + pos);
       break;
     case LogRecordType::MARKDELETE:
     case LogRecordType::APPLYDELETE:
     case LogRecordType::ROLLBACKDELETE:
-      memcpy(log_buffer_ + offset_, &log_record.delete_rid_, sizeof(RID));
-      offset_ += sizeof(RID);
-      log_record.delete_tuple_.SerializeTo(log_buffer_ + offset_);
-      offset_ = offset_ + sizeof(int32_t) + log_record.delete_tuple_.GetLength();
+      memcpy(log_buffer + pos, &log_record.delete_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record.delete_tuple_.SerializeTo(log_buffer + pos);
       break;
     case LogRecordType::UPDATE:
-      memcpy(log_buffer_ + offset_, &log_record.update_rid_, sizeof(RID));
-      offset_ += sizeof(RID);
-      log_record.old_tuple_.SerializeTo(log_buffer_ + offset_);
-      offset_ = offset_ + sizeof(int32_t) + log_record.old_tuple_.GetLength();
-      log_record.new_tuple_.SerializeTo(log_buffer_ + offset_);
-      offset_ = offset_ + sizeof(int32_t) + log_record.new_tuple_.GetLength();
+      memcpy(log_buffer + pos, &log_record.update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record.old_tuple_.SerializeTo(log_buffer + pos);
+      pos = pos + sizeof(int32_t) + log_record.old_tuple_.GetLength();
+      log_record.new_tuple_.SerializeTo(log_buffer + pos);
       break;
     case LogRecordType::NEWPAGE:
-      memcpy(log_buffer_ + offset_, &log_record.prev_page_id_, sizeof(page_id_t));
-      offset_ += sizeof(page_id_t);
+      memcpy(log_buffer + pos, &log_record.prev_page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(log_buffer + pos, &log_record.page_id_, sizeof(page_id_t));
       break;
-    case LogRecordType::BEGIN:
-    case LogRecordType::COMMIT:
-    case LogRecordType::ABORT:
+    case LogRecordType::END_CHECKPOINT: {
+      int32_t count;
+      memcpy(log_buffer + pos, &log_record.redo_offset_, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      memcpy(log_buffer + pos, &log_record.next_txn_id_, sizeof(txn_id_t));
+      pos += sizeof(txn_id_t);
+      count = log_record.active_txns_.size();
+      memcpy(log_buffer + pos, &count, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (auto &txn : log_record.active_txns_) {
+        memcpy(log_buffer + pos, &txn.first, sizeof(txn_id_t));
+        memcpy(log_buffer + pos + sizeof(txn_id_t), &txn.second, sizeof(lsn_t));
+        pos += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      count = log_record.dirty_pages_.size();
+      memcpy(log_buffer + pos, &count, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (auto &page : log_record.dirty_pages_) {
+        memcpy(log_buffer + pos, &page.first, sizeof(page_id_t));
+        memcpy(log_buffer + pos + sizeof(page_id_t), &page.second,
+               sizeof(lsn_t));
+        pos += sizeof(page_id_t) + sizeof(lsn_t);
+      }
       break;
+    }
     default:
-      LOG_DEBUG("invalid log record type in AppendLogRecord()");
-      return INVALID_LSN;
+      break;
   }
-  LOG_DEBUG("offset_=%u", offset_);
+  // publish the record to the flush thread
+  filled_[buffer].fetch_add(log_record.size_, std::memory_order_release);
   return log_record.lsn_;
 }
 
+/*
+ * Reserve the next lsn and size bytes of the active log buffer, size is
+ * below LOG_BUFFER_SIZE. Returns the state the reservation was made in.
+ * Only a full buffer takes the latch, to have the flush thread switch
+ * buffers and wait for it
+ */
+uint64_t LogManager::reserve(uint32_t size) {
+  uint64_t state = state_;
+  while (true) {
+    uint32_t offset = StateOffset(state);
+    if (offset + size < LOG_BUFFER_SIZE) {
+      if (state_.compare_exchange_weak(
+              state, MakeState(StateBuffer(state), StateLSN(state) + 1,
+                               offset + size))) {
+        return state;
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(latch_);
+    flush_lsn_ = std::max(flush_lsn_, StateLSN(state_) - 1);
+    flush_now_ = true;
+    cv_.notify_all();
+    // here need to notified by method RunFlushThread()
+    buffer_cv_.wait(lock, [&] {
+      return StateOffset(state_) + size < LOG_BUFFER_SIZE;
+    });
+    state = state_;
+  }
+}
+
+/*
+ * Block until the record at lsn is on disk. The flush thread is woken up
+ * right away, force_flush skips the wait for more committers to join
+ */
 void LogManager::WaitLogIntoDisk(lsn_t lsn, bool force_flush) {
-  std::unique_lock<std::mutex> lock(latch_);
-  while (lsn > persistent_lsn_) {
-    if (force_flush) {
+  if (lsn <= persistent_lsn_) {
+    return;
+  }
+  GetLogIntoDiskFuture(lsn, force_flush).wait();
+}
+
+void LogManager::OnLogIntoDisk(lsn_t lsn, std::function<void()> callback,
+                               bool force_flush) {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (lsn > persistent_lsn_) {
+      waiters_.emplace(lsn, std::move(callback));
+      flush_lsn_ = std::max(flush_lsn_, lsn);
+      if (force_flush) {
+        flush_now_ = true;
+      }
       cv_.notify_all();
+      return;
     }
-    log_into_disk_cv_.wait_for(lock, std::chrono::milliseconds(300));
   }
+  callback();
 }
 
-void LogManager::SwapBuffer() {
-  char* tmp_buffer = log_buffer_;
-  log_buffer_ = flush_buffer_;
-  flush_buffer_ = tmp_buffer;
-  memset(log_buffer_, '\0', strlen(log_buffer_));
+/*
+ * Have the record at lsn written within ASYNC_COMMIT_DELAY without waiting
+ * for it, used by asynchronous commits. The first pending request sets the
+ * deadline, later ones ride along
+ */
+void LogManager::FlushWithinDelay(lsn_t lsn) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (lsn <= persistent_lsn_) {
+    return;
+  }
+  if (lazy_lsn_ <= persistent_lsn_) {
+    lazy_deadline_ = std::chrono::steady_clock::now() + ASYNC_COMMIT_DELAY;
+    cv_.notify_all();
+  }
+  lazy_lsn_ = std::max(lazy_lsn_, lsn);
 }
 
-//void LogManager::SwapPromise() {
-//  std::vector<std::promise<void>>* tmp_promise = insert_promise_;
-//  insert_promise_ = pop_promise_;
-//  pop_promise_ = insert_promise_;
-//  insert_promise_->clear();
-//}
+/*
+ * Records that are not written yet go after the end of the log file. For an
+ * lsn whose offset was forgotten or predates this log manager, -1 is
+ * returned
+ */
+int LogManager::GetLogOffset(lsn_t lsn) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (lsn > persistent_lsn_) {
+    return log_size_;
+  }
+  auto it = buffer_offsets_.upper_bound(lsn);
+  if (it == buffer_offsets_.begin()) {
+    // forgotten, or written before this log manager started
+    return -1;
+  }
+  return (--it)->second;
+}
+
+void LogManager::SetLogOffset(lsn_t lsn, int offset) {
+  std::lock_guard<std::mutex> guard(latch_);
+  buffer_offsets_[lsn] = offset;
+}
+
+/*
+ * Keep the buffer holding lsn, it is where a later lookup would end up
+ */
+void LogManager::ForgetLogOffsets(lsn_t lsn) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto it = buffer_offsets_.upper_bound(lsn);
+  if (it != buffer_offsets_.begin()) {
+    buffer_offsets_.erase(buffer_offsets_.begin(), --it);
+  }
+}
+
+std::future<void> LogManager::GetLogIntoDiskFuture(lsn_t lsn,
+                                                   bool force_flush) {
+  auto promise = std::make_shared<std::promise<void>>();
+  std::future<void> future = promise->get_future();
+  OnLogIntoDisk(lsn, [promise] { promise->set_value(); }, force_flush);
+  return future;
+}
 
 } // namespace cmudb
@@ -0,0 +1,107 @@
+/**
+ * log_reader.cpp
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include "logging/log_reader.h"
+
+namespace cmudb {
+
+LogReader::LogReader(DiskManager *disk_manager, int offset, int chunk_size)
+    : disk_manager_(disk_manager), chunk_size_(chunk_size), current_(1),
+      offset_(offset), read_offset_(offset), reading_(true), read_ok_(false),
+      stop_(false) {
+  for (int i = 0; i < 2; ++i) {
+    buffers_[i] = new char[LOG_BUFFER_SIZE + chunk_size_];
+  }
+  // nothing to take yet, the first chunk is read into buffer 0
+  data_ = end_ = buffers_[current_] + LOG_BUFFER_SIZE;
+  reader_thread_ = new std::thread(&LogReader::RunReader, this);
+}
+
+LogReader::~LogReader() {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  reader_thread_->join();
+  delete reader_thread_;
+  for (int i = 0; i < 2; ++i) {
+    delete[] buffers_[i];
+    buffers_[i] = nullptr;
+  }
+}
+
+/*
+ * the log ends at a zero size, ReadLog zeroes the part of a chunk beyond it
+ */
+const char *LogReader::Next(int &offset) {
+  while (true) {
+    int left = end_ - data_;
+    if (left >= static_cast<int>(sizeof(int32_t))) {
+      int32_t size = *reinterpret_cast<const int32_t *>(data_);
+      if (size <= 0 || size > LOG_BUFFER_SIZE) {
+        return nullptr;
+      }
+      if (size <= left) {
+        const char *record = data_;
+        offset = offset_;
+        data_ += size;
+        offset_ += size;
+        return record;
+      }
+    }
+    if (!Refill()) {
+      return nullptr;
+    }
+  }
+}
+
+/*
+ * switch to the chunk read ahead, with the incomplete record left in the
+ * current one moved in front of it, and start reading the chunk after it
+ * into the current buffer
+ */
+bool LogReader::Refill() {
+  std::unique_lock<std::mutex> lock(latch_);
+  cv_.wait(lock, [&] { return !reading_; });
+  if (!read_ok_) {
+    return false;
+  }
+  int left = end_ - data_;
+  assert(left < LOG_BUFFER_SIZE);
+  int next = 1 - current_;
+  char *chunk = buffers_[next] + LOG_BUFFER_SIZE;
+  memcpy(chunk - left, data_, left);
+  data_ = chunk - left;
+  end_ = chunk + chunk_size_;
+  current_ = next;
+  read_offset_ += chunk_size_;
+  reading_ = true;
+  lock.unlock();
+  cv_.notify_all();
+  return true;
+}
+
+void LogReader::RunReader() {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (true) {
+    cv_.wait(lock, [&] { return reading_ || stop_; });
+    if (stop_) {
+      break;
+    }
+    char *chunk = buffers_[1 - current_] + LOG_BUFFER_SIZE;
+    int offset = read_offset_;
+    lock.unlock();
+    bool ok = disk_manager_->ReadLog(chunk, chunk_size_, offset);
+    lock.lock();
+    read_ok_ = ok;
+    reading_ = false;
+    cv_.notify_all();
+  }
+}
+
+} // namespace cmudb
@@ -2,25 +2,29 @@
  * log_recovey.cpp
  */
 
+#include <chrono>
+#include <functional>
+#include <thread>
+
 #include "logging/log_recovery.h"
 #include "page/table_page.h"
 
 namespace cmudb {
 /*
- * deserialize a log record from log buffer
+ * deserialize a log record from log buffer, its tuples are not copied but
+ * point into data
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
  */
-bool LogRecovery::DeserializeLogRecord(const char *data,
+bool LogRecovery::DeserializeLogRecord(const char *data, int size,
                                              LogRecord &log_record) {
-  //assert(offset_ == static_cast<int>(data - log_buffer_));
-  if (data - log_buffer_ + 4 > LOG_BUFFER_SIZE) {
+  if (size < 4) {
     return false;
   }
   // parse header of LogRecord from data
   char* record_ptr = const_cast<char*>(data);
   log_record.size_ = *reinterpret_cast<int*>(record_ptr);
-  if (record_ptr - log_buffer_ + log_record.size_ > LOG_BUFFER_SIZE) {
+  if (log_record.size_ > size) {
     return false;
   }
   record_ptr += 4;
@@ -33,19 +37,23 @@ bool LogRecovery::DeserializeLogRecord(const char *data,
   log_record.log_record_type_ = *reinterpret_cast<LogRecordType*>(record_ptr);
   record_ptr += 4;
   LOG_DEBUG("LogRecord=%s", log_record.ToString().c_str());
+  bool is_checkpoint =
+      log_record.log_record_type_ == LogRecordType::BEGIN_CHECKPOINT ||
+      log_record.log_record_type_ == LogRecordType::END_CHECKPOINT;
   if (log_record.size_ <= 0 || log_record.lsn_ == INVALID_LSN ||
-    log_record.txn_id_ == INVALID_TXN_ID || log_record.log_record_type_ == LogRecordType::INVALID) {
+    (log_record.txn_id_ == INVALID_TXN_ID && !is_checkpoint) || log_record.log_record_type_ == LogRecordType::INVALID) {
     return false;
   }
   switch (log_record.log_record_type_) {
     case LogRecordType::BEGIN:
     case LogRecordType::COMMIT:
     case LogRecordType::ABORT:
+    case LogRecordType::BEGIN_CHECKPOINT:
       break;
     case LogRecordType::INSERT:
       log_record.insert_rid_ = *reinterpret_cast<RID*>(record_ptr);
       record_ptr += sizeof(RID);
-      log_record.insert_tuple_.DeserializeFrom(record_ptr);
+      log_record.insert_tuple_.DeserializeView(record_ptr);
       record_ptr = record_ptr + 4 + log_record.insert_tuple_.GetLength();
       break;
     case LogRecordType::APPLYDELETE:
@@ -53,170 +61,355 @@ bool LogRecovery::DeserializeLogRecord(const char *data,
     case LogRecordType::ROLLBACKDELETE:
       log_record.delete_rid_ = *reinterpret_cast<RID*>(record_ptr);
       record_ptr += sizeof(RID);
-      log_record.delete_tuple_.DeserializeFrom(record_ptr);
+      log_record.delete_tuple_.DeserializeView(record_ptr);
       record_ptr = record_ptr + 4 + log_record.delete_tuple_.GetLength();
       break;
     case LogRecordType::UPDATE:
       log_record.update_rid_ = *reinterpret_cast<RID*>(record_ptr);
       record_ptr += sizeof(RID);
-      log_record.old_tuple_.DeserializeFrom(record_ptr);
+      log_record.old_tuple_.DeserializeView(record_ptr);
       record_ptr = record_ptr + 4 + log_record.old_tuple_.GetLength();
-      log_record.new_tuple_.DeserializeFrom(record_ptr);
+      log_record.new_tuple_.DeserializeView(record_ptr);
       record_ptr = record_ptr + 4 + log_record.new_tuple_.GetLength();
       break;
     case LogRecordType::NEWPAGE:
       log_record.prev_page_id_ = *reinterpret_cast<page_id_t*>(record_ptr);
+      record_ptr += sizeof(page_id_t);
+      log_record.page_id_ = *reinterpret_cast<page_id_t*>(record_ptr);
       break;
+    case LogRecordType::END_CHECKPOINT: {
+      log_record.redo_offset_ = *reinterpret_cast<int32_t*>(record_ptr);
+      record_ptr += sizeof(int32_t);
+      log_record.next_txn_id_ = *reinterpret_cast<txn_id_t*>(record_ptr);
+      record_ptr += sizeof(txn_id_t);
+      int32_t count = *reinterpret_cast<int32_t*>(record_ptr);
+      record_ptr += sizeof(int32_t);
+      log_record.active_txns_.clear();
+      for (int32_t i = 0; i < count; ++i) {
+        log_record.active_txns_.emplace_back(
+            *reinterpret_cast<txn_id_t*>(record_ptr),
+            *reinterpret_cast<lsn_t*>(record_ptr + sizeof(txn_id_t)));
+        record_ptr += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      count = *reinterpret_cast<int32_t*>(record_ptr);
+      record_ptr += sizeof(int32_t);
+      log_record.dirty_pages_.clear();
+      for (int32_t i = 0; i < count; ++i) {
+        log_record.dirty_pages_.emplace_back(
+            *reinterpret_cast<page_id_t*>(record_ptr),
+            *reinterpret_cast<lsn_t*>(record_ptr + sizeof(page_id_t)));
+        record_ptr += sizeof(page_id_t) + sizeof(lsn_t);
+      }
+      break;
+    }
     default:
       assert(false);
   }
   return true;
 }
 
+/*
+ *analysis of the last checkpoint, the master record points at its
+ *BEGIN_CHECKPOINT record, which is followed by its END_CHECKPOINT record.
+ *Its active transaction table seeds active_txn_ and its dirty page table
+ *limits redo of the records logged before it. Without a complete
+ *checkpoint, recovery reads the whole log
+ */
+void LogRecovery::Analyze() {
+  checkpoint_lsn_ = INVALID_LSN;
+  redo_offset_ = 0;
+  lsn_t checkpoint_lsn;
+  int offset;
+  if (!disk_manager_->ReadMasterRecord(checkpoint_lsn, offset)) {
+    return;
+  }
+  LogReader reader(disk_manager_, offset);
+  LogRecord log_record;
+  bool found_begin = false;
+  while (NextLogRecord(reader, offset, log_record)) {
+    if (log_record.GetLogRecordType() == LogRecordType::BEGIN_CHECKPOINT &&
+        log_record.GetLSN() == checkpoint_lsn) {
+      found_begin = true;
+    } else if (found_begin && log_record.GetLogRecordType() ==
+                                  LogRecordType::END_CHECKPOINT &&
+               log_record.GetPrevLSN() == checkpoint_lsn) {
+      checkpoint_lsn_ = checkpoint_lsn;
+      redo_offset_ = log_record.GetRedoOffset();
+      // transactions that ended before the redo offset are not read again
+      max_txn_id_ = std::max(max_txn_id_, log_record.GetNextTxnId() - 1);
+      for (auto &txn : log_record.GetActiveTxns()) {
+        active_txn_[txn.first] = txn.second;
+        max_txn_id_ = std::max(max_txn_id_, txn.first);
+      }
+      for (auto &page : log_record.GetDirtyPages()) {
+        dirty_pages_[page.first] = page.second;
+      }
+      LOG_DEBUG("checkpoint at lsn %d, redo from offset %d", checkpoint_lsn_,
+                redo_offset_);
+      return;
+    }
+  }
+  LOG_DEBUG("master record does not match the log, ignore it");
+}
+
+/*
+ *the next record of the log and its offset, false at the end of the log or
+ *at a record that cannot be deserialized
+ */
+bool LogRecovery::NextLogRecord(LogReader &reader, int &offset,
+                                LogRecord &log_record) {
+  const char *data = reader.Next(offset);
+  return data != nullptr &&
+         DeserializeLogRecord(data, reader.GetOffset() - offset, log_record);
+}
+
+/*
+ *the record at offset, read into log_buffer_ for undo. Most records fit in
+ *a page, the rest of a larger one is read when its size is known
+ */
+bool LogRecovery::ReadLogRecord(int offset, LogRecord &log_record) {
+  if (!disk_manager_->ReadLog(log_buffer_, PAGE_SIZE, offset)) {
+    return false;
+  }
+  int32_t size = *reinterpret_cast<int32_t *>(log_buffer_);
+  if (size > PAGE_SIZE && size <= LOG_BUFFER_SIZE &&
+      !disk_manager_->ReadLog(log_buffer_ + PAGE_SIZE, size - PAGE_SIZE,
+                              offset + PAGE_SIZE)) {
+    return false;
+  }
+  return DeserializeLogRecord(log_buffer_, LOG_BUFFER_SIZE, log_record);
+}
+
+/*
+ *A record logged before the checkpoint only needs redo if its page was in
+ *the dirty page table, and was changed at or after the page's recLSN. An
+ *entry for INVALID_PAGE_ID stands for every page that is not listed
+ */
+bool LogRecovery::NeedsRedo(page_id_t page_id, lsn_t lsn) {
+  if (checkpoint_lsn_ == INVALID_LSN || lsn > checkpoint_lsn_) {
+    return true;
+  }
+  auto it = dirty_pages_.find(page_id);
+  if (it == dirty_pages_.end()) {
+    // the pages a full dirty page table left out
+    it = dirty_pages_.find(INVALID_PAGE_ID);
+  }
+  return it != dirty_pages_.end() && it->second <= lsn;
+}
+
+/*
+ *read the log from the redo offset to its end, build active_txn_ table &
+ *lsn_mapping_ table, keep the highest lsn and transaction id and hand every
+ *record to visit
+ */
+void LogRecovery::ScanLog(const std::function<void(LogRecord &)> &visit) {
+  offset_ = redo_offset_;
+  LogReader reader(disk_manager_, offset_);
+  LogRecord log_record;
+  int offset;
+  while (NextLogRecord(reader, offset, log_record)) {
+    lsn_mapping_[log_record.GetLSN()] = offset;
+    offset_ = offset + log_record.GetSize();
+    max_lsn_ = std::max(max_lsn_, log_record.GetLSN());
+    max_txn_id_ = std::max(max_txn_id_, log_record.GetTxnId());
+    if (log_record.GetTxnId() != INVALID_TXN_ID) {
+      active_txn_[log_record.GetTxnId()] = log_record.GetLSN();
+    }
+    if (log_record.GetLogRecordType() == LogRecordType::COMMIT ||
+        log_record.GetLogRecordType() == LogRecordType::ABORT) {
+      active_txn_.erase(log_record.GetTxnId());
+    }
+    visit(log_record);
+  }
+}
+
+/*
+ *call redo for every page log_record changes that may miss the change on
+ *disk. NEWPAGE changes two pages and is always redone
+ */
+void LogRecovery::ForEachRedoPage(
+    LogRecord &log_record,
+    const std::function<void(LogRecord &, page_id_t)> &redo) {
+  page_id_t page_id;
+  switch (log_record.GetLogRecordType()) {
+    case LogRecordType::INSERT:
+      page_id = log_record.GetInsertRID().GetPageId();
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      page_id = log_record.GetDeleteRID().GetPageId();
+      break;
+    case LogRecordType::UPDATE:
+      page_id = log_record.update_rid_.GetPageId();
+      break;
+    case LogRecordType::NEWPAGE:
+      // the page is beyond the end of file if it was never written
+      disk_manager_->ReservePage(log_record.page_id_);
+      redo(log_record, log_record.page_id_);
+      if (log_record.prev_page_id_ != INVALID_PAGE_ID) {
+        redo(log_record, log_record.prev_page_id_);
+      }
+      return;
+    default:
+      return;
+  }
+  if (NeedsRedo(page_id, log_record.GetLSN())) {
+    redo(log_record, page_id);
+  }
+}
+
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
  *read log file from the beginning to end (you must prefetch log records into
  *log buffer to reduce unnecessary I/O operations), remember to compare page's
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
+ *With a checkpoint, reading starts at its redo offset instead of the
+ *beginning
+ *With num_workers > 1 this thread only reads the log and keeps the tables,
+ *every page change goes to the worker owning the page, so the changes of a
+ *page are still applied in log order
  */
-void LogRecovery::Redo() {
+void LogRecovery::Redo(size_t num_workers) {
+  // records handed to a worker at once, and batches queued per worker
+  const size_t BATCH_RECORDS = 64;
+  const size_t QUEUE_BATCHES = 8;
   assert(!ENABLE_LOGGING);
-  // Two args below are used for ReadLog() in DiskManager
-  offset_ = 0;
-  int lsn_offset = 0;
-  char left_log_buffer[LOG_BUFFER_SIZE];
-  
-  LogRecord log_record;
-  char* data;
-  RID rid;
-  TablePage* table_page;
+  Analyze();
+
+  // a worker pins one page at a time, leave frames for the others
+  num_workers = std::min(num_workers, buffer_pool_manager_->GetPoolSize() / 2);
+  std::vector<RedoQueue> queues(num_workers > 1 ? num_workers : 0);
+  std::vector<std::vector<RedoTask>> batches(queues.size());
+  std::vector<std::thread> workers;
+  for (auto &queue : queues) {
+    queue.done_ = false;
+    workers.emplace_back([this, &queue] { RunRedoWorker(queue); });
+  }
+  auto submit = [&](size_t worker, bool done) {
+    RedoQueue &queue = queues[worker];
+    std::unique_lock<std::mutex> lock(queue.latch_);
+    queue.cv_.wait(lock,
+                   [&] { return queue.batches_.size() < QUEUE_BATCHES; });
+    if (!batches[worker].empty()) {
+      queue.batches_.push_back(std::move(batches[worker]));
+      batches[worker].clear();
+    }
+    queue.done_ = done;
+    lock.unlock();
+    queue.cv_.notify_all();
+  };
+  auto dispatch = [&](LogRecord &log_record, page_id_t page_id) {
+    if (queues.empty()) {
+      RedoPage(log_record, page_id);
+      return;
+    }
+    size_t worker = std::hash<page_id_t>()(page_id) % queues.size();
+    batches[worker].push_back(RedoTask{page_id, log_record});
+    // applied after the reader has moved on
+    batches[worker].back().log_record_.Detach();
+    if (batches[worker].size() >= BATCH_RECORDS) {
+      submit(worker, false);
+    }
+  };
+
+  ScanLog([&](LogRecord &log_record) {
+    ForEachRedoPage(log_record, dispatch);
+  });
+  for (size_t worker = 0; worker < queues.size(); ++worker) {
+    submit(worker, true);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+/*
+ *apply the part of log_record that changes page_id through the buffer pool
+ */
+void LogRecovery::RedoPage(LogRecord &log_record, page_id_t page_id) {
+  TablePage* table_page = GetTablePage(page_id);
+  table_page->WLatch();
+  bool changed = RedoRecord(table_page, page_id, log_record);
+  table_page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, changed);
+}
+
+/*
+ *apply the part of log_record that changes table_page, page page_id, false
+ *if the page already has the change. NEWPAGE changes two pages, the new one is
+ *initialized and the previous one linked to it
+ */
+bool LogRecovery::RedoRecord(TablePage *table_page, page_id_t page_id,
+                             LogRecord &log_record) {
   // return value of operating tuple in table page 
   bool ret;
-  page_id_t new_page_id;
-  bool read_log_ret = disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, offset_);
-  while (read_log_ret) {
-    data = log_buffer_;
-    while (DeserializeLogRecord(data, log_record)) {
-      active_txn_[log_record.GetTxnId()] = log_record.GetTxnId();
-      lsn_mapping_[log_record.GetLSN()] = lsn_offset;
-      lsn_offset += log_record.GetSize();
-      data += log_record.GetSize();
-      switch (log_record.GetLogRecordType()) {
-        case LogRecordType::INSERT:
-          rid = log_record.GetInsertRID();
-          table_page = GetTablePage(rid.GetPageId());
-          // already written into disk
-          if (table_page->GetLSN() >= log_record.GetLSN()) {
-            break;
-          }
-          table_page->WLatch();
-          ret = table_page->InsertTuple(log_record.GetInserteTuple(), rid, nullptr, nullptr, nullptr);
-          assert(ret);
-          table_page->WUnlatch();
-          buffer_pool_manager_->UnpinPage(rid.GetPageId(), true);
-          break;
-        case LogRecordType::BEGIN:
-          break;
-        case LogRecordType::COMMIT:
-        case LogRecordType::ABORT:
-          active_txn_.erase(log_record.GetTxnId());
-          break;
-        case LogRecordType::MARKDELETE:
-          rid = log_record.GetDeleteRID();
-          table_page = GetTablePage(rid.GetPageId());
-          // already written into disk
-          if (table_page->GetLSN() >= log_record.GetLSN()) {
-            break;
-          }
-          table_page->WLatch();
-          ret = table_page->MarkDelete(rid, nullptr, nullptr, nullptr);
-          assert(ret);
-          table_page->WUnlatch();
-          buffer_pool_manager_->UnpinPage(rid.GetPageId(), true);
-          break;
-        case LogRecordType::APPLYDELETE:
-          rid = log_record.GetDeleteRID();
-          table_page = GetTablePage(rid.GetPageId());
-          // already written into disk
-          if (table_page->GetLSN() >= log_record.GetLSN()) {
-            break;
-          }
-          table_page->WLatch();
-          table_page->ApplyDelete(rid, nullptr, nullptr);
-          table_page->WUnlatch();
-          buffer_pool_manager_->UnpinPage(rid.GetPageId(), true);
-          break;
-        case LogRecordType::ROLLBACKDELETE:
-          rid = log_record.GetDeleteRID();
-          table_page = GetTablePage(rid.GetPageId());
-          // already written into disk
-          if (table_page->GetLSN() >= log_record.GetLSN()) {
-            break;
-          }
-          table_page->WLatch();
-          table_page->RollbackDelete(rid, nullptr, nullptr);
-          table_page->WUnlatch();
-          buffer_pool_manager_->UnpinPage(rid.GetPageId(), true);
-          break;
-        case LogRecordType::UPDATE:
-          rid = log_record.update_rid_;
-          table_page = GetTablePage(rid.GetPageId());
-          if (log_record.GetLSN() <= table_page->GetPageId()) {
-            break;
-          }
-          table_page->WLatch();
-          ret = table_page->UpdateTuple(log_record.new_tuple_, log_record.old_tuple_, rid, nullptr, nullptr, nullptr);
-          assert(ret);
-          table_page->WUnlatch();
-          buffer_pool_manager_->UnpinPage(rid.GetPageId(), true);
-          break;
-        case LogRecordType::NEWPAGE:
-          table_page = static_cast<TablePage*>(buffer_pool_manager_->NewPage(new_page_id));
-          assert(table_page != nullptr);
-          table_page->WLatch();
-          if (log_record.GetLSN() > table_page->GetLSN()) {
-            table_page->Init(new_page_id, PAGE_SIZE, log_record.prev_page_id_, nullptr, nullptr);
-            table_page->SetLSN(log_record.GetLSN());
-          }
-          if (log_record.prev_page_id_ != INVALID_PAGE_ID) {
-            TablePage *pre_page = GetTablePage(log_record.prev_page_id_);
-            pre_page->WLatch();
-            if (pre_page->GetNextPageId() == INVALID_PAGE_ID) {
-              pre_page->SetNextPageId(new_page_id);
-            }
-            // only for test purpose
-            else {
-              assert(new_page_id == pre_page->GetNextPageId());
-            }
-            pre_page->WUnlatch();
-            buffer_pool_manager_->UnpinPage(log_record.prev_page_id_, true);
-          }
-          table_page->WUnlatch();
-          buffer_pool_manager_->UnpinPage(new_page_id, true);
-          break;
-        default:
-          assert(false);  
+  RID rid;
+  if (log_record.GetLogRecordType() == LogRecordType::NEWPAGE) {
+    if (page_id == log_record.page_id_) {
+      if (log_record.GetLSN() > table_page->GetLSN()) {
+        table_page->Init(page_id, PAGE_DATA_SIZE, log_record.prev_page_id_, nullptr, nullptr);
+        table_page->SetLSN(log_record.GetLSN());
       }
+    } else if (table_page->GetNextPageId() == INVALID_PAGE_ID) {
+      table_page->SetNextPageId(log_record.page_id_);
     }
-
-    LOG_DEBUG("data-log_buffer_=%d, LOG_BUFFER_SIZE=%d", (int)(data - log_buffer_), LOG_BUFFER_SIZE);
-    if (data - log_buffer_ == LOG_BUFFER_SIZE) {
-      offset_ += LOG_BUFFER_SIZE;
-      read_log_ret = disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, offset_);
-    }
-    else if (data - log_buffer_ < LOG_BUFFER_SIZE) {
-      offset_ += (data - log_buffer_);
-      int left_buffer_size = log_buffer_ + LOG_BUFFER_SIZE - data;
-      LOG_DEBUG("left_buffer_size:%d", left_buffer_size);
-      memcpy(left_log_buffer, data, left_buffer_size);
-      read_log_ret = disk_manager_->ReadLog(log_buffer_, data - log_buffer_, offset_);
-      memmove(log_buffer_ + left_buffer_size, log_buffer_, data - log_buffer_);
-      memcpy(log_buffer_, left_log_buffer, left_buffer_size);
-    }
+    // only for test purpose
     else {
+      assert(log_record.page_id_ == table_page->GetNextPageId());
+    }
+    return true;
+  }
+  // already written into disk
+  if (table_page->GetLSN() >= log_record.GetLSN()) {
+    return false;
+  }
+  switch (log_record.GetLogRecordType()) {
+    case LogRecordType::INSERT:
+      rid = log_record.GetInsertRID();
+      ret = table_page->InsertTuple(log_record.GetInserteTuple(), rid, nullptr, nullptr, nullptr);
+      assert(ret);
+      break;
+    case LogRecordType::MARKDELETE:
+      ret = table_page->MarkDelete(log_record.GetDeleteRID(), nullptr, nullptr, nullptr);
+      assert(ret);
+      break;
+    case LogRecordType::APPLYDELETE:
+      table_page->ApplyDelete(log_record.GetDeleteRID(), nullptr, nullptr);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      table_page->RollbackDelete(log_record.GetDeleteRID(), nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE:
+      ret = table_page->UpdateTuple(log_record.new_tuple_, log_record.old_tuple_, log_record.update_rid_, nullptr, nullptr, nullptr);
+      assert(ret);
+      break;
+    default:
       assert(false);
+  }
+  table_page->SetLSN(log_record.GetLSN());
+  return true;
+}
+
+/*
+ *apply the batches of one worker until the reader is done
+ */
+void LogRecovery::RunRedoWorker(RedoQueue &queue) {
+  std::unique_lock<std::mutex> lock(queue.latch_);
+  while (true) {
+    queue.cv_.wait(lock, [&] { return !queue.batches_.empty() || queue.done_; });
+    if (queue.batches_.empty()) {
+      break;
+    }
+    std::vector<RedoTask> batch = std::move(queue.batches_.front());
+    queue.batches_.pop_front();
+    lock.unlock();
+    queue.cv_.notify_all();
+    for (auto &task : batch) {
+      RedoPage(task.log_record_, task.page_id_);
     }
+    lock.lock();
   }
 }
 
@@ -228,11 +421,10 @@ void LogRecovery::Undo() {
   std::unordered_map<txn_id_t, lsn_t>::iterator it;
   for (it = active_txn_.begin(); it != active_txn_.end(); it++) {
     int offset = lsn_mapping_[it->second];
-    disk_manager_->ReadLog(log_buffer_, PAGE_SIZE, offset);
     LogRecord log_record;
 
     while (true) {
-      if (!DeserializeLogRecord(log_buffer_, log_record)) {
+      if (!ReadLogRecord(offset, log_record)) {
         LOG_WARN("Deserialize log record failed in Undo() function");
         break;
       }
@@ -288,13 +480,220 @@ void LogRecovery::Undo() {
       }
 
       offset = lsn_mapping_[log_record.GetPrevLSN()];
-      disk_manager_->ReadLog(log_buffer_, PAGE_SIZE, offset);
     }
   }
 }
 
+/*
+ *the lsns appended from now on follow the log, so the recovered pages are
+ *written out once the log manager regards all of it as durable. Otherwise
+ *they would be dirty since an lsn before the log, which no checkpoint can
+ *redo from
+ */
+void LogRecovery::ContinueLog(TransactionManager *transaction_manager,
+                              LogManager *log_manager) {
+  SeedLogManager(transaction_manager, log_manager);
+  buffer_pool_manager_->FlushAllPages();
+}
+
+/*
+ *new records and transactions continue where the log ends, and checkpoints
+ *find the offsets of the records read
+ */
+void LogRecovery::SeedLogManager(TransactionManager *transaction_manager,
+                                 LogManager *log_manager) {
+  if (max_lsn_ != INVALID_LSN) {
+    log_manager->SetNextLSN(max_lsn_ + 1);
+  }
+  if (max_txn_id_ != INVALID_TXN_ID) {
+    transaction_manager->ReserveTransactionId(max_txn_id_);
+  }
+  for (auto &mapping : lsn_mapping_) {
+    log_manager->SetLogOffset(mapping.first, mapping.second);
+  }
+}
+
+/*
+ *instant restart: one pass over the log collects the records every page
+ *misses and the write sets of the losers, no page is read. The losers are
+ *resumed with their rows locked exclusively, so nobody sees their changes,
+ *and rolled back through TransactionManager::Abort on a background thread,
+ *which logs the rollback like any other abort
+ */
+void LogRecovery::InstantRestart(TransactionManager *transaction_manager,
+                                 LockManager *lock_manager,
+                                 LogManager *log_manager) {
+  assert(!ENABLE_LOGGING);
+  assert(restart_thread_ == nullptr);
+  Analyze();
+  restart_table_ = new TableHeap(buffer_pool_manager_, lock_manager,
+                                 log_manager, INVALID_PAGE_ID);
+
+  // lsn of the BEGIN record of every transaction seen
+  std::unordered_map<txn_id_t, lsn_t> begin_lsns(active_txn_);
+  std::unordered_map<txn_id_t, std::deque<WriteRecord>> write_sets;
+  auto append = [this](LogRecord &log_record, page_id_t page_id) {
+    chains_[page_id].push_back(log_record);
+    chains_[page_id].back().Detach();
+  };
+  // undo the last write of txn_id on rid with type wtype, a rollback that
+  // was under way at the crash
+  auto rolled_back = [&](txn_id_t txn_id, const RID &rid, WType wtype) {
+    auto &write_set = write_sets[txn_id];
+    for (auto it = write_set.rbegin(); it != write_set.rend(); ++it) {
+      if (it->rid_ == rid && it->wtype_ == wtype) {
+        write_set.erase(std::next(it).base());
+        return;
+      }
+    }
+  };
+
+  ScanLog([&](LogRecord &log_record) {
+    ForEachRedoPage(log_record, append);
+    txn_id_t txn_id = log_record.GetTxnId();
+    switch (log_record.GetLogRecordType()) {
+      case LogRecordType::BEGIN:
+        begin_lsns[txn_id] = log_record.GetLSN();
+        break;
+      case LogRecordType::COMMIT:
+      case LogRecordType::ABORT:
+        write_sets.erase(txn_id);
+        break;
+      case LogRecordType::INSERT:
+        write_sets[txn_id].emplace_back(log_record.GetInsertRID(),
+                                        WType::INSERT, Tuple{},
+                                        restart_table_);
+        break;
+      case LogRecordType::MARKDELETE:
+        write_sets[txn_id].emplace_back(log_record.GetDeleteRID(),
+                                        WType::DELETE, Tuple{},
+                                        restart_table_);
+        break;
+      case LogRecordType::UPDATE: {
+        Tuple old_tuple(log_record.old_tuple_);
+        old_tuple.Detach();
+        write_sets[txn_id].emplace_back(log_record.update_rid_, WType::UPDATE,
+                                        old_tuple, restart_table_);
+        break;
+      }
+      case LogRecordType::APPLYDELETE:
+        rolled_back(txn_id, log_record.GetDeleteRID(), WType::INSERT);
+        break;
+      case LogRecordType::ROLLBACKDELETE:
+        rolled_back(txn_id, log_record.GetDeleteRID(), WType::DELETE);
+        break;
+      default:
+        break;
+    }
+  });
+
+  // the pending pages are dirty since lsns of the log on disk
+  SeedLogManager(transaction_manager, log_manager);
+  std::vector<Transaction *> losers;
+  for (auto &txn : active_txn_) {
+    Transaction *loser = transaction_manager->Resume(
+        txn.first, begin_lsns[txn.first], txn.second);
+    auto write_set = loser->GetWriteSet();
+    for (auto &item : write_sets[txn.first]) {
+      write_set->push_back(item);
+      if (loser->GetExclusiveLockSet()->count(item.rid_) == 0) {
+        bool locked = lock_manager->LockExclusive(loser, item.rid_);
+        assert(locked);
+        (void)locked;
+      }
+    }
+    losers.push_back(loser);
+  }
+  LOG_DEBUG("instant restart: %d pages to redo, %d losers",
+            static_cast<int>(chains_.size()), static_cast<int>(losers.size()));
+
+  buffer_pool_manager_->SetPageRecovery(this);
+  log_manager->RunFlushThread();
+  restart_thread_ = new std::thread([this, transaction_manager, losers] {
+    const auto RETRY_DELAY = std::chrono::milliseconds(1);
+    for (auto loser : losers) {
+      transaction_manager->Abort(loser);
+      delete loser;
+    }
+    // fetching a pending page redoes it. A page that cannot be fetched now,
+    // with every frame pinned, stays pending and is tried again, any other
+    // fetch of it meanwhile redoes it as well
+    std::vector<page_id_t> page_ids;
+    while (true) {
+      page_ids.clear();
+      {
+        std::lock_guard<std::mutex> guard(restart_latch_);
+        for (auto &chain : chains_) {
+          page_ids.push_back(chain.first);
+        }
+      }
+      if (page_ids.empty()) {
+        break;
+      }
+      bool fetched = false;
+      for (auto page_id : page_ids) {
+        Page *page = buffer_pool_manager_->FetchPage(page_id, &strategy_);
+        if (page != nullptr) {
+          buffer_pool_manager_->UnpinPage(page_id, false);
+          fetched = true;
+        }
+      }
+      if (!fetched) {
+        LOG_DEBUG("cannot fetch any of %d pages to redo, retry",
+                  static_cast<int>(page_ids.size()));
+        std::this_thread::sleep_for(RETRY_DELAY);
+      }
+    }
+    buffer_pool_manager_->SetPageRecovery(nullptr);
+  });
+}
+
+void LogRecovery::WaitForRestart() {
+  if (restart_thread_ != nullptr) {
+    restart_thread_->join();
+    delete restart_thread_;
+    restart_thread_ = nullptr;
+  }
+}
+
+/*
+ *apply the records the page misses to the image just read, under the
+ *latch of its buffer pool instance, so nobody else sees the page yet
+ */
+lsn_t LogRecovery::RecoverPage(Page *page) {
+  std::vector<LogRecord> chain;
+  {
+    std::lock_guard<std::mutex> guard(restart_latch_);
+    auto it = chains_.find(page->GetPageId());
+    if (it == chains_.end()) {
+      return INVALID_LSN;
+    }
+    chain = std::move(it->second);
+    chains_.erase(it);
+  }
+  // the page id in the header of a page that was never written is zero
+  page_id_t page_id = page->GetPageId();
+  TablePage *table_page = static_cast<TablePage *>(page);
+  lsn_t rec_lsn = INVALID_LSN;
+  for (auto &log_record : chain) {
+    if (RedoRecord(table_page, page_id, log_record) &&
+        rec_lsn == INVALID_LSN) {
+      rec_lsn = log_record.GetLSN();
+    }
+  }
+  return rec_lsn;
+}
+
+void LogRecovery::GetPendingPages(
+    std::vector<std::pair<page_id_t, lsn_t>> &pages) {
+  std::lock_guard<std::mutex> guard(restart_latch_);
+  for (auto &chain : chains_) {
+    pages.emplace_back(chain.first, chain.second.front().GetLSN());
+  }
+}
+
 TablePage* LogRecovery::GetTablePage(page_id_t page_id) {
-  TablePage* table_page = static_cast<TablePage*>(buffer_pool_manager_->FetchPage(page_id));
+  TablePage* table_page = static_cast<TablePage*>(buffer_pool_manager_->FetchPage(page_id, &strategy_));
   if (table_page == nullptr) {
     LOG_DEBUG("all page are pinned while fetch in Recovery");
     throw Exception(EXCEPTION_TYPE_INDEX,
@@ -27,7 +27,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id,
   assert(sizeof(B_PLUS_TREE_INTERNAL_PAGE_TYPE) == 24);
   LOG_DEBUG("internal PAGE_SIZE: %d", PAGE_SIZE);
   LOG_DEBUG("internal sizeof(MappingType): %lu", sizeof(MappingType));
-  int maxSize = (PAGE_SIZE - sizeof(B_PLUS_TREE_INTERNAL_PAGE_TYPE)) / sizeof(MappingType) - 1;
+  int maxSize = (PAGE_DATA_SIZE - sizeof(B_PLUS_TREE_INTERNAL_PAGE_TYPE)) / sizeof(MappingType) - 1;
   LOG_DEBUG("internal maxSize: %d", maxSize);
   SetMaxSize(maxSize);
 }
@@ -291,7 +291,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(
   recipient->CopyLastFrom(pair, buffer_pool_manager);
 
   Page* page = buffer_pool_manager->FetchPage(child_page_id);
-  BPlusTreeInternalPage* child_page = reinterpret_cast<BPlusTreeInternalPage*>(page);
+  BPlusTreeInternalPage* child_page = reinterpret_cast<BPlusTreeInternalPage*>(page->GetData());
   child_page->SetParentPageId(recipient->GetPageId());
 
   buffer_pool_manager->UnpinPage(child_page_id, true);
@@ -309,7 +309,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(
     throw Exception(EXCEPTION_TYPE_INDEX,
       "all page are pinned while printing");
   }
-  BPlusTreeInternalPage* parent_page = reinterpret_cast<BPlusTreeInternalPage*>(page);
+  BPlusTreeInternalPage* parent_page = reinterpret_cast<BPlusTreeInternalPage*>(page->GetData());
   int index = parent_page->ValueIndex(GetPageId());
   KeyType key = parent_page->KeyAt(index + 1);
 
@@ -31,7 +31,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id) {
   assert(sizeof(B_PLUS_TREE_LEAF_PAGE_TYPE) == 28);
   LOG_DEBUG("leaf PAGE_SIZE: %d", PAGE_SIZE);
   LOG_DEBUG("leaf sizeof(MappingType): %lu", sizeof(MappingType));  
-  int max_size = (PAGE_SIZE - sizeof(B_PLUS_TREE_LEAF_PAGE_TYPE)) / sizeof(MappingType) - 1;
+  int max_size = (PAGE_DATA_SIZE - sizeof(B_PLUS_TREE_LEAF_PAGE_TYPE)) / sizeof(MappingType) - 1;
   LOG_DEBUG("leaf max_size: %d", max_size);
   SetMaxSize(max_size);
 } 
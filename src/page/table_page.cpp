@@ -7,6 +7,14 @@
 #include "page/table_page.h"
 
 namespace cmudb {
+/**
+ * Recovery changes pages without a transaction, also while logging is
+ * already enabled again for an instant restart, and logs nothing
+ */
+static inline bool IsLogged(Transaction *txn) {
+  return ENABLE_LOGGING && txn != nullptr;
+}
+
 /**
  * Header related
  */
@@ -14,9 +22,9 @@ void TablePage::Init(page_id_t page_id, size_t page_size,
                      page_id_t prev_page_id, LogManager *log_manager,
                      Transaction *txn) {
   memcpy(GetData(), &page_id, 4); // set page_id
-  if (ENABLE_LOGGING) {
+  if (IsLogged(txn)) {
     // TODO: add your logging logic here
-    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::NEWPAGE, prev_page_id);
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::NEWPAGE, prev_page_id, page_id);
     lsn_t cur_lsn = log_manager->AppendLogRecord(log_record);
     txn->SetPrevLSN(cur_lsn);
     SetLSN(cur_lsn);
@@ -63,7 +71,7 @@ bool TablePage::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn,
   for (i = 0; i < GetTupleCount(); ++i) {
     rid.Set(GetPageId(), i);
     if (GetTupleSize(i) == 0) { // empty slot
-      if (ENABLE_LOGGING) {
+      if (IsLogged(txn)) {
         assert(txn->GetSharedLockSet()->find(rid) ==
                    txn->GetSharedLockSet()->end() &&
                txn->GetExclusiveLockSet()->find(rid) ==
@@ -88,7 +96,7 @@ bool TablePage::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn,
     SetTupleCount(GetTupleCount() + 1);
   }
   // write the log after set rid
-  if (ENABLE_LOGGING) {
+  if (IsLogged(txn)) {
     // acquire the exclusive lock
     assert(lock_manager->LockExclusive(txn, rid.Get()));
     // TODO: add your logging logic here
@@ -111,7 +119,7 @@ bool TablePage::MarkDelete(const RID &rid, Transaction *txn,
                            LockManager *lock_manager, LogManager *log_manager) {
   int slot_num = rid.GetSlotNum();
   if (slot_num >= GetTupleCount()) {
-    if (ENABLE_LOGGING) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
@@ -119,13 +127,13 @@ bool TablePage::MarkDelete(const RID &rid, Transaction *txn,
 
   int32_t tuple_size = GetTupleSize(slot_num);
   if (tuple_size < 0) {
-    if (ENABLE_LOGGING) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
   }
 
-  if (ENABLE_LOGGING) {
+  if (IsLogged(txn)) {
     // acquire exclusive lock
     // if has shared lock
     if (txn->GetSharedLockSet()->find(rid) != txn->GetSharedLockSet()->end()) {
@@ -156,14 +164,14 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple &old_tuple,
                             LogManager *log_manager) {
   int slot_num = rid.GetSlotNum();
   if (slot_num >= GetTupleCount()) {
-    if (ENABLE_LOGGING) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
   }
   int32_t tuple_size = GetTupleSize(slot_num); // old tuple size
   if (tuple_size <= 0) {
-    if (ENABLE_LOGGING) {
+    if (IsLogged(txn)) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
@@ -184,7 +192,7 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple &old_tuple,
   old_tuple.rid_ = rid;
   old_tuple.allocated_ = true;
 
-  if (ENABLE_LOGGING) {
+  if (IsLogged(txn)) {
     // acquire exclusive lock
     // if has shared lock
     if (txn->GetSharedLockSet()->find(rid) != txn->GetSharedLockSet()->end()) {
@@ -217,7 +225,8 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple &old_tuple,
   for (int i = 0; i < GetTupleCount();
        ++i) { // update tuple offsets (including the updated one)
     int32_t tuple_offset_i = GetTupleOffset(i);
-    if (GetTupleSize(i) > 0 && tuple_offset_i < tuple_offset + tuple_size) {
+    // tuples marked deleted still take up their space
+    if (GetTupleSize(i) != 0 && tuple_offset_i < tuple_offset + tuple_size) {
       SetTupleOffset(i, tuple_offset_i + tuple_size - new_tuple.size_);
     }
   }
@@ -248,13 +257,13 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn,
   delete_tuple.rid_ = rid;
   delete_tuple.allocated_ = true;
 
-  if (ENABLE_LOGGING) {
+  if (IsLogged(txn)) {
     // must already grab the exclusive lock
     assert(txn->GetExclusiveLockSet()->find(rid) !=
            txn->GetExclusiveLockSet()->end());
     // TODO: add your logging logic here
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
-      LogRecordType::APPLYDELETE, rid.GetPageId(), rid, delete_tuple);
+      LogRecordType::APPLYDELETE, rid, delete_tuple);
     lsn_t cur_lsn = log_manager->AppendLogRecord(log_record);
     txn->SetPrevLSN(cur_lsn);
     SetLSN(cur_lsn);
@@ -284,14 +293,14 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn,
  */
 void TablePage::RollbackDelete(const RID &rid, Transaction *txn,
                                LogManager *log_manager) {
-  if (ENABLE_LOGGING) {
+  if (IsLogged(txn)) {
     // must have already grab the exclusive lock
     assert(txn->GetExclusiveLockSet()->find(rid) !=
            txn->GetExclusiveLockSet()->end());
 
     // TODO: add your logging logic here
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(),
-      LogRecordType::ROLLBACKDELETE, rid.GetPageId(), rid, Tuple());
+      LogRecordType::ROLLBACKDELETE, rid, Tuple());
     lsn_t cur_lsn = log_manager->AppendLogRecord(log_record);
     txn->SetPrevLSN(cur_lsn);
     SetLSN(cur_lsn);
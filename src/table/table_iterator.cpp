@@ -2,14 +2,26 @@
  * table_iterator.cpp
  */
 
+#include <algorithm>
 #include <cassert>
 
 #include "table/table_heap.h"
 
 namespace cmudb {
 
-TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
-    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
+TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn,
+                             AccessStrategy *strategy)
+    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn),
+      strategy_(strategy), readahead_page_id_(rid.GetPageId()),
+      readahead_pages_(0), readahead_max_window_(TABLE_READAHEAD_MAX_PAGES) {
+  if (strategy_ != nullptr) {
+    // the ring also holds the page the scan is on
+    readahead_max_window_ = std::max<size_t>(
+        1, std::min<size_t>(readahead_max_window_,
+                            strategy_->GetRingSize() - 1));
+  }
+  readahead_window_ =
+      std::min<size_t>(TABLE_READAHEAD_MIN_PAGES, readahead_max_window_);
   if (rid.GetPageId() != INVALID_PAGE_ID) {
     table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_);
   }
@@ -28,7 +40,7 @@ Tuple *TableIterator::operator->() {
 TableIterator &TableIterator::operator++() {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
   auto cur_page = static_cast<TablePage *>(
-      buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
+      buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId(), strategy_));
   cur_page->RLatch();
   assert(cur_page != nullptr); // all pages are pinned
 
@@ -36,12 +48,25 @@ TableIterator &TableIterator::operator++() {
   if (!cur_page->GetNextTupleRid(tuple_->rid_,
                                  next_tuple_rid)) { // end of this page
     while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
+      page_id_t next_page_id = cur_page->GetNextPageId();
       auto next_page = static_cast<TablePage *>(
-          buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
+          buffer_pool_manager->TryFetchPage(next_page_id));
+      if (next_page == nullptr) {
+        if (readahead_pages_ > 0) {
+          // the scan caught up with its read-ahead, read further ahead
+          readahead_window_ =
+              std::min<size_t>(2 * readahead_window_, readahead_max_window_);
+        }
+        next_page = static_cast<TablePage *>(
+            buffer_pool_manager->FetchPage(next_page_id, strategy_));
+      }
       cur_page->RUnlatch();
       buffer_pool_manager->UnpinPage(cur_page->GetPageId(), false);
       cur_page = next_page;
       cur_page->RLatch();
+      if (readahead_pages_ > 0) {
+        readahead_pages_--;
+      }
       if (cur_page->GetFirstTupleRid(next_tuple_rid))
         break;
     }
@@ -51,12 +76,47 @@ TableIterator &TableIterator::operator++() {
   if (*this != table_heap_->end()) {
     table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_);
   }
+  ReadAhead(cur_page);
   // release until copy the tuple
   cur_page->RUnlatch();
   buffer_pool_manager->UnpinPage(cur_page->GetPageId(), false);
   return *this;
 }
 
+/*
+ * Keep readahead_window_ pages after cur_page read ahead. The chain is
+ * followed through the pages already read ahead; if the last one is still
+ * being read, the walk resumes on a later call.
+ */
+void TableIterator::ReadAhead(TablePage *cur_page) {
+  BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
+  if (readahead_pages_ == 0) {
+    readahead_page_id_ = cur_page->GetPageId();
+  }
+  while (readahead_pages_ < readahead_window_) {
+    page_id_t next_page_id;
+    if (readahead_page_id_ == cur_page->GetPageId()) {
+      next_page_id = cur_page->GetNextPageId();
+    } else {
+      auto page = static_cast<TablePage *>(
+          buffer_pool_manager->TryFetchPage(readahead_page_id_));
+      if (page == nullptr) {
+        return;
+      }
+      page->RLatch();
+      next_page_id = page->GetNextPageId();
+      page->RUnlatch();
+      buffer_pool_manager->UnpinPage(readahead_page_id_, false, true);
+    }
+    if (next_page_id == INVALID_PAGE_ID) {
+      return;
+    }
+    buffer_pool_manager->PrefetchPage(next_page_id, strategy_);
+    readahead_page_id_ = next_page_id;
+    readahead_pages_++;
+  }
+}
+
 TableIterator TableIterator::operator++(int) {
   TableIterator clone(*this);
   ++(*this);
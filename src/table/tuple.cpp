@@ -136,4 +136,21 @@ void Tuple::DeserializeFrom(const char *storage) {
   this->allocated_ = true;
 }
 
+void Tuple::DeserializeView(const char *storage) {
+  if (allocated_)
+    delete[] data_;
+  size_ = *reinterpret_cast<const int32_t *>(storage);
+  data_ = const_cast<char *>(storage + sizeof(int32_t));
+  allocated_ = false;
+}
+
+void Tuple::Detach() {
+  if (allocated_ || data_ == nullptr)
+    return;
+  char *data = new char[size_];
+  memcpy(data, data_, size_);
+  data_ = data;
+  allocated_ = true;
+}
+
 } // namespace cmudb
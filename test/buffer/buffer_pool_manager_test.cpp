@@ -2,7 +2,16 @@
  * buffer_pool_manager_test.cpp
  */
 
+#include <atomic>
+#include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "gtest/gtest.h"
@@ -48,4 +57,482 @@ TEST(BufferPoolManagerTest, SampleTest) {
   remove("test.db");
 }
 
+TEST(BufferPoolManagerTest, ClockReplacerTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager bpm(10, disk_manager, nullptr, 1, ReplacerType::CLOCK);
+
+  auto page_zero = bpm.NewPage(temp_page_id);
+  ASSERT_NE(nullptr, page_zero);
+  strcpy(page_zero->GetData(), "Hello");
+  for (int i = 1; i < 10; ++i) {
+    EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+  }
+  EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+
+  // only the unpinned pages can be evicted
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(true, bpm.UnpinPage(i, true));
+  }
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+  }
+  EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+  EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+
+  // page zero was written back on eviction
+  page_zero = bpm.FetchPage(0);
+  ASSERT_NE(nullptr, page_zero);
+  EXPECT_EQ(0, strcmp(page_zero->GetData(), "Hello"));
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+TEST(BufferPoolManagerTest, PartitionedTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager bpm(10, disk_manager, nullptr, 2);
+  EXPECT_EQ(2, bpm.GetNumInstances());
+
+  // page ids alternate between the two partitions of five frames each
+  for (int i = 0; i < 10; ++i) {
+    auto page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i, temp_page_id);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", i);
+  }
+  EXPECT_EQ(0, bpm.GetFreeListSize());
+  EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+  // the full partition is found before a page id is allocated
+  EXPECT_EQ(0u, disk_manager->GetNumFreePages());
+  EXPECT_EQ(10, disk_manager->PeekNextPage());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(true, bpm.UnpinPage(i, true));
+  }
+
+  // readers hammer both partitions concurrently, evicting each other's pages
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < 4; ++tid) {
+    threads.push_back(std::thread([&bpm, tid] {
+      char expected[PAGE_SIZE];
+      for (int round = 0; round < 200; ++round) {
+        page_id_t page_id = (round * 7 + tid) % 10;
+        Page *page = bpm.FetchPage(page_id);
+        if (page == nullptr) {
+          continue;
+        }
+        snprintf(expected, PAGE_SIZE, "page %d", page_id);
+        EXPECT_EQ(0, strcmp(page->GetData(), expected));
+        EXPECT_EQ(true, bpm.UnpinPage(page_id, false));
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::map<page_id_t, int> pinned;
+  bpm.GetPinPages(pinned);
+  EXPECT_EQ(0, pinned.size());
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+TEST(BufferPoolManagerTest, ConcurrentHitTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager bpm(10, disk_manager);
+
+  // pages 0-3 are hot, pages 4-29 only pass through the pool
+  for (int i = 0; i < 30; ++i) {
+    auto page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+    EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+  }
+
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < 4; ++tid) {
+    threads.push_back(std::thread([&bpm, tid] {
+      char expected[PAGE_SIZE];
+      for (int round = 0; round < 2000; ++round) {
+        // readers only touch hot pages, one thread keeps evicting cold ones
+        page_id_t page_id = tid == 0 ? 4 + round % 26 : (round + tid) % 4;
+        Page *page = bpm.FetchPage(page_id);
+        if (page == nullptr) {
+          continue;
+        }
+        snprintf(expected, PAGE_SIZE, "page %d", page_id);
+        EXPECT_EQ(page_id, page->GetPageId());
+        EXPECT_EQ(0, strcmp(page->GetData(), expected));
+        EXPECT_EQ(true, bpm.UnpinPage(page_id, false));
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::map<page_id_t, int> pinned;
+  bpm.GetPinPages(pinned);
+  EXPECT_EQ(0, pinned.size());
+  EXPECT_EQ(false, bpm.UnpinPage(0, false));
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+TEST(BufferPoolManagerTest, PageCleanerTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager bpm(10, disk_manager);
+
+  for (int i = 0; i < 10; ++i) {
+    auto page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+  }
+  // pages 0-7 become dirty victim candidates, pages 8 and 9 stay pinned
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(true, bpm.UnpinPage(i, true));
+  }
+
+  bpm.RunPageCleaner(6, 1000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  bpm.StopPageCleaner();
+
+  // only the six pages at the eviction end were written
+  char data[PAGE_SIZE];
+  char expected[PAGE_SIZE];
+  for (int i = 0; i < 10; ++i) {
+    memset(data, 0, PAGE_SIZE);
+    disk_manager->ReadPage(i, data);
+    snprintf(expected, PAGE_SIZE, "page %d", i);
+    EXPECT_EQ(i < 6, strcmp(data, expected) == 0);
+  }
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+
+TEST(BufferPoolManagerTest, WriteBackTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager bpm(10, disk_manager);
+
+  auto page = bpm.NewPage(temp_page_id);
+  ASSERT_NE(nullptr, page);
+  strcpy(page->GetData(), "Hello");
+  EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+
+  // a clean unpin after a dirty one neither writes nor forgets the update
+  page = bpm.FetchPage(temp_page_id);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, false));
+  char data[PAGE_SIZE];
+  memset(data, 0, PAGE_SIZE);
+  disk_manager->ReadPage(temp_page_id, data);
+  EXPECT_NE(0, strcmp(data, "Hello"));
+
+  EXPECT_EQ(true, bpm.FlushPage(temp_page_id));
+  disk_manager->ReadPage(temp_page_id, data);
+  EXPECT_EQ(0, strcmp(data, "Hello"));
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+
+TEST(BufferPoolManagerTest, ReadAheadTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager bpm(10, disk_manager);
+
+  for (int i = 0; i < 20; ++i) {
+    auto page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+    EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+  }
+  // page 0 was evicted, so it cannot be pinned without I/O
+  EXPECT_EQ(nullptr, bpm.TryFetchPage(0));
+
+  bpm.PrefetchPage(0);
+  Page *page = nullptr;
+  for (int i = 0; i < 100 && page == nullptr; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    page = bpm.TryFetchPage(0);
+  }
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, strcmp(page->GetData(), "page 0"));
+
+  // a peek leaves the page as the preferred victim
+  EXPECT_EQ(true, bpm.UnpinPage(0, false, true));
+  ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+  EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, false));
+  EXPECT_EQ(nullptr, bpm.TryFetchPage(0));
+  page = bpm.TryFetchPage(19);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(true, bpm.UnpinPage(19, false));
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+
+TEST(BufferPoolManagerTest, AccessStrategyTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager bpm(10, disk_manager);
+
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+  }
+
+  // a scan over the evicted pages 0-9 cycles through its own ring, which
+  // only takes the frames of the least recently used pages 10 and 11
+  AccessStrategy strategy(&bpm);
+  EXPECT_EQ(2, strategy.GetRingSize());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_NE(nullptr, bpm.FetchPage(i, &strategy));
+    EXPECT_EQ(true, bpm.UnpinPage(i, false));
+  }
+  for (int i = 12; i < 20; ++i) {
+    EXPECT_NE(nullptr, bpm.TryFetchPage(i));
+    EXPECT_EQ(true, bpm.UnpinPage(i, false));
+  }
+
+  // without the strategy the same scan takes over the pool
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_NE(nullptr, bpm.FetchPage(i));
+    EXPECT_EQ(true, bpm.UnpinPage(i, false));
+  }
+  EXPECT_EQ(nullptr, bpm.TryFetchPage(12));
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+TEST(BufferPoolManagerTest, DirectIOTest) {
+  page_id_t temp_page_id;
+
+  // huge pages fall back to regular pages when none are reserved
+  DiskManager *disk_manager = new DiskManager("test.db", true);
+  BufferPoolManager bpm(10, disk_manager, nullptr, 1, ReplacerType::LRU, true);
+
+  for (int i = 0; i < 20; ++i) {
+    auto page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    // every frame is aligned for direct I/O
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(page->GetData()) % PAGE_SIZE);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+    EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+  }
+
+  // read back the evicted pages, synchronously and by read-ahead
+  char expected[PAGE_SIZE];
+  for (int i = 0; i < 10; ++i) {
+    if (i % 2 == 0) {
+      bpm.PrefetchPage(i);
+    }
+    auto page = bpm.FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    snprintf(expected, PAGE_SIZE, "page %d", i);
+    EXPECT_EQ(0, strcmp(page->GetData(), expected));
+    EXPECT_EQ(true, bpm.UnpinPage(i, false));
+  }
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+TEST(BufferPoolManagerTest, FlushPagesTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager bpm(16, disk_manager, nullptr, 4);
+
+  for (int i = 0; i < 12; ++i) {
+    auto page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+    // pinned pages are flushed as well
+    if (i != 5) {
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+  }
+  // a gap between two runs and a page that is not resident
+  EXPECT_EQ(true, bpm.FlushPages({9, 0, 1, 2, 5, 6, 7, 8, 100}));
+  char data[PAGE_SIZE];
+  char expected[PAGE_SIZE];
+  for (int i = 0; i < 12; ++i) {
+    memset(data, 0, PAGE_SIZE);
+    disk_manager->ReadPage(i, data);
+    snprintf(expected, PAGE_SIZE, "page %d", i);
+    bool flushed = i != 3 && i != 4 && i < 10;
+    EXPECT_EQ(flushed, strcmp(data, expected) == 0);
+  }
+
+  EXPECT_EQ(true, bpm.FlushAllPages());
+  for (int i = 0; i < 12; ++i) {
+    disk_manager->ReadPage(i, data);
+    snprintf(expected, PAGE_SIZE, "page %d", i);
+    EXPECT_EQ(0, strcmp(data, expected));
+  }
+  EXPECT_EQ(true, bpm.UnpinPage(5, false));
+  // every frame can still be evicted
+  for (int i = 0; i < 16; ++i) {
+    EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+  }
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+TEST(BufferPoolManagerTest, ChecksumTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(4, disk_manager);
+    for (int i = 0; i < 4; ++i) {
+      auto page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+    EXPECT_EQ(true, bpm.FlushAllPages());
+  }
+  // corrupt page 2 on disk
+  int fd = open("test.db", O_RDWR);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(1, pwrite(fd, "X", 1, 2 * PAGE_SIZE));
+  close(fd);
+
+  BufferPoolManager bpm(2, disk_manager);
+  // a failed read gives its frame back
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(nullptr, bpm.FetchPage(2));
+  }
+  auto page = bpm.FetchPage(1);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, strcmp(page->GetData(), "page 1"));
+  EXPECT_EQ(true, bpm.UnpinPage(1, false));
+
+  // so does a failed read-ahead, once the page is fetched
+  bpm.PrefetchPage(2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(nullptr, bpm.TryFetchPage(2));
+  EXPECT_EQ(nullptr, bpm.FetchPage(2));
+  ASSERT_NE(nullptr, bpm.FetchPage(0));
+  ASSERT_NE(nullptr, bpm.FetchPage(3));
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+/*
+ * A page whose write back fails stays dirty in its frame: eviction passes
+ * it over and FlushPage reports the failure until the disk takes the page
+ */
+TEST(BufferPoolManagerTest, WriteErrorTest) {
+  page_id_t temp_page_id;
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager bpm(1, disk_manager);
+  auto page = bpm.NewPage(temp_page_id);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, false));
+  page = bpm.NewPage(temp_page_id);
+  ASSERT_NE(nullptr, page);
+  page_id_t page_id = temp_page_id;
+  ASSERT_LT(0, page_id);
+  strcpy(page->GetData(), "dirty page");
+  EXPECT_EQ(true, bpm.UnpinPage(page_id, true));
+
+  // writes at or beyond page_id fail with EFBIG
+  struct rlimit old_limit;
+  ASSERT_EQ(0, getrlimit(RLIMIT_FSIZE, &old_limit));
+  struct rlimit limit = old_limit;
+  limit.rlim_cur = static_cast<rlim_t>(page_id) * PAGE_SIZE;
+  signal(SIGXFSZ, SIG_IGN);
+  ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &limit));
+  EXPECT_EQ(nullptr, bpm.FetchPage(0));
+  EXPECT_EQ(false, bpm.FlushPage(page_id));
+  ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &old_limit));
+  signal(SIGXFSZ, SIG_DFL);
+
+  page = bpm.FetchPage(page_id);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, strcmp(page->GetData(), "dirty page"));
+  EXPECT_EQ(true, bpm.UnpinPage(page_id, false));
+  EXPECT_EQ(true, bpm.FlushPage(page_id));
+  page = bpm.FetchPage(0);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(true, bpm.UnpinPage(0, false));
+  char data[PAGE_SIZE];
+  EXPECT_EQ(true, disk_manager->ReadPage(page_id, data));
+  EXPECT_EQ(0, strcmp(data, "dirty page"));
+
+  delete disk_manager;
+  remove("test.db");
+}
+
+/*
+ * Evicting a page whose log is not durable waits for the log flush without
+ * holding the instance latch
+ */
+TEST(BufferPoolManagerTest, LogWaitTest) {
+  page_id_t temp_page_id;
+  DiskManager *disk_manager = new DiskManager("test.db");
+  LogManager *log_manager = new LogManager(disk_manager);
+  BufferPoolManager bpm(2, disk_manager, log_manager);
+
+  lsn_t lsn = INVALID_LSN;
+  for (int i = 0; i < 4; ++i) {
+    LogRecord log_record(0, lsn, LogRecordType::BEGIN);
+    lsn = log_manager->AppendLogRecord(log_record);
+  }
+  // the flush thread is not running yet, so nothing becomes durable
+  ENABLE_LOGGING = true;
+  auto page = bpm.NewPage(temp_page_id);
+  ASSERT_NE(nullptr, page);
+  page->SetLSN(lsn);
+  EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+  page_id_t pinned_page_id;
+  ASSERT_NE(nullptr, bpm.NewPage(pinned_page_id));
+
+  std::atomic<bool> done(false);
+  std::thread evictor([&] {
+    page_id_t page_id;
+    EXPECT_NE(nullptr, bpm.NewPage(page_id));
+    done = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(done);
+  // the instance latch is free while the evictor waits
+  EXPECT_EQ(true, bpm.FlushPage(pinned_page_id));
+
+  log_manager->RunFlushThread();
+  evictor.join();
+  EXPECT_TRUE(done);
+  EXPECT_LE(lsn, log_manager->GetPersistentLSN());
+  log_manager->StopFlushThread();
+
+  delete log_manager;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
 } // namespace cmudb
@@ -0,0 +1,49 @@
+/**
+ * clock_replacer_test.cpp
+ */
+
+#include <cstdio>
+
+#include "buffer/clock_replacer.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(ClockReplacerTest, SampleTest) {
+  ClockReplacer<int> clock_replacer(1, 7);
+
+  // push element into replacer
+  clock_replacer.Insert(1);
+  clock_replacer.Insert(2);
+  clock_replacer.Insert(3);
+  clock_replacer.Insert(4);
+  clock_replacer.Insert(5);
+  clock_replacer.Insert(6);
+  clock_replacer.Insert(1);
+  EXPECT_EQ(6, clock_replacer.Size());
+
+  // the first sweep clears every reference bit, then victims follow the hand
+  int value;
+  clock_replacer.Victim(value);
+  EXPECT_EQ(1, value);
+  clock_replacer.Victim(value);
+  EXPECT_EQ(2, value);
+  clock_replacer.Victim(value);
+  EXPECT_EQ(3, value);
+
+  // remove element from replacer
+  EXPECT_EQ(false, clock_replacer.Erase(3));
+  EXPECT_EQ(true, clock_replacer.Erase(6));
+  EXPECT_EQ(2, clock_replacer.Size());
+
+  // a referenced frame gets a second chance
+  clock_replacer.Insert(4);
+  clock_replacer.Victim(value);
+  EXPECT_EQ(5, value);
+  clock_replacer.Victim(value);
+  EXPECT_EQ(4, value);
+  EXPECT_EQ(false, clock_replacer.Victim(value));
+  EXPECT_EQ(0, clock_replacer.Size());
+}
+
+} // namespace cmudb
@@ -0,0 +1,102 @@
+/**
+ * crc32c_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "common/config.h"
+#include "disk/crc32c.h"
+#include "disk/disk_manager.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(CRC32CTest, KnownValueTest) {
+  const char check[] = "123456789";
+  EXPECT_EQ(0xE3069283u, CRC32C::Compute(check, 9));
+  EXPECT_EQ(0xE3069283u, CRC32C::ComputePortable(check, 9));
+  EXPECT_EQ(0u, CRC32C::Compute(check, 0));
+  // 32 zero bytes, from RFC 3720
+  char zeros[32];
+  memset(zeros, 0, sizeof(zeros));
+  EXPECT_EQ(0x8A9136AAu, CRC32C::Compute(zeros, sizeof(zeros)));
+  // continuing a checksum equals checksumming the whole
+  EXPECT_EQ(CRC32C::Compute(check, 9),
+            CRC32C::Compute(check + 4, 5, CRC32C::Compute(check, 4)));
+}
+
+TEST(CRC32CTest, HardwareMatchesPortableTest) {
+  std::cout << "hardware CRC-32C: " << CRC32C::IsHardwareAccelerated()
+            << std::endl;
+  std::mt19937 gen(0);
+  std::vector<char> data(4 * 4096 + 7);
+  for (auto &c : data) {
+    c = gen();
+  }
+  // every alignment and sizes around the interleaved block size
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t size = 0; size < 1200; size += 1 + size / 16) {
+      EXPECT_EQ(CRC32C::ComputePortable(&data[offset], size),
+                CRC32C::Compute(&data[offset], size));
+    }
+  }
+  EXPECT_EQ(CRC32C::ComputePortable(data.data(), data.size()),
+            CRC32C::Compute(data.data(), data.size()));
+}
+
+/*
+ * Time to checksum a page against the time to write it and read it back
+ * through the disk manager, which checksums and verifies every page. The
+ * pages go to the device, with direct I/O or else a sync after each write,
+ * as they have to for a checksum to catch anything
+ */
+TEST(CRC32CTest, PageOverheadBenchmark) {
+  const int num_pages = 256;
+  const int rounds = 4;
+  DiskManager *disk_manager = new DiskManager("test.db", true);
+  alignas(4096) char data[PAGE_SIZE];
+  memset(data, 'c', PAGE_SIZE);
+
+  uint32_t crc = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 64 * rounds * num_pages; ++i) {
+    data[0] = i;
+    crc ^= CRC32C::Compute(data, PAGE_DATA_SIZE);
+  }
+  std::chrono::duration<double> checksum =
+      std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round) {
+    for (page_id_t page_id = 0; page_id < num_pages; ++page_id) {
+      EXPECT_EQ(true, disk_manager->WritePageInPlace(page_id, data));
+      if (!disk_manager->IsDirectIO()) {
+        disk_manager->SyncPages();
+      }
+    }
+    for (page_id_t page_id = 0; page_id < num_pages; ++page_id) {
+      EXPECT_EQ(true, disk_manager->ReadPage(page_id, data));
+    }
+  }
+  std::chrono::duration<double> io = std::chrono::steady_clock::now() - start;
+
+  // two checksums per page, one on write and one on read
+  double checksum_ns = checksum.count() * 1e9 / (64 * rounds * num_pages);
+  double io_ns = io.count() * 1e9 / (2 * rounds * num_pages);
+  std::cout << "direct I/O: " << disk_manager->IsDirectIO()
+            << ", checksum: " << checksum_ns << " ns/page, page I/O: " << io_ns
+            << " ns/page, overhead: " << 100 * checksum_ns / io_ns << "%"
+            << " (" << crc << ")" << std::endl;
+  EXPECT_LT(checksum_ns, 0.02 * io_ns);
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+} // namespace cmudb
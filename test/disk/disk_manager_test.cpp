@@ -0,0 +1,585 @@
+/**
+ * disk_manager_test.cpp
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "disk/async_io.h"
+#include "disk/disk_manager.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(DiskManagerTest, ReadWritePageTest) {
+  char buf[PAGE_SIZE];
+  char data[PAGE_SIZE];
+  DiskManager *disk_manager = new DiskManager("test.db");
+
+  // reading beyond the end of file yields a zeroed page
+  memset(buf, 1, PAGE_SIZE);
+  disk_manager->ReadPage(3, buf);
+  for (int i = 0; i < PAGE_SIZE; ++i) {
+    EXPECT_EQ(0, buf[i]);
+  }
+
+  std::strcpy(data, "A test string.");
+  disk_manager->WritePage(0, data);
+  disk_manager->WritePage(5, data);
+  disk_manager->ReadPage(0, buf);
+  EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+  disk_manager->ReadPage(5, buf);
+  EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(DiskManagerTest, ConcurrentReadWriteTest) {
+  const int num_threads = 8;
+  const int pages_per_thread = 64;
+  DiskManager *disk_manager = new DiskManager("test.db");
+
+  // every thread owns a disjoint set of pages
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.push_back(std::thread([disk_manager, tid] {
+      char data[PAGE_SIZE];
+      char buf[PAGE_SIZE];
+      for (int i = 0; i < pages_per_thread; ++i) {
+        page_id_t page_id = i * num_threads + tid;
+        memset(data, 0, PAGE_SIZE);
+        snprintf(data, PAGE_SIZE, "page %d", page_id);
+        disk_manager->WritePage(page_id, data);
+        disk_manager->ReadPage(page_id, buf);
+        EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  char expected[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+  for (page_id_t page_id = 0; page_id < num_threads * pages_per_thread;
+       ++page_id) {
+    memset(expected, 0, PAGE_SIZE);
+    snprintf(expected, PAGE_SIZE, "page %d", page_id);
+    disk_manager->ReadPage(page_id, buf);
+    EXPECT_EQ(0, memcmp(buf, expected, PAGE_DATA_SIZE));
+  }
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * Random page reads from a growing number of threads, reports pages read per
+ * second. With positional reads the throughput should grow with the number
+ * of threads instead of staying flat.
+ */
+TEST(DiskManagerTest, ConcurrentRandomReadBenchmark) {
+  const int num_pages = 4096;
+  const int reads_per_thread = 20000;
+  DiskManager *disk_manager = new DiskManager("test.db");
+
+  char data[PAGE_SIZE];
+  memset(data, 0, PAGE_SIZE);
+  for (page_id_t page_id = 0; page_id < num_pages; ++page_id) {
+    disk_manager->WritePage(page_id, data);
+  }
+
+  for (int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; ++tid) {
+      threads.push_back(std::thread([disk_manager, tid] {
+        std::mt19937 gen(tid);
+        std::uniform_int_distribution<page_id_t> dist(0, num_pages - 1);
+        char buf[PAGE_SIZE];
+        for (int i = 0; i < reads_per_thread; ++i) {
+          disk_manager->ReadPage(dist(gen), buf);
+        }
+      }));
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << num_threads << " threads: "
+              << static_cast<long>(num_threads * reads_per_thread /
+                                   elapsed.count())
+              << " pages/s" << std::endl;
+  }
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(DiskManagerTest, AsyncReadWriteTest) {
+  const int num_pages = 128;
+  DiskManager *disk_manager = new DiskManager("test.db");
+
+  std::vector<char> data(num_pages * PAGE_SIZE);
+  std::vector<char> buf(num_pages * PAGE_SIZE);
+  for (int i = 0; i < num_pages; ++i) {
+    snprintf(&data[i * PAGE_SIZE], PAGE_SIZE, "page %d", i);
+  }
+
+  std::mutex latch;
+  std::condition_variable cv;
+  int pending = num_pages;
+  int failed = 0;
+  auto done = [&](bool ok) {
+    std::lock_guard<std::mutex> guard(latch);
+    failed += ok ? 0 : 1;
+    if (--pending == 0) {
+      cv.notify_one();
+    }
+  };
+
+  // all writes are submitted before any of them is waited for
+  for (int i = 0; i < num_pages; ++i) {
+    disk_manager->WritePageAsync(i, &data[i * PAGE_SIZE], done);
+  }
+  {
+    std::unique_lock<std::mutex> lock(latch);
+    cv.wait(lock, [&] { return pending == 0; });
+  }
+
+  pending = num_pages + 1;
+  for (int i = 0; i < num_pages; ++i) {
+    disk_manager->ReadPageAsync(i, &buf[i * PAGE_SIZE], done);
+  }
+  // beyond the end of file
+  char page[PAGE_SIZE];
+  memset(page, 1, PAGE_SIZE);
+  disk_manager->ReadPageAsync(num_pages + 10, page, done);
+  {
+    std::unique_lock<std::mutex> lock(latch);
+    cv.wait(lock, [&] { return pending == 0; });
+  }
+  EXPECT_EQ(0, failed);
+  for (int i = 0; i < num_pages; ++i) {
+    EXPECT_EQ(0, memcmp(&data[i * PAGE_SIZE], &buf[i * PAGE_SIZE],
+                        PAGE_DATA_SIZE));
+  }
+  for (int i = 0; i < PAGE_SIZE; ++i) {
+    EXPECT_EQ(0, page[i]);
+  }
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(DiskManagerTest, ThreadPoolAsyncIOTest) {
+  int fd = open("test.db", O_RDWR | O_CREAT, 0644);
+  ASSERT_GE(fd, 0);
+  char data[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+  memset(data, 'x', PAGE_SIZE);
+
+  std::mutex latch;
+  std::condition_variable cv;
+  ssize_t result = 0;
+  bool done = false;
+  auto callback = [&](ssize_t ret) {
+    std::lock_guard<std::mutex> guard(latch);
+    result = ret;
+    done = true;
+    cv.notify_one();
+  };
+  auto wait = [&] {
+    std::unique_lock<std::mutex> lock(latch);
+    cv.wait(lock, [&] { return done; });
+    done = false;
+  };
+
+  // the destructor drains requests still in flight
+  AsyncIO *async_io = new ThreadPoolAsyncIO(2, 2);
+  async_io->SubmitWrite(fd, data, PAGE_SIZE, PAGE_SIZE, callback);
+  wait();
+  EXPECT_EQ(PAGE_SIZE, result);
+  async_io->SubmitRead(fd, buf, PAGE_SIZE, PAGE_SIZE, callback);
+  wait();
+  EXPECT_EQ(PAGE_SIZE, result);
+  EXPECT_EQ(0, memcmp(data, buf, PAGE_DATA_SIZE));
+  async_io->SubmitRead(-1, buf, PAGE_SIZE, 0, callback);
+  delete async_io;
+  EXPECT_EQ(-EBADF, result);
+
+  close(fd);
+  remove("test.db");
+}
+
+TEST(DiskManagerTest, DirectIOTest) {
+  DiskManager *disk_manager = new DiskManager("test.db", true);
+  alignas(4096) char aligned[PAGE_SIZE];
+  char buf[PAGE_SIZE + 1];
+  // deliberately misaligned, goes through a bounce buffer
+  char *unaligned = buf + 1;
+
+  memset(aligned, 'a', PAGE_SIZE);
+  disk_manager->WritePage(0, aligned);
+  memset(unaligned, 'u', PAGE_SIZE);
+  disk_manager->WritePage(1, unaligned);
+
+  char data[PAGE_SIZE];
+  memset(data, 'a', PAGE_SIZE);
+  disk_manager->ReadPage(0, unaligned);
+  EXPECT_EQ(0, memcmp(data, unaligned, PAGE_DATA_SIZE));
+  memset(data, 'u', PAGE_SIZE);
+  disk_manager->ReadPage(1, aligned);
+  EXPECT_EQ(0, memcmp(data, aligned, PAGE_DATA_SIZE));
+
+  // beyond the end of file
+  disk_manager->ReadPage(5, aligned);
+  for (int i = 0; i < PAGE_SIZE; ++i) {
+    EXPECT_EQ(0, aligned[i]);
+  }
+
+  delete disk_manager;
+
+  // a buffered disk manager sees the pages written with direct I/O
+  disk_manager = new DiskManager("test.db");
+  disk_manager->ReadPage(1, data);
+  EXPECT_EQ('u', data[PAGE_DATA_SIZE - 1]);
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(DiskManagerTest, FreePageMapTest) {
+  char data[PAGE_SIZE];
+  memset(data, 0, PAGE_SIZE);
+  DiskManager *disk_manager = new DiskManager("test.db");
+  for (page_id_t page_id = 0; page_id < 10; ++page_id) {
+    EXPECT_EQ(page_id, disk_manager->AllocatePage());
+  }
+  disk_manager->WritePage(9, data);
+
+  // freed pages are reused lowest first, before the file grows
+  disk_manager->DeallocatePage(7);
+  disk_manager->DeallocatePage(3);
+  disk_manager->DeallocatePage(3);
+  EXPECT_EQ(2u, disk_manager->GetNumFreePages());
+  // changes of the map are synced together, and only if there are any
+  EXPECT_EQ(0u,
+            disk_manager->GetIOStats().GetSnapshot().Get(IOType::SYNC).count_);
+  EXPECT_EQ(true, disk_manager->SyncFreePageMap());
+  EXPECT_EQ(true, disk_manager->SyncFreePageMap());
+  EXPECT_EQ(1u,
+            disk_manager->GetIOStats().GetSnapshot().Get(IOType::SYNC).count_);
+  EXPECT_EQ(3, disk_manager->AllocatePage());
+  EXPECT_EQ(7, disk_manager->AllocatePage());
+  EXPECT_EQ(10, disk_manager->AllocatePage());
+
+  disk_manager->DeallocatePage(5);
+  disk_manager->DeallocatePage(10);
+  delete disk_manager;
+
+  // page 10 was never written, so after a restart it is simply beyond the
+  // end of file
+  disk_manager = new DiskManager("test.db");
+  EXPECT_EQ(1u, disk_manager->GetNumFreePages());
+  EXPECT_EQ(5, disk_manager->AllocatePage());
+  EXPECT_EQ(10, disk_manager->AllocatePage());
+  // recovery recreating a page beyond the end of file
+  disk_manager->ReservePage(20);
+  EXPECT_EQ(21, disk_manager->AllocatePage());
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(DiskManagerTest, WritePagesTest) {
+  // more pages than one write batch takes
+  const int num_pages = 1100;
+  for (bool direct_io : {false, true}) {
+    DiskManager *disk_manager = new DiskManager("test.db", direct_io);
+    char *data = static_cast<char *>(aligned_alloc(4096, num_pages * PAGE_SIZE));
+    std::vector<const char *> pages;
+    for (int i = 0; i < num_pages; ++i) {
+      memset(data + i * PAGE_SIZE, 0, PAGE_SIZE);
+      snprintf(data + i * PAGE_SIZE, PAGE_SIZE, "page %d", i);
+      pages.push_back(data + i * PAGE_SIZE);
+    }
+    EXPECT_EQ(true, disk_manager->WritePages(3, pages));
+    EXPECT_EQ(true, disk_manager->SyncPages());
+
+    char buf[PAGE_SIZE];
+    for (int i = 0; i < num_pages; ++i) {
+      disk_manager->ReadPage(3 + i, buf);
+      EXPECT_EQ(0, memcmp(data + i * PAGE_SIZE, buf, PAGE_DATA_SIZE));
+    }
+
+    free(data);
+    delete disk_manager;
+    remove("test.db");
+    remove("test.log");
+  }
+}
+
+TEST(DiskManagerTest, ChecksumTest) {
+  char data[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+  DiskManager *disk_manager = new DiskManager("test.db");
+  memset(data, 0, PAGE_SIZE);
+  strcpy(data, "A test string.");
+  disk_manager->WritePage(0, data);
+  disk_manager->WritePage(1, data);
+  EXPECT_EQ(true, disk_manager->ReadPage(1, buf));
+  // a never written page has no checksum to verify
+  EXPECT_EQ(true, disk_manager->ReadPage(5, buf));
+
+  // flip one bit of page 1 behind the disk manager's back
+  int fd = open("test.db", O_RDWR);
+  ASSERT_LE(0, fd);
+  char byte;
+  ASSERT_EQ(1, pread(fd, &byte, 1, PAGE_SIZE + 100));
+  byte ^= 0x10;
+  ASSERT_EQ(1, pwrite(fd, &byte, 1, PAGE_SIZE + 100));
+  close(fd);
+  EXPECT_EQ(true, disk_manager->ReadPage(0, buf));
+  EXPECT_EQ(false, disk_manager->ReadPage(1, buf));
+
+  std::mutex latch;
+  std::condition_variable cv;
+  int result = -1;
+  disk_manager->ReadPageAsync(1, buf, [&](bool ok) {
+    std::lock_guard<std::mutex> guard(latch);
+    result = ok;
+    cv.notify_all();
+  });
+  {
+    std::unique_lock<std::mutex> lock(latch);
+    cv.wait(lock, [&] { return result != -1; });
+  }
+  EXPECT_EQ(0, result);
+
+  // a zeroed checksum does not make a written page pass
+  uint32_t zero = 0;
+  fd = open("test.db", O_RDWR);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(zero)),
+            pwrite(fd, &zero, sizeof(zero), PAGE_DATA_SIZE));
+  close(fd);
+  EXPECT_EQ(false, disk_manager->ReadPage(0, buf));
+
+  // rewriting the page repairs it
+  disk_manager->WritePage(1, data);
+  EXPECT_EQ(true, disk_manager->ReadPage(1, buf));
+  EXPECT_EQ(0, memcmp(data, buf, PAGE_DATA_SIZE));
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(DiskManagerTest, CompressionTest) {
+  const int num_pages = 64;
+  DiskManager *disk_manager = new DiskManager("test.db", false, true);
+  CompressedPageStore *store = disk_manager->GetCompressedPageStore();
+  ASSERT_NE(nullptr, store);
+
+  // repetitive tuples at the end of otherwise empty pages
+  char data[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+  for (int i = 0; i < num_pages; ++i) {
+    memset(data, 0, PAGE_SIZE);
+    for (int j = 0; j < 4; ++j) {
+      snprintf(data + PAGE_SIZE - 32 * (j + 1), 32, "tuple %d of page %d", j, i);
+    }
+    EXPECT_EQ(i, disk_manager->AllocatePage());
+    disk_manager->WritePage(i, data);
+  }
+  EXPECT_LT(store->GetFileSize(), num_pages * PAGE_SIZE / 2u);
+
+  // an incompressible page moves to a larger extent
+  std::mt19937 gen(0);
+  for (int i = 0; i < PAGE_SIZE; ++i) {
+    data[i] = gen();
+  }
+  disk_manager->WritePage(3, data);
+  disk_manager->ReadPage(3, buf);
+  EXPECT_EQ(0, memcmp(data, buf, PAGE_DATA_SIZE));
+  disk_manager->DeallocatePage(7);
+  // never written pages read as zeros
+  disk_manager->ReadPage(num_pages + 1, buf);
+  EXPECT_EQ(0, buf[0]);
+  delete disk_manager;
+
+  // reopening keeps the database compressed, even without asking for it
+  disk_manager = new DiskManager("test.db");
+  ASSERT_NE(nullptr, disk_manager->GetCompressedPageStore());
+  disk_manager->ReadPage(3, buf);
+  EXPECT_EQ(0, memcmp(data, buf, PAGE_DATA_SIZE));
+  char expected[32];
+  for (int i = 0; i < num_pages; ++i) {
+    if (i == 3 || i == 7) {
+      continue;
+    }
+    disk_manager->ReadPage(i, buf);
+    snprintf(expected, sizeof(expected), "tuple 0 of page %d", i);
+    EXPECT_EQ(0, strcmp(buf + PAGE_SIZE - 32, expected));
+  }
+  // the freed page is reused
+  EXPECT_EQ(7, disk_manager->AllocatePage());
+  EXPECT_EQ(num_pages, disk_manager->AllocatePage());
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+  remove("test.map");
+}
+
+/*
+ * The log spans preallocated segments, the end of the log is found again
+ * on open, and truncated segments are recycled instead of growing the log
+ */
+TEST(DiskManagerTest, LogSegmentTest) {
+  const int segment_size = 4096;
+  const int record_size = 100;
+  const int records_per_write = 10;
+  DiskManager *disk_manager = new DiskManager("test.db", false, false,
+                                              segment_size);
+  EXPECT_EQ(0, disk_manager->GetLogSize());
+
+  // records start with their size like log records, the rest tells them
+  // apart
+  char buffers[2][records_per_write * record_size];
+  int num_records = 0;
+  auto append = [&](int num_writes) {
+    for (int i = 0; i < num_writes; ++i) {
+      char *buffer = buffers[num_records / records_per_write % 2];
+      for (int j = 0; j < records_per_write; ++j, ++num_records) {
+        char *record = buffer + j * record_size;
+        memset(record, num_records % 128, record_size);
+        memcpy(record, &record_size, sizeof(int32_t));
+      }
+      disk_manager->WriteLog(buffer, sizeof(buffers[0]));
+    }
+  };
+  auto check = [&](int record) {
+    char buf[record_size];
+    if (!disk_manager->ReadLog(buf, record_size, record * record_size)) {
+      return false;
+    }
+    int32_t size;
+    memcpy(&size, buf, sizeof(int32_t));
+    EXPECT_EQ(record_size, size);
+    EXPECT_EQ(record % 128, buf[record_size - 1]);
+    return true;
+  };
+  auto file_size = [](const char *name) {
+    struct stat stat_buf;
+    return stat(name, &stat_buf) == 0 ? stat_buf.st_size : -1;
+  };
+
+  append(10);
+  EXPECT_EQ(10000, disk_manager->GetLogSize());
+  // full size segments, record 40 crosses into the second one
+  EXPECT_EQ(segment_size, file_size("test.log.0"));
+  EXPECT_EQ(segment_size, file_size("test.log.1"));
+  EXPECT_EQ(segment_size, file_size("test.log.2"));
+  EXPECT_EQ(-1, file_size("test.log.3"));
+  EXPECT_TRUE(check(40));
+  EXPECT_TRUE(check(99));
+  EXPECT_FALSE(check(100));
+
+  delete disk_manager;
+  disk_manager = new DiskManager("test.db", false, false, segment_size);
+  EXPECT_EQ(10000, disk_manager->GetLogSize());
+  EXPECT_TRUE(check(0));
+
+  // segment 0 becomes the spare segment 3
+  disk_manager->TruncateLog(50 * record_size);
+  EXPECT_FALSE(check(0));
+  EXPECT_TRUE(check(50));
+  EXPECT_EQ(-1, file_size("test.log.0"));
+  EXPECT_EQ(segment_size, file_size("test.log.3"));
+  append(5);
+  for (int record = 41; record < num_records; ++record) {
+    EXPECT_TRUE(check(record));
+  }
+  EXPECT_EQ(-1, file_size("test.log.4"));
+
+  // the end of the log is found from the truncation point
+  delete disk_manager;
+  disk_manager = new DiskManager("test.db", false, false, segment_size);
+  EXPECT_EQ(num_records * record_size, disk_manager->GetLogSize());
+  EXPECT_TRUE(check(50));
+  EXPECT_TRUE(check(num_records - 1));
+  EXPECT_FALSE(check(num_records));
+  append(1);
+  EXPECT_TRUE(check(num_records - 1));
+
+  // without the control file the log starts over
+  delete disk_manager;
+  remove("test.log");
+  disk_manager = new DiskManager("test.db", false, false, segment_size);
+  EXPECT_EQ(0, disk_manager->GetLogSize());
+  EXPECT_EQ(-1, file_size("test.log.1"));
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * A log write that fails appends nothing, so it leaves no hole that would
+ * hide the records written after it, and the same buffer can be written
+ * again
+ */
+TEST(DiskManagerTest, LogWriteErrorTest) {
+  const int segment_size = 4096;
+  const int32_t record_size = 3000;
+  DiskManager *disk_manager = new DiskManager("test.db", false, false,
+                                              segment_size);
+  // the second segment cannot be created
+  ASSERT_EQ(0, mkdir("test.log.1", 0755));
+
+  char buffers[2][record_size];
+  for (auto &buffer : buffers) {
+    memset(buffer, 1, record_size);
+    memcpy(buffer, &record_size, sizeof(int32_t));
+  }
+  EXPECT_TRUE(disk_manager->WriteLog(buffers[0], record_size));
+  EXPECT_FALSE(disk_manager->WriteLog(buffers[1], record_size));
+  EXPECT_EQ(record_size, disk_manager->GetLogSize());
+
+  rmdir("test.log.1");
+  EXPECT_TRUE(disk_manager->WriteLog(buffers[1], record_size));
+  EXPECT_EQ(2 * record_size, disk_manager->GetLogSize());
+  delete disk_manager;
+  disk_manager = new DiskManager("test.db", false, false, segment_size);
+  EXPECT_EQ(2 * record_size, disk_manager->GetLogSize());
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  remove("test.log.0");
+  remove("test.log.1");
+}
+
+} // namespace cmudb
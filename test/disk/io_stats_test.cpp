@@ -0,0 +1,101 @@
+/**
+ * io_stats_test.cpp
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "disk/disk_manager.h"
+#include "disk/io_stats.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(IOStatsTest, HistogramTest) {
+  IOStats stats;
+  // requests land in the buckets of their latencies
+  stats.RecordLatency(IOType::PAGE_READ, 100, 0);
+  stats.RecordLatency(IOType::PAGE_READ, 100, 3000);
+  stats.RecordLatency(IOType::PAGE_READ, 100, 3000);
+  stats.RecordLatency(IOType::PAGE_READ, 100, 1000000);
+  stats.RecordLatency(IOType::SYNC, 0, 1000000000000ull);
+
+  IOStatsSnapshot snapshot = stats.GetSnapshot();
+  const IOStatsSnapshot::Counters &reads = snapshot.Get(IOType::PAGE_READ);
+  EXPECT_EQ(4u, reads.count_);
+  EXPECT_EQ(400u, reads.bytes_);
+  // 3us is in [2us, 4us), 1ms in [512us, 1024us)
+  EXPECT_EQ(1u, reads.histogram_[0]);
+  EXPECT_EQ(2u, reads.histogram_[2]);
+  EXPECT_EQ(1u, reads.histogram_[10]);
+  EXPECT_EQ(4u, reads.GetPercentileLatency(0.5));
+  EXPECT_EQ(1024u, reads.GetPercentileLatency(1));
+  EXPECT_DOUBLE_EQ(251.5, reads.GetMeanLatency());
+  // anything slower than the histogram covers goes to the last bucket
+  EXPECT_EQ(1u, snapshot.Get(IOType::SYNC).histogram_[IO_STATS_BUCKETS - 1]);
+  EXPECT_EQ(0u, snapshot.Get(IOType::PAGE_WRITE).count_);
+  EXPECT_EQ(0u, snapshot.Get(IOType::PAGE_WRITE).GetPercentileLatency(0.5));
+
+  stats.RecordLatency(IOType::PAGE_READ, 50, 0);
+  IOStatsSnapshot delta = stats.GetSnapshot() - snapshot;
+  EXPECT_EQ(1u, delta.Get(IOType::PAGE_READ).count_);
+  EXPECT_EQ(50u, delta.Get(IOType::PAGE_READ).bytes_);
+  EXPECT_EQ(0u, delta.Get(IOType::SYNC).count_);
+
+  stats.Reset();
+  EXPECT_EQ(0u, stats.GetSnapshot().Get(IOType::PAGE_READ).count_);
+}
+
+TEST(IOStatsTest, ConcurrentRecordTest) {
+  const int num_threads = 8;
+  const int records_per_thread = 100000;
+  IOStats stats;
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.push_back(std::thread([&stats] {
+      for (int i = 0; i < records_per_thread; ++i) {
+        stats.Record(IOType::LOG_WRITE, 10, IOStats::Now());
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const IOStatsSnapshot::Counters &writes =
+      stats.GetSnapshot().Get(IOType::LOG_WRITE);
+  EXPECT_EQ(num_threads * records_per_thread, writes.count_);
+  EXPECT_EQ(10u * num_threads * records_per_thread, writes.bytes_);
+}
+
+TEST(IOStatsTest, DiskManagerTest) {
+  DiskManager *disk_manager = new DiskManager("test.db");
+  char data[PAGE_SIZE];
+  memset(data, 0, PAGE_SIZE);
+  for (page_id_t page_id = 0; page_id < 8; ++page_id) {
+    disk_manager->WritePage(page_id, data);
+  }
+  disk_manager->WritePages(8, {data, data, data});
+  for (page_id_t page_id = 0; page_id < 4; ++page_id) {
+    disk_manager->ReadPage(page_id, data);
+  }
+  disk_manager->SyncPages();
+  char log_buffer[64];
+  disk_manager->WriteLog(log_buffer, sizeof(log_buffer));
+
+  IOStatsSnapshot snapshot = disk_manager->GetIOStats().GetSnapshot();
+  EXPECT_EQ(9u, snapshot.Get(IOType::PAGE_WRITE).count_);
+  EXPECT_EQ(11u * PAGE_SIZE, snapshot.Get(IOType::PAGE_WRITE).bytes_);
+  EXPECT_EQ(4u, snapshot.Get(IOType::PAGE_READ).count_);
+  EXPECT_EQ(4u * PAGE_SIZE, snapshot.Get(IOType::PAGE_READ).bytes_);
+  EXPECT_EQ(1u, snapshot.Get(IOType::SYNC).count_);
+  EXPECT_EQ(1u, snapshot.Get(IOType::LOG_WRITE).count_);
+  EXPECT_EQ(64u, snapshot.Get(IOType::LOG_WRITE).bytes_);
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+} // namespace cmudb
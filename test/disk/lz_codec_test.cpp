@@ -0,0 +1,74 @@
+/**
+ * lz_codec_test.cpp
+ */
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "disk/lz_codec.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+static void RoundTrip(const std::vector<char> &input, size_t capacity,
+                      bool expect_fit) {
+  std::vector<char> compressed(capacity);
+  size_t size = LZCodec::Compress(input.data(), input.size(),
+                                  compressed.data(), capacity);
+  ASSERT_EQ(expect_fit, size != 0);
+  if (size == 0) {
+    return;
+  }
+  std::vector<char> output(input.size());
+  EXPECT_EQ(true, LZCodec::Decompress(compressed.data(), size, output.data(),
+                                      output.size()));
+  EXPECT_EQ(input, output);
+}
+
+TEST(LZCodecTest, RoundTripTest) {
+  // a page that is mostly free space
+  std::vector<char> page(PAGE_SIZE, 0);
+  strcpy(&page[PAGE_SIZE - 40], "a tuple, another tuple, a third tuple");
+  RoundTrip(page, PAGE_SIZE / 4, true);
+
+  // long literal runs and long, overlapping matches
+  std::vector<char> text;
+  std::mt19937 gen(0);
+  for (int i = 0; i < 300; ++i) {
+    text.push_back('a' + gen() % 26);
+  }
+  text.insert(text.end(), 1000, 'x');
+  text.insert(text.end(), text.begin(), text.begin() + 300);
+  RoundTrip(text, text.size(), true);
+
+  // random data does not compress
+  std::vector<char> noise(PAGE_SIZE);
+  for (auto &c : noise) {
+    c = gen();
+  }
+  RoundTrip(noise, PAGE_SIZE, false);
+  RoundTrip(noise, 2 * PAGE_SIZE, true);
+
+  std::vector<char> tiny(3, 'z');
+  RoundTrip(tiny, 16, true);
+}
+
+TEST(LZCodecTest, MalformedInputTest) {
+  std::vector<char> page(PAGE_SIZE, 'p');
+  char compressed[PAGE_SIZE];
+  size_t size = LZCodec::Compress(page.data(), page.size(), compressed,
+                                  sizeof(compressed));
+  ASSERT_NE(0u, size);
+  char output[PAGE_SIZE];
+  // truncated input and wrong output size
+  EXPECT_EQ(false, LZCodec::Decompress(compressed, 3, output, PAGE_SIZE));
+  EXPECT_EQ(false, LZCodec::Decompress(compressed, size, output, PAGE_SIZE - 1));
+  // a match reaching before the start of the output
+  const char bad[] = {0x10, 'a', 0x05, 0x00};
+  EXPECT_EQ(false, LZCodec::Decompress(bad, sizeof(bad), output, 5));
+}
+
+} // namespace cmudb
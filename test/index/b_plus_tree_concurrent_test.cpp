@@ -153,6 +153,7 @@ TEST(BPlusTreeConcurrentTest, InsertTest1) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 
 TEST(BPlusTreeConcurrentTest, InsertTest2) {
@@ -207,6 +208,7 @@ TEST(BPlusTreeConcurrentTest, InsertTest2) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 
 TEST(BPlusTreeConcurrentTest, DeleteTest1) {
@@ -253,6 +255,7 @@ TEST(BPlusTreeConcurrentTest, DeleteTest1) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 
 TEST(BPlusTreeConcurrentTest, DeleteTest2) {
@@ -299,6 +302,7 @@ TEST(BPlusTreeConcurrentTest, DeleteTest2) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 
 TEST(BPlusTreeConcurrentTest, MixTest) {
@@ -346,6 +350,7 @@ TEST(BPlusTreeConcurrentTest, MixTest) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 
 } // namespace cmudb
@@ -143,5 +143,6 @@ TEST(BptTreeTest, UnitTest) {
   delete disk_manager;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 } // namespace cmudb
@@ -76,6 +76,7 @@ TEST(BPlusTreeTests, InsertTest1) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
   LOG_DEBUG("InsertTest1 finished===============");
 }
 
@@ -152,6 +153,7 @@ TEST(BPlusTreeTests, InsertTest2) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
   LOG_DEBUG("InsertTest2 finished===============");
 }
 
@@ -235,6 +237,7 @@ TEST(BPlusTreeTests, DeleteTest1) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
   LOG_DEBUG("DeleteTest1 finished===============");
 }
 
@@ -317,6 +320,7 @@ TEST(BPlusTreeTests, DeleteTest2) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 
 TEST(BPlusTreeTests, ScaleTest) {
@@ -401,5 +405,6 @@ TEST(BPlusTreeTests, ScaleTest) {
   delete bpm;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 } // namespace cmudb
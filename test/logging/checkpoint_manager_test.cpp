@@ -0,0 +1,365 @@
+/**
+ * checkpoint_manager_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logging/common.h"
+#include "logging/log_recovery.h"
+#include "vtable/virtual_table.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+static void CopyFile(const std::string &from, const std::string &to) {
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  out << in.rdbuf();
+}
+
+// the log control file and the segments a checkpoint left of it
+static void CopyLog(const std::string &from, const std::string &to) {
+  const int MAX_SEGMENTS = 16;
+  CopyFile(from, to);
+  for (int segment = 0; segment < MAX_SEGMENTS; ++segment) {
+    std::string name = from + "." + std::to_string(segment);
+    if (std::ifstream(name).good()) {
+      CopyFile(name, to + "." + std::to_string(segment));
+    }
+  }
+}
+
+static void RemoveLog(const std::string &name) {
+  const int MAX_SEGMENTS = 16;
+  remove(name.c_str());
+  for (int segment = 0; segment < MAX_SEGMENTS; ++segment) {
+    remove((name + "." + std::to_string(segment)).c_str());
+  }
+}
+
+/*
+ * Recovery starts at the checkpoint's redo offset instead of the beginning
+ * of the log, and still redoes the winners and undoes a loser that was
+ * active across the checkpoint
+ */
+TEST(CheckpointManagerTest, FuzzyCheckpointTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = storage_engine->transaction_manager_;
+
+  Transaction *txn = txn_manager->Begin();
+  TableHeap *test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                                        storage_engine->lock_manager_,
+                                        storage_engine->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  txn_manager->Commit(txn);
+  delete txn;
+
+  Schema *schema = ParseCreateStatement("a varchar, b bigint");
+  Tuple tuple = ConstructTuple(schema);
+  std::vector<RID> old_rids(5);
+  txn = txn_manager->Begin();
+  for (auto &rid : old_rids) {
+    EXPECT_TRUE(test_table->InsertTuple(tuple, rid, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  EXPECT_TRUE(storage_engine->buffer_pool_manager_->FlushAllPages());
+
+  // the loser changes a page before and after the checkpoint
+  RID loser_rids[2];
+  Transaction *loser = txn_manager->Begin();
+  EXPECT_TRUE(test_table->InsertTuple(tuple, loser_rids[0], loser));
+  lsn_t checkpoint_lsn = storage_engine->checkpoint_manager_->Checkpoint();
+  EXPECT_NE(INVALID_LSN, checkpoint_lsn);
+  lsn_t master_lsn;
+  int master_offset;
+  EXPECT_TRUE(storage_engine->disk_manager_->ReadMasterRecord(master_lsn,
+                                                              master_offset));
+  EXPECT_EQ(checkpoint_lsn, master_lsn);
+  EXPECT_LT(0, master_offset);
+
+  RID new_rid;
+  txn = txn_manager->Begin();
+  EXPECT_TRUE(test_table->InsertTuple(tuple, new_rid, txn));
+  txn_manager->Commit(txn);
+  delete txn;
+  EXPECT_TRUE(test_table->InsertTuple(tuple, loser_rids[1], loser));
+  storage_engine->log_manager_->WaitLogIntoDisk(loser->GetPrevLSN(), true);
+
+  // crash: the pages changed since the flush above are lost
+  CopyFile("test.db", "crash.db");
+  CopyFile("test.log", "crash.log");
+  CopyFile("test.log.0", "crash.log.0");
+  CopyFile("test.master", "crash.master");
+  txn_manager->Abort(loser);
+  delete loser;
+  delete test_table;
+  delete storage_engine;
+
+  storage_engine = new StorageEngine("crash.db");
+  LogRecovery *log_recovery = new LogRecovery(
+      storage_engine->disk_manager_, storage_engine->buffer_pool_manager_);
+  log_recovery->Redo();
+  // the records of the transactions that finished before the loser began
+  // are not read again
+  EXPECT_LT(0, log_recovery->GetRedoOffset());
+  EXPECT_GE(master_offset, log_recovery->GetRedoOffset());
+  log_recovery->Undo();
+
+  txn = storage_engine->transaction_manager_->Begin();
+  test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                             storage_engine->lock_manager_,
+                             storage_engine->log_manager_, first_page_id);
+  Tuple result;
+  for (auto &rid : old_rids) {
+    EXPECT_TRUE(test_table->GetTuple(rid, result, txn));
+  }
+  EXPECT_TRUE(test_table->GetTuple(new_rid, result, txn));
+  EXPECT_FALSE(test_table->GetTuple(loser_rids[0], result, txn));
+  EXPECT_FALSE(test_table->GetTuple(loser_rids[1], result, txn));
+  storage_engine->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete storage_engine;
+  delete schema;
+  remove("test.db");
+  remove("test.log");
+  remove("test.log.0");
+  remove("test.master");
+  remove("crash.db");
+  remove("crash.log");
+  remove("crash.log.0");
+  remove("crash.master");
+}
+
+/*
+ * A restart continues the lsns and transaction ids of a log whose beginning
+ * a checkpoint truncated, and the checkpoint taken after it still tells
+ * recovery where to start in that log
+ */
+TEST(CheckpointManagerTest, RestartCheckpointTest) {
+  const int num_tuples = 100;
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = storage_engine->transaction_manager_;
+
+  Schema *schema = ParseCreateStatement("a varchar, b bigint");
+  Tuple tuple = ConstructTuple(schema);
+  std::vector<RID> rids(num_tuples);
+  Transaction *txn = txn_manager->Begin();
+  TableHeap *test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                                        storage_engine->lock_manager_,
+                                        storage_engine->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  for (auto &rid : rids) {
+    EXPECT_TRUE(test_table->InsertTuple(tuple, rid, txn));
+  }
+  txn_manager->Commit(txn);
+  txn_id_t last_txn_id = txn->GetTransactionId();
+  delete txn;
+  // more than a log segment, the checkpoint truncates the first one
+  int segment_size = storage_engine->disk_manager_->GetLogSegmentSize();
+  while (storage_engine->disk_manager_->GetLogSize() <= segment_size) {
+    txn = txn_manager->Begin();
+    for (auto &rid : rids) {
+      EXPECT_TRUE(test_table->UpdateTuple(tuple, rid, txn));
+    }
+    txn_manager->Commit(txn);
+    last_txn_id = txn->GetTransactionId();
+    delete txn;
+  }
+  EXPECT_TRUE(storage_engine->buffer_pool_manager_->FlushAllPages());
+  EXPECT_NE(INVALID_LSN, storage_engine->checkpoint_manager_->Checkpoint());
+  char data;
+  EXPECT_FALSE(storage_engine->disk_manager_->ReadLog(&data, 1, 0));
+  lsn_t last_lsn = storage_engine->log_manager_->GetPersistentLSN();
+  delete test_table;
+  delete storage_engine;
+
+  storage_engine = new StorageEngine("test.db");
+  txn_manager = storage_engine->transaction_manager_;
+  LogRecovery *log_recovery = new LogRecovery(
+      storage_engine->disk_manager_, storage_engine->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  log_recovery->ContinueLog(txn_manager, storage_engine->log_manager_);
+  delete log_recovery;
+  storage_engine->log_manager_->RunFlushThread();
+  test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                             storage_engine->lock_manager_,
+                             storage_engine->log_manager_, first_page_id);
+  RID new_rid;
+  txn = txn_manager->Begin();
+  EXPECT_LT(last_txn_id, txn->GetTransactionId());
+  EXPECT_TRUE(test_table->InsertTuple(tuple, new_rid, txn));
+  txn_manager->Commit(txn);
+  EXPECT_LT(last_lsn, txn->GetPrevLSN());
+  delete txn;
+  RID loser_rid;
+  Transaction *loser = txn_manager->Begin();
+  EXPECT_TRUE(test_table->InsertTuple(tuple, loser_rid, loser));
+  lsn_t checkpoint_lsn = storage_engine->checkpoint_manager_->Checkpoint();
+  EXPECT_LT(last_lsn, checkpoint_lsn);
+  lsn_t master_lsn;
+  int master_offset;
+  EXPECT_TRUE(storage_engine->disk_manager_->ReadMasterRecord(master_lsn,
+                                                              master_offset));
+  EXPECT_EQ(checkpoint_lsn, master_lsn);
+
+  // crash: the new rows are only in the log
+  CopyFile("test.db", "crash.db");
+  CopyLog("test.log", "crash.log");
+  CopyFile("test.master", "crash.master");
+  txn_manager->Abort(loser);
+  delete loser;
+  delete test_table;
+  delete storage_engine;
+
+  storage_engine = new StorageEngine("crash.db");
+  log_recovery = new LogRecovery(storage_engine->disk_manager_,
+                                 storage_engine->buffer_pool_manager_);
+  log_recovery->Redo();
+  EXPECT_LT(segment_size, log_recovery->GetRedoOffset());
+  EXPECT_GE(master_offset, log_recovery->GetRedoOffset());
+  log_recovery->Undo();
+
+  txn = storage_engine->transaction_manager_->Begin();
+  test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                             storage_engine->lock_manager_,
+                             storage_engine->log_manager_, first_page_id);
+  Tuple result;
+  for (auto &rid : rids) {
+    EXPECT_TRUE(test_table->GetTuple(rid, result, txn));
+  }
+  EXPECT_TRUE(test_table->GetTuple(new_rid, result, txn));
+  EXPECT_FALSE(test_table->GetTuple(loser_rid, result, txn));
+  storage_engine->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete storage_engine;
+  delete schema;
+  remove("test.db");
+  RemoveLog("test.log");
+  remove("test.master");
+  remove("crash.db");
+  RemoveLog("crash.log");
+  remove("crash.master");
+}
+
+/*
+ * Right after an instant restart every page with records to redo is in the
+ * dirty page table, more than an END_CHECKPOINT record holds. The checkpoint
+ * still succeeds, and recovery from it redoes the pages it left out
+ */
+TEST(CheckpointManagerTest, InstantRestartCheckpointTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = storage_engine->transaction_manager_;
+
+  // a table per page, so that no insert walks a long table
+  const size_t num_tables =
+      LOG_BUFFER_SIZE / (sizeof(page_id_t) + sizeof(lsn_t)) + 1;
+  Schema *schema = ParseCreateStatement("a varchar, b bigint");
+  Tuple tuple = ConstructTuple(schema);
+  std::vector<std::pair<page_id_t, RID>> rows(num_tables);
+  Transaction *txn = txn_manager->Begin();
+  for (auto &row : rows) {
+    TableHeap *test_table = new TableHeap(
+        storage_engine->buffer_pool_manager_, storage_engine->lock_manager_,
+        storage_engine->log_manager_, txn);
+    row.first = test_table->GetFirstPageId();
+    EXPECT_TRUE(test_table->InsertTuple(tuple, row.second, txn));
+    delete test_table;
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  delete storage_engine;
+
+  storage_engine = new StorageEngine("test.db");
+  txn_manager = storage_engine->transaction_manager_;
+  LogRecovery *log_recovery = new LogRecovery(
+      storage_engine->disk_manager_, storage_engine->buffer_pool_manager_);
+  log_recovery->InstantRestart(txn_manager, storage_engine->lock_manager_,
+                               storage_engine->log_manager_);
+  lsn_t checkpoint_lsn = storage_engine->checkpoint_manager_->Checkpoint();
+  EXPECT_NE(INVALID_LSN, checkpoint_lsn);
+  log_recovery->WaitForRestart();
+  delete log_recovery;
+
+  // crash: recovery starts from the checkpoint
+  CopyFile("test.db", "crash.db");
+  CopyLog("test.log", "crash.log");
+  CopyFile("test.master", "crash.master");
+  delete storage_engine;
+
+  storage_engine = new StorageEngine("crash.db");
+  log_recovery = new LogRecovery(storage_engine->disk_manager_,
+                                 storage_engine->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  txn = storage_engine->transaction_manager_->Begin();
+  Tuple result;
+  for (auto &row : rows) {
+    TableHeap *test_table = new TableHeap(
+        storage_engine->buffer_pool_manager_, storage_engine->lock_manager_,
+        storage_engine->log_manager_, row.first);
+    EXPECT_TRUE(test_table->GetTuple(row.second, result, txn));
+    delete test_table;
+  }
+  storage_engine->transaction_manager_->Commit(txn);
+  delete txn;
+  delete log_recovery;
+  delete storage_engine;
+  delete schema;
+  remove("test.db");
+  RemoveLog("test.log");
+  remove("test.master");
+  remove("crash.db");
+  RemoveLog("crash.log");
+  remove("crash.master");
+}
+
+TEST(CheckpointManagerTest, CheckpointThreadTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  lsn_t lsn;
+  int offset;
+  EXPECT_FALSE(storage_engine->disk_manager_->ReadMasterRecord(lsn, offset));
+  // no checkpoints without logging
+  EXPECT_EQ(INVALID_LSN, storage_engine->checkpoint_manager_->Checkpoint());
+
+  storage_engine->log_manager_->RunFlushThread();
+  Transaction *txn = storage_engine->transaction_manager_->Begin();
+  storage_engine->checkpoint_manager_->RunCheckpointThread(
+      std::chrono::milliseconds(20));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  storage_engine->checkpoint_manager_->StopCheckpointThread();
+  EXPECT_TRUE(storage_engine->disk_manager_->ReadMasterRecord(lsn, offset));
+  EXPECT_LT(txn->GetPrevLSN(), lsn);
+
+  // a checkpoint keeps the transaction it saw running in the table
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns;
+  storage_engine->transaction_manager_->GetActiveTransactions(active_txns);
+  ASSERT_EQ(1u, active_txns.size());
+  EXPECT_EQ(txn->GetTransactionId(), active_txns[0].first);
+  EXPECT_EQ(txn->GetPrevLSN(), active_txns[0].second);
+  storage_engine->transaction_manager_->Commit(txn);
+  active_txns.clear();
+  storage_engine->transaction_manager_->GetActiveTransactions(active_txns);
+  EXPECT_TRUE(active_txns.empty());
+
+  delete txn;
+  delete storage_engine;
+  remove("test.db");
+  remove("test.log");
+  remove("test.master");
+}
+
+} // namespace cmudb
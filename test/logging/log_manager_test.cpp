@@ -1,7 +1,14 @@
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 
 #include "logging/common.h"
 #include "logging/log_recovery.h"
@@ -136,4 +143,319 @@ TEST(LogManagerTest, RedoTestWithOneTxn) {
   remove("test.log");
 }
 
+/*
+ * Many committers at once: every commit returns as soon as its group is on
+ * disk instead of at the next flush timeout, and groups share log writes
+ */
+TEST(LogManagerTest, GroupCommitTest) {
+  const int num_threads = 8;
+  const int commits_per_thread = 200;
+  DiskManager *disk_manager = new DiskManager("test.db");
+  LogManager *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+
+  std::vector<std::vector<double>> latencies(num_threads);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.push_back(std::thread([&, tid] {
+      for (int i = 0; i < commits_per_thread; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        LogRecord log_record(tid, INVALID_LSN, LogRecordType::COMMIT);
+        lsn_t lsn = log_manager->AppendLogRecord(log_record);
+        log_manager->WaitLogIntoDisk(lsn, false);
+        EXPECT_LE(lsn, log_manager->GetPersistentLSN());
+        std::chrono::duration<double, std::micro> latency =
+            std::chrono::steady_clock::now() - begin;
+        latencies[tid].push_back(latency.count());
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  log_manager->StopFlushThread();
+
+  std::vector<double> all;
+  for (auto &thread_latencies : latencies) {
+    all.insert(all.end(), thread_latencies.begin(), thread_latencies.end());
+  }
+  std::sort(all.begin(), all.end());
+  double p50 = all[all.size() / 2];
+  double p99 = all[all.size() * 99 / 100];
+  uint64_t writes =
+      disk_manager->GetIOStats().GetSnapshot().Get(IOType::LOG_WRITE).count_;
+  std::cout << static_cast<long>(all.size() / elapsed.count())
+            << " commits/s, p50 " << p50 << "us, p99 " << p99 << "us, "
+            << writes << " log writes for " << all.size() << " commits"
+            << std::endl;
+  // far below the flush timeout
+  EXPECT_LT(p99, 100000);
+  EXPECT_LE(writes, all.size());
+
+  delete log_manager;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * Records appended concurrently land in the log whole and in lsn order
+ */
+TEST(LogManagerTest, ConcurrentAppendTest) {
+  const int num_threads = 8;
+  const int records_per_thread = 2000;
+  DiskManager *disk_manager = new DiskManager("test.db");
+  LogManager *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+
+  Schema *schema = ParseCreateStatement("a varchar, b bigint");
+  std::vector<Tuple> tuples;
+  for (int i = 0; i < 16; ++i) {
+    tuples.push_back(ConstructTuple(schema));
+  }
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.push_back(std::thread([&, tid] {
+      for (int i = 0; i < records_per_thread; ++i) {
+        const Tuple &tuple = tuples[(tid + i) % tuples.size()];
+        LogRecord log_record(tid, INVALID_LSN, LogRecordType::INSERT,
+                             RID(tid, i), tuple);
+        EXPECT_NE(INVALID_LSN, log_manager->AppendLogRecord(log_record));
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  log_manager->StopFlushThread();
+  EXPECT_EQ(num_threads * records_per_thread - 1,
+            log_manager->GetPersistentLSN());
+
+  // walk the log file record by record
+  std::vector<int> next_slot(num_threads, 0);
+  // the 20 byte header of LogRecord followed by the rid of an insert
+  char header[20 + sizeof(RID)];
+  int offset = 0;
+  lsn_t expected_lsn = 0;
+  while (disk_manager->ReadLog(header, sizeof(header), offset)) {
+    int32_t size;
+    lsn_t lsn;
+    txn_id_t txn_id;
+    RID rid;
+    memcpy(&size, header, sizeof(size));
+    memcpy(&lsn, header + 4, sizeof(lsn));
+    memcpy(&txn_id, header + 8, sizeof(txn_id));
+    memcpy(&rid, header + 20, sizeof(rid));
+    ASSERT_EQ(expected_lsn++, lsn);
+    ASSERT_TRUE(txn_id >= 0 && txn_id < num_threads);
+    // every thread's records are in the order it appended them
+    EXPECT_EQ(next_slot[txn_id]++, static_cast<int>(rid.GetSlotNum()));
+    offset += size;
+  }
+  EXPECT_EQ(num_threads * records_per_thread, expected_lsn);
+
+  delete schema;
+  delete log_manager;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(LogManagerTest, FlushNotificationTest) {
+  DiskManager *disk_manager = new DiskManager("test.db");
+  LogManager *log_manager = new LogManager(disk_manager);
+
+  std::vector<lsn_t> lsns;
+  for (int i = 0; i < 10; ++i) {
+    LogRecord log_record(i, INVALID_LSN, LogRecordType::BEGIN);
+    lsns.push_back(log_manager->AppendLogRecord(log_record));
+  }
+  std::mutex latch;
+  std::vector<lsn_t> notified;
+  for (int i = 9; i >= 0; i -= 3) {
+    lsn_t lsn = lsns[i];
+    log_manager->OnLogIntoDisk(lsn, [&, lsn] {
+      std::lock_guard<std::mutex> guard(latch);
+      notified.push_back(lsn);
+    }, false);
+  }
+  std::future<void> future =
+      log_manager->GetLogIntoDiskFuture(lsns[5], false);
+  EXPECT_EQ(std::future_status::timeout,
+            future.wait_for(std::chrono::milliseconds(10)));
+  EXPECT_TRUE(notified.empty());
+
+  // the first waiter wakes the flush thread, no timeout is involved
+  auto start = std::chrono::steady_clock::now();
+  log_manager->RunFlushThread();
+  future.wait();
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(500));
+  log_manager->WaitLogIntoDisk(lsns[9], false);
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    EXPECT_EQ(std::vector<lsn_t>({lsns[0], lsns[3], lsns[6], lsns[9]}),
+              notified);
+  }
+  // already durable, runs right away
+  bool called = false;
+  log_manager->OnLogIntoDisk(lsns[2], [&] { called = true; }, false);
+  EXPECT_TRUE(called);
+  log_manager->StopFlushThread();
+
+  delete log_manager;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * Nobody waiting for a record is told it is durable while its log write
+ * fails. The write is retried and releases the waiters once it succeeds
+ */
+TEST(LogManagerTest, LogWriteErrorTest) {
+  DiskManager *disk_manager = new DiskManager("test.db");
+  LogManager *log_manager = new LogManager(disk_manager);
+  // the first log segment cannot be created
+  ASSERT_EQ(0, mkdir("test.log.0", 0755));
+  log_manager->RunFlushThread();
+
+  LogRecord log_record(0, INVALID_LSN, LogRecordType::BEGIN);
+  lsn_t lsn = log_manager->AppendLogRecord(log_record);
+  std::future<void> future = log_manager->GetLogIntoDiskFuture(lsn, true);
+  EXPECT_EQ(std::future_status::timeout,
+            future.wait_for(std::chrono::milliseconds(200)));
+  EXPECT_EQ(INVALID_LSN, log_manager->GetPersistentLSN());
+  EXPECT_EQ(0, disk_manager->GetLogSize());
+
+  rmdir("test.log.0");
+  future.wait();
+  EXPECT_EQ(lsn, log_manager->GetPersistentLSN());
+  EXPECT_EQ(log_record.GetSize(), disk_manager->GetLogSize());
+  log_manager->StopFlushThread();
+
+  delete log_manager;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  remove("test.log.0");
+}
+
+/*
+ * A record that can never fit into a log buffer is rejected instead of
+ * waiting for room forever
+ */
+TEST(LogManagerTest, OversizedRecordTest) {
+  DiskManager *disk_manager = new DiskManager("test.db");
+  LogManager *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages(LOG_BUFFER_SIZE / 8);
+  LogRecord oversized(INVALID_TXN_ID, INVALID_LSN,
+                      LogRecordType::END_CHECKPOINT, 0, INVALID_TXN_ID, {},
+                      dirty_pages);
+  EXPECT_LE(LOG_BUFFER_SIZE, oversized.GetSize());
+  EXPECT_EQ(INVALID_LSN, log_manager->AppendLogRecord(oversized));
+
+  LogRecord log_record(0, INVALID_LSN, LogRecordType::BEGIN);
+  lsn_t lsn = log_manager->AppendLogRecord(log_record);
+  EXPECT_EQ(0, lsn);
+  log_manager->WaitLogIntoDisk(lsn, true);
+  log_manager->StopFlushThread();
+
+  delete log_manager;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  remove("test.log.0");
+}
+
+static void CopyFile(const std::string &from, const std::string &to) {
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  out << in.rdbuf();
+}
+
+/*
+ * An asynchronous commit returns before its COMMIT record is durable, the
+ * flush thread writes it within ASYNC_COMMIT_DELAY. A crash before that
+ * undoes the transaction as a whole
+ */
+TEST(LogManagerTest, AsyncCommitTest) {
+  auto async_commit_delay = ASYNC_COMMIT_DELAY;
+  ASYNC_COMMIT_DELAY = std::chrono::milliseconds(300);
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = storage_engine->transaction_manager_;
+
+  Transaction *txn = txn_manager->Begin();
+  TableHeap *test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                                        storage_engine->lock_manager_,
+                                        storage_engine->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  txn_manager->Commit(txn);
+  delete txn;
+
+  Schema *schema = ParseCreateStatement("a varchar, b bigint");
+  Tuple tuple = ConstructTuple(schema);
+  RID async_rid, sync_rid;
+  Transaction *async_txn = txn_manager->Begin();
+  async_txn->SetAsyncCommit(true);
+  EXPECT_TRUE(test_table->InsertTuple(tuple, async_rid, async_txn));
+  // the synchronous commit also makes the insert above durable
+  txn = txn_manager->Begin();
+  EXPECT_TRUE(test_table->InsertTuple(tuple, sync_rid, txn));
+  txn_manager->Commit(txn);
+  delete txn;
+
+  auto start = std::chrono::steady_clock::now();
+  txn_manager->Commit(async_txn);
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(100));
+  lsn_t commit_lsn = async_txn->GetPrevLSN();
+  delete async_txn;
+  EXPECT_LT(storage_engine->log_manager_->GetPersistentLSN(), commit_lsn);
+
+  // crash: what is on disk now lacks the asynchronous COMMIT record
+  EXPECT_TRUE(storage_engine->buffer_pool_manager_->FlushAllPages());
+  CopyFile("test.db", "crash.db");
+  CopyFile("test.log", "crash.log");
+  CopyFile("test.log.0", "crash.log.0");
+
+  // the loss window is bounded
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  EXPECT_LE(commit_lsn, storage_engine->log_manager_->GetPersistentLSN());
+  delete test_table;
+  delete storage_engine;
+  ASYNC_COMMIT_DELAY = async_commit_delay;
+
+  storage_engine = new StorageEngine("crash.db");
+  LogRecovery *log_recovery = new LogRecovery(
+      storage_engine->disk_manager_, storage_engine->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  txn = storage_engine->transaction_manager_->Begin();
+  test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                             storage_engine->lock_manager_,
+                             storage_engine->log_manager_, first_page_id);
+  Tuple result;
+  EXPECT_TRUE(test_table->GetTuple(sync_rid, result, txn));
+  EXPECT_FALSE(test_table->GetTuple(async_rid, result, txn));
+  storage_engine->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete storage_engine;
+  delete schema;
+  remove("test.db");
+  remove("test.log");
+  remove("test.log.0");
+  remove("crash.db");
+  remove("crash.log");
+  remove("crash.log.0");
+}
+
 } // namespace cmudb
@@ -0,0 +1,83 @@
+/**
+ * log_reader_test.cpp
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "logging/log_reader.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+/*
+ * Records of all sizes come out whole and in order, also across chunk and
+ * segment boundaries and when a record is larger than a chunk. The records
+ * within a chunk are handed out in place, one after the other
+ */
+TEST(LogReaderTest, ReadTest) {
+  const int segment_size = 4096;
+  const int chunk_size = 256;
+  const int num_records = 200;
+  DiskManager *disk_manager = new DiskManager("test.db", false, false,
+                                              segment_size);
+
+  // records start with their size like log records, the rest tells them
+  // apart
+  std::vector<char> log;
+  std::vector<int> offsets;
+  for (int i = 0; i < num_records; ++i) {
+    int32_t size = 8 + i * 37 % 600;
+    offsets.push_back(log.size());
+    log.resize(log.size() + size, static_cast<char>(i % 128));
+    memcpy(&log[offsets.back()], &size, sizeof(int32_t));
+  }
+  disk_manager->WriteLog(log.data(), log.size());
+
+  for (int first : {0, 97}) {
+    LogReader reader(disk_manager, offsets[first], chunk_size);
+    const char *prev = nullptr;
+    int prev_size = 0;
+    int num_in_place = 0;
+    int offset;
+    for (int i = first; i < num_records; ++i) {
+      const char *record = reader.Next(offset);
+      ASSERT_NE(nullptr, record);
+      EXPECT_EQ(offsets[i], offset);
+      int32_t size;
+      memcpy(&size, record, sizeof(int32_t));
+      EXPECT_EQ(0, memcmp(&log[offset], record, size));
+      EXPECT_EQ(offset + size, reader.GetOffset());
+      if (record == prev + prev_size) {
+        num_in_place++;
+      }
+      prev = record;
+      prev_size = size;
+    }
+    EXPECT_EQ(nullptr, reader.Next(offset));
+    EXPECT_EQ(nullptr, reader.Next(offset));
+    EXPECT_LT(0, num_in_place);
+  }
+
+  // an empty log
+  delete disk_manager;
+  remove("test.log");
+  disk_manager = new DiskManager("test.db", false, false, segment_size);
+  {
+    LogReader reader(disk_manager, 0, chunk_size);
+    int offset;
+    EXPECT_EQ(nullptr, reader.Next(offset));
+  }
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  for (int segment = 0;
+       remove(("test.log." + std::to_string(segment)).c_str()) == 0;
+       ++segment) {
+  }
+}
+
+} // namespace cmudb
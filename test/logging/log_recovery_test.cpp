@@ -0,0 +1,376 @@
+/**
+ * log_recovery_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logging/common.h"
+#include "logging/log_recovery.h"
+#include "vtable/virtual_table.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+static void CopyFile(const std::string &from, const std::string &to) {
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  out << in.rdbuf();
+}
+
+// the log control file and all of its segments
+static void CopyLog(const std::string &from, const std::string &to) {
+  CopyFile(from, to);
+  for (int segment = 0;; ++segment) {
+    std::string name = from + "." + std::to_string(segment);
+    if (!std::ifstream(name).good()) {
+      break;
+    }
+    CopyFile(name, to + "." + std::to_string(segment));
+  }
+}
+
+static void RemoveLog(const std::string &name) {
+  remove(name.c_str());
+  for (int segment = 0;
+       remove((name + "." + std::to_string(segment)).c_str()) == 0;
+       ++segment) {
+  }
+}
+
+/*
+ * Redo on several workers ends up with the same pages as the serial redo:
+ * inserts, updates and deletes of committed transactions on pages spread
+ * over all workers survive, the loser is undone
+ */
+TEST(LogRecoveryTest, ParallelRedoTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = storage_engine->transaction_manager_;
+
+  Transaction *txn = txn_manager->Begin();
+  TableHeap *test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                                        storage_engine->lock_manager_,
+                                        storage_engine->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  txn_manager->Commit(txn);
+  delete txn;
+
+  Schema *schema = ParseCreateStatement("a varchar, b bigint");
+  Tuple tuple = ConstructTuple(schema);
+  std::vector<RID> rids(200);
+  txn = txn_manager->Begin();
+  for (auto &rid : rids) {
+    EXPECT_TRUE(test_table->InsertTuple(tuple, rid, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  txn = txn_manager->Begin();
+  for (size_t i = 0; i < rids.size(); i += 3) {
+    EXPECT_TRUE(test_table->MarkDelete(rids[i], txn));
+    EXPECT_TRUE(test_table->UpdateTuple(tuple, rids[i + 1], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  RID loser_rid;
+  Transaction *loser = txn_manager->Begin();
+  EXPECT_TRUE(test_table->InsertTuple(tuple, loser_rid, loser));
+  storage_engine->log_manager_->WaitLogIntoDisk(loser->GetPrevLSN(), true);
+
+  // crash: the pages still in the buffer pool are lost
+  CopyFile("test.db", "crash.db");
+  CopyLog("test.log", "crash.log");
+  txn_manager->Abort(loser);
+  delete loser;
+  delete test_table;
+  delete storage_engine;
+
+  storage_engine = new StorageEngine("crash.db");
+  LogRecovery *log_recovery = new LogRecovery(
+      storage_engine->disk_manager_, storage_engine->buffer_pool_manager_);
+  log_recovery->Redo(4);
+  log_recovery->Undo();
+
+  txn = storage_engine->transaction_manager_->Begin();
+  test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                             storage_engine->lock_manager_,
+                             storage_engine->log_manager_, first_page_id);
+  Tuple result;
+  for (size_t i = 0; i < rids.size(); ++i) {
+    EXPECT_EQ(i % 3 != 0, test_table->GetTuple(rids[i], result, txn));
+  }
+  EXPECT_FALSE(test_table->GetTuple(loser_rid, result, txn));
+  storage_engine->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete storage_engine;
+  delete schema;
+  remove("test.db");
+  RemoveLog("test.log");
+  remove("crash.db");
+  RemoveLog("crash.log");
+}
+
+static bool SameTuple(const Tuple &a, const Tuple &b) {
+  return a.GetLength() == b.GetLength() &&
+         memcmp(a.GetData(), b.GetData(), a.GetLength()) == 0;
+}
+
+/*
+ * After an instant restart, committed rows can be read and changed before
+ * the losers are rolled back. Once the restart is done the loser's insert,
+ * update and delete are undone, and a regular recovery of the log written
+ * since then ends up with the same rows
+ */
+TEST(LogRecoveryTest, InstantRestartTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = storage_engine->transaction_manager_;
+
+  Transaction *txn = txn_manager->Begin();
+  TableHeap *test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                                        storage_engine->lock_manager_,
+                                        storage_engine->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  txn_manager->Commit(txn);
+  delete txn;
+
+  Schema *schema = ParseCreateStatement("a varchar, b bigint");
+  Tuple tuple = ConstructTuple(schema);
+  Tuple new_tuple = ConstructTuple(schema);
+  while (SameTuple(tuple, new_tuple)) {
+    new_tuple = ConstructTuple(schema);
+  }
+  std::vector<RID> rids(100);
+  txn = txn_manager->Begin();
+  for (auto &rid : rids) {
+    EXPECT_TRUE(test_table->InsertTuple(tuple, rid, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  RID loser_rid;
+  Transaction *loser = txn_manager->Begin();
+  EXPECT_TRUE(test_table->InsertTuple(tuple, loser_rid, loser));
+  EXPECT_TRUE(test_table->UpdateTuple(new_tuple, rids[1], loser));
+  EXPECT_TRUE(test_table->MarkDelete(rids[2], loser));
+  storage_engine->log_manager_->WaitLogIntoDisk(loser->GetPrevLSN(), true);
+  txn_id_t loser_id = loser->GetTransactionId();
+
+  // crash: the pages still in the buffer pool are lost
+  CopyFile("test.db", "crash.db");
+  CopyLog("test.log", "crash.log");
+  txn_manager->Abort(loser);
+  delete loser;
+  delete test_table;
+  delete storage_engine;
+
+  storage_engine = new StorageEngine("crash.db");
+  txn_manager = storage_engine->transaction_manager_;
+  LogRecovery *log_recovery = new LogRecovery(
+      storage_engine->disk_manager_, storage_engine->buffer_pool_manager_);
+  log_recovery->InstantRestart(txn_manager, storage_engine->lock_manager_,
+                               storage_engine->log_manager_);
+  EXPECT_TRUE(ENABLE_LOGGING);
+  test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                             storage_engine->lock_manager_,
+                             storage_engine->log_manager_, first_page_id);
+  // committed rows the loser did not touch are usable right away
+  Tuple result;
+  txn = txn_manager->Begin();
+  EXPECT_LT(loser_id, txn->GetTransactionId());
+  EXPECT_TRUE(test_table->GetTuple(rids.back(), result, txn));
+  EXPECT_TRUE(SameTuple(tuple, result));
+  EXPECT_TRUE(test_table->UpdateTuple(new_tuple, rids[0], txn));
+  txn_manager->Commit(txn);
+  delete txn;
+  log_recovery->WaitForRestart();
+
+  auto check = [&] {
+    Transaction *check_txn = txn_manager->Begin();
+    EXPECT_TRUE(test_table->GetTuple(rids[0], result, check_txn));
+    EXPECT_TRUE(SameTuple(new_tuple, result));
+    for (size_t i = 1; i < rids.size(); ++i) {
+      EXPECT_TRUE(test_table->GetTuple(rids[i], result, check_txn));
+      EXPECT_TRUE(SameTuple(tuple, result));
+    }
+    // a missing tuple aborts the reader
+    EXPECT_FALSE(test_table->GetTuple(loser_rid, result, check_txn));
+    txn_manager->Commit(check_txn);
+    delete check_txn;
+  };
+  check();
+
+  // crash again: the rollback and the changes made since the restart were
+  // logged with lsns following the old log
+  CopyFile("crash.db", "crash2.db");
+  CopyLog("crash.log", "crash2.log");
+  delete test_table;
+  delete log_recovery;
+  delete storage_engine;
+
+  storage_engine = new StorageEngine("crash2.db");
+  txn_manager = storage_engine->transaction_manager_;
+  log_recovery = new LogRecovery(storage_engine->disk_manager_,
+                                 storage_engine->buffer_pool_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                             storage_engine->lock_manager_,
+                             storage_engine->log_manager_, first_page_id);
+  check();
+  delete test_table;
+  delete log_recovery;
+  delete storage_engine;
+  delete schema;
+  remove("test.db");
+  RemoveLog("test.log");
+  remove("crash.db");
+  RemoveLog("crash.log");
+  remove("crash2.db");
+  RemoveLog("crash2.log");
+}
+
+/*
+ * A page the restart cannot fetch while every frame is pinned is redone
+ * once a frame frees up, none of its committed rows are lost
+ */
+TEST(LogRecoveryTest, InstantRestartPinnedTest) {
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = storage_engine->transaction_manager_;
+
+  Schema *schema = ParseCreateStatement("a varchar, b bigint");
+  Tuple tuple = ConstructTuple(schema);
+  std::vector<RID> rids(200);
+  Transaction *txn = txn_manager->Begin();
+  TableHeap *test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                                        storage_engine->lock_manager_,
+                                        storage_engine->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  for (auto &rid : rids) {
+    EXPECT_TRUE(test_table->InsertTuple(tuple, rid, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // crash: the pages still in the buffer pool are lost
+  CopyFile("test.db", "crash.db");
+  CopyLog("test.log", "crash.log");
+  delete test_table;
+  delete storage_engine;
+
+  storage_engine = new StorageEngine("crash.db");
+  BufferPoolManager *buffer_pool_manager = storage_engine->buffer_pool_manager_;
+  LogRecovery *log_recovery =
+      new LogRecovery(storage_engine->disk_manager_, buffer_pool_manager);
+  log_recovery->InstantRestart(storage_engine->transaction_manager_,
+                               storage_engine->lock_manager_,
+                               storage_engine->log_manager_);
+  std::vector<page_id_t> pinned;
+  page_id_t page_id;
+  while (buffer_pool_manager->NewPage(page_id) != nullptr) {
+    pinned.push_back(page_id);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  for (auto pinned_id : pinned) {
+    EXPECT_TRUE(buffer_pool_manager->UnpinPage(pinned_id, false));
+    EXPECT_TRUE(buffer_pool_manager->DeletePage(pinned_id));
+  }
+  log_recovery->WaitForRestart();
+
+  txn = storage_engine->transaction_manager_->Begin();
+  test_table = new TableHeap(buffer_pool_manager, storage_engine->lock_manager_,
+                             storage_engine->log_manager_, first_page_id);
+  Tuple result;
+  for (auto &rid : rids) {
+    EXPECT_TRUE(test_table->GetTuple(rid, result, txn));
+  }
+  storage_engine->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete log_recovery;
+  delete storage_engine;
+  delete schema;
+  remove("test.db");
+  RemoveLog("test.log");
+  remove("crash.db");
+  RemoveLog("crash.log");
+}
+
+/*
+ * Redo the same log from the same database file with a growing number of
+ * workers and report the redo throughput. Recovery gets a buffer pool that
+ * holds the whole table, so redo is not bound by page write back
+ */
+TEST(LogRecoveryTest, ParallelRedoBenchmark) {
+  const int num_tuples = 1000;
+  const int num_rounds = 20;
+  StorageEngine *storage_engine = new StorageEngine("test.db");
+  storage_engine->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = storage_engine->transaction_manager_;
+
+  Schema *schema = ParseCreateStatement("a varchar, b bigint");
+  Tuple tuple = ConstructTuple(schema);
+  std::vector<RID> rids(num_tuples);
+  Transaction *txn = txn_manager->Begin();
+  TableHeap *test_table = new TableHeap(storage_engine->buffer_pool_manager_,
+                                        storage_engine->lock_manager_,
+                                        storage_engine->log_manager_, txn);
+  for (auto &rid : rids) {
+    EXPECT_TRUE(test_table->InsertTuple(tuple, rid, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  // every change made from here on has to be redone
+  EXPECT_TRUE(storage_engine->buffer_pool_manager_->FlushAllPages());
+  CopyFile("test.db", "base.db");
+  for (int i = 0; i < num_rounds; ++i) {
+    txn = txn_manager->Begin();
+    for (auto &rid : rids) {
+      EXPECT_TRUE(test_table->UpdateTuple(tuple, rid, txn));
+    }
+    txn_manager->Commit(txn);
+    delete txn;
+  }
+  int num_records = storage_engine->log_manager_->GetPersistentLSN() + 1;
+  CopyLog("test.log", "base.log");
+  delete test_table;
+  delete storage_engine;
+
+  for (size_t num_workers : {1, 2, 4, 8}) {
+    CopyFile("base.db", "crash.db");
+    CopyLog("base.log", "crash.log");
+    DiskManager *disk_manager = new DiskManager("crash.db");
+    BufferPoolManager *buffer_pool_manager =
+        new BufferPoolManager(1024, disk_manager, nullptr, 8);
+    LogRecovery *log_recovery =
+        new LogRecovery(disk_manager, buffer_pool_manager);
+    auto start = std::chrono::steady_clock::now();
+    log_recovery->Redo(num_workers);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << num_workers << " redo workers: "
+              << static_cast<long>(num_records / elapsed.count())
+              << " records/s" << std::endl;
+    delete log_recovery;
+    delete buffer_pool_manager;
+    delete disk_manager;
+  }
+
+  delete schema;
+  remove("test.db");
+  RemoveLog("test.log");
+  remove("base.db");
+  RemoveLog("base.log");
+  remove("crash.db");
+  RemoveLog("crash.log");
+}
+
+} // namespace cmudb
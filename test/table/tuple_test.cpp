@@ -47,6 +47,18 @@ TEST(TupleTest, TableHeapTest) {
     ++itr;
   }
 
+  // the same scan through a ring of frames
+  {
+    AccessStrategy strategy(buffer_pool_manager);
+    int count = 0;
+    TableIterator ring_itr = table->begin(transaction, &strategy);
+    while (ring_itr != table->end()) {
+      count++;
+      ++ring_itr;
+    }
+    EXPECT_EQ(5000, count);
+  }
+
   // int i = 0;
   std::random_shuffle(rid_v.begin(), rid_v.end());
   for (auto rid : rid_v) {